@@ -5,6 +5,7 @@
 #include "GraphicsBackend.h"
 #include "MouseBackend.h"
 #include "PaletteBackend.h"
+#include "Presenter.h"
 #include "SFXBackend.h"
 
 #endif
\ No newline at end of file
@@ -1,9 +1,17 @@
 #include "GraphicsBackend.h"
 #include "MouseBackend.h"
 #include "PaletteBackend.h"
+#include "Presenter.h"
 #include "Backend.h"
 #include "../zc_alleg.h"
 #include <cassert>
+#include <cstring>
+
+#include "../zc_clock.h"
+
+#ifdef ALLEGRO_WINDOWS
+#include <mmsystem.h>
+#endif
 
 void Z_message(const char *format, ...);
 
@@ -11,25 +19,11 @@ void (*GraphicsBackend::switch_in_func_)() = NULL;
 void (*GraphicsBackend::switch_out_func_)() = NULL;
 int GraphicsBackend::fps_ = 60;
 
-volatile int GraphicsBackend::frame_counter = 0;
-volatile int GraphicsBackend::frames_this_second = 0;
-volatile int GraphicsBackend::prev_frames_this_second = 0;
-
 bool GraphicsBackend::windowsFullscreenFix_ = false;
 
-void update_frame_counter()
-{
-	static int cnt;
-	GraphicsBackend::frame_counter++;
-	cnt++;
-	if (cnt == GraphicsBackend::fps_)
-	{
-		GraphicsBackend::prev_frames_this_second = GraphicsBackend::frames_this_second;
-		GraphicsBackend::frames_this_second = 0;
-		cnt = 0;
-	}
-}
-END_OF_FUNCTION(update_frame_counter)
+// Spin time left at the end of each frame to absorb sleep overshoot
+static const int MIN_SPIN_USEC = 1000;
+
 
 void onSwitchOut()
 {
@@ -54,6 +48,7 @@ GraphicsBackend::GraphicsBackend() :
 	backbuffer_(NULL),
 	nativebuffer_(NULL),
 	initialized_(false),
+	headless_(false),
 	screenw_(320),
 	screenh_(240),
 	fullscreen_(false),
@@ -61,15 +56,29 @@ GraphicsBackend::GraphicsBackend() :
 	curmode_(-1),
 	virtualw_(1),
 	virtualh_(1),
-	switchdelay_(1)
+	switchdelay_(1),
+	deadline_(0),
+	lastTick_(0),
+	secondStart_(0),
+	spinMargin_(2*MIN_SPIN_USEC),
+	framesThisSecond_(0)
 {	
+	stats_.fps = 0;
+	resetFrameStats();
 }
 
 GraphicsBackend::~GraphicsBackend()
 {
-	if (initialized_)
+	if (initialized_ && headless_)
 	{
-		remove_int(update_frame_counter);
+		screen = NULL;
+		destroy_bitmap(backbuffer_);
+	}
+	else if (initialized_)
+	{
+#ifdef ALLEGRO_WINDOWS
+		timeEndPeriod(1);
+#endif
 		screen = hw_screen_;
 		destroy_bitmap(backbuffer_);		
 		clear_to_color(screen, 0);
@@ -102,14 +111,37 @@ void GraphicsBackend::writeConfigurationOptions(const std::string &prefix)
 	set_config_int(secname, "fps", fps_);
 }
 
+void GraphicsBackend::setHeadless(bool headless)
+{
+	if (!initialized_)
+		headless_ = headless;
+}
+
 bool GraphicsBackend::initialize()
 {
 	if (initialized_)
 		return true;
 
-	LOCK_VARIABLE(frame_counter);
-	LOCK_FUNCTION(update_frame_counter);
-	install_int_ex(update_frame_counter, BPS_TO_TIMER(fps_));
+	if (headless_)
+	{
+		if (virtualmodes_.empty())
+			return false;
+
+		curmode_ = 0;
+		virtualw_ = screenw_ = virtualmodes_[0].first;
+		virtualh_ = screenh_ = virtualmodes_[0].second;
+		backbuffer_ = create_bitmap_ex(8, virtualw_, virtualh_);
+		clear_to_color(backbuffer_, 0);
+		screen = backbuffer_;
+		initialized_ = true;
+		return true;
+	}
+
+#ifdef ALLEGRO_WINDOWS
+	// Without this Sleep() rounds up to the 15.6ms scheduler tick
+	timeBeginPeriod(1);
+#endif
+	lastTick_ = secondStart_ = deadline_ = zc_clock_usec();
 	
 	backbuffer_ = create_bitmap_ex(8, virtualScreenW(), virtualScreenH());
 	initialized_ = true;
@@ -121,16 +153,98 @@ bool GraphicsBackend::initialize()
 
 void GraphicsBackend::waitTick()
 {
-	if (!initialized_)
+	if (!initialized_ || headless_)
 		return;
 
-	while (frame_counter == 0)
-		rest(0);
-	frame_counter = 0;
+	int fps = fps_ > 0 ? fps_ : 60;
+	unsigned long long period = 1000000 / fps;
+	unsigned long long now = zc_clock_usec();
+
+	if (now < deadline_)
+	{
+		// Sleep through most of the wait, then spin for the remainder
+		if (deadline_ - now > (unsigned long long)spinMargin_)
+		{
+			unsigned long long wake = deadline_ - spinMargin_;
+			rest((unsigned int)((wake - now) / 1000));
+			now = zc_clock_usec();
+
+			// Widen the margin quickly if a sleep ran long, and narrow it
+			// again slowly while sleeps are on time
+			if (now > wake + spinMargin_ / 2)
+			{
+				spinMargin_ = (int)(now - wake) + spinMargin_ / 2;
+				if (spinMargin_ > (int)period / 2)
+					spinMargin_ = (int)period / 2;
+			}
+			else if (spinMargin_ > MIN_SPIN_USEC)
+			{
+				spinMargin_ -= spinMargin_ / 64 + 1;
+			}
+		}
+
+		while (now < deadline_)
+		{
+			rest(0);
+			now = zc_clock_usec();
+		}
+	}
+	else if (now > deadline_)
+	{
+		stats_.missedDeadlines++;
+
+		// More than a frame behind: drop the backlog instead of racing
+		// through it
+		if (now - deadline_ >= period)
+		{
+			stats_.droppedFrames += (unsigned long)((now - deadline_) / period);
+			deadline_ = now;
+		}
+	}
+
+	deadline_ += period;
+	recordFrame(now);
+}
+
+void GraphicsBackend::recordFrame(unsigned long long now)
+{
+	unsigned long long elapsed = now - lastTick_;
+	int usec = elapsed > 0x7FFFFFFF ? 0x7FFFFFFF : (int)elapsed;
+	lastTick_ = now;
+
+	stats_.frames++;
+	stats_.lastFrameUsec = usec;
+	if (usec > stats_.worstFrameUsec)
+		stats_.worstFrameUsec = usec;
+
+	int bucket = usec / 1000;
+	if (bucket >= FrameTimingStats::HISTOGRAM_BUCKETS)
+		bucket = FrameTimingStats::HISTOGRAM_BUCKETS - 1;
+	stats_.histogram[bucket]++;
+
+	if (now - secondStart_ >= 1000000)
+	{
+		stats_.fps = framesThisSecond_;
+		framesThisSecond_ = 0;
+		secondStart_ = now;
+	}
+}
+
+void GraphicsBackend::resetFrameStats()
+{
+	stats_.frames = 0;
+	stats_.missedDeadlines = 0;
+	stats_.droppedFrames = 0;
+	stats_.lastFrameUsec = 0;
+	stats_.worstFrameUsec = 0;
+	memset(stats_.histogram, 0, sizeof(stats_.histogram));
 }
 
 bool GraphicsBackend::showBackBuffer()
 {
+	if (headless_)
+		return true;
+
 #ifdef _WINDOWS
 	if (windowsFullscreenFix_)
 	{
@@ -147,18 +261,33 @@ bool GraphicsBackend::showBackBuffer()
 	Backend::palette->applyPaletteToScreen();
 	screen = backbuffer_;
 
-	if (native_)
+	// Exact integer scales are converted and magnified straight into the
+	// hardware buffer; anything else goes through Allegro
+	bool presented = false;
+	int scale = hw_screen_->w / virtualScreenW();
+
+	if (scale >= 1 && hw_screen_->w == scale * virtualScreenW() && hw_screen_->h == scale * virtualScreenH())
 	{
-		stretch_blit(backbuffer_, nativebuffer_, 0, 0, virtualScreenW(), virtualScreenH(), 0, 0, SCREEN_W, SCREEN_H);
-		set_color_conversion(COLORCONV_TOTAL);
-		blit(nativebuffer_, hw_screen_, 0, 0, 0, 0, SCREEN_W, SCREEN_H);
+		PALETTE pal;
+		Backend::palette->getPalette(pal);
+		presented = blitIntegerScaled(backbuffer_, hw_screen_, 0, 0, virtualScreenW(), virtualScreenH(), 0, 0, scale, -1, pal);
 	}
-	else
+
+	if (!presented)
 	{
-		stretch_blit(backbuffer_, hw_screen_, 0, 0, virtualScreenW(), virtualScreenH(), 0, 0, SCREEN_W, SCREEN_H);
+		if (native_)
+		{
+			stretch_blit(backbuffer_, nativebuffer_, 0, 0, virtualScreenW(), virtualScreenH(), 0, 0, SCREEN_W, SCREEN_H);
+			set_color_conversion(COLORCONV_TOTAL);
+			blit(nativebuffer_, hw_screen_, 0, 0, 0, 0, SCREEN_W, SCREEN_H);
+		}
+		else
+		{
+			stretch_blit(backbuffer_, hw_screen_, 0, 0, virtualScreenW(), virtualScreenH(), 0, 0, SCREEN_W, SCREEN_H);
+		}
 	}
 	Backend::mouse->unrenderCursor(backbuffer_);
-	frames_this_second++;
+	framesThisSecond_++;
 	return true;
 }
 
@@ -202,11 +331,6 @@ bool GraphicsBackend::setUseNativeColorDepth(bool native)
 	return true;
 }
 
-int GraphicsBackend::getLastFPS()
-{
-	return prev_frames_this_second;
-}
-
 void GraphicsBackend::setVideoModeSwitchDelay(int msec)
 {
 	switchdelay_ = msec;
@@ -225,6 +349,9 @@ bool GraphicsBackend::trySettingVideoMode()
 	if (!initialized_)
 		return false;
 
+	if (headless_)
+		return true;
+
 	Backend::mouse->setCursorVisibility(false);
 
 	screen = hw_screen_;
@@ -383,12 +510,12 @@ bool GraphicsBackend::trySettingVideoMode()
 
 int GraphicsBackend::screenW()
 {
-	return SCREEN_W;
+	return headless_ ? screenw_ : SCREEN_W;
 }
 
 int GraphicsBackend::screenH()
 {
-	return SCREEN_H;
+	return headless_ ? screenh_ : SCREEN_H;
 }
 
 void GraphicsBackend::physicalToVirtual(int &x, int &y)
@@ -7,6 +7,31 @@
 
 struct BITMAP;
 
+/*
+* Frame pacing telemetry collected by waitTick().
+*/
+struct FrameTimingStats
+{
+	// Bucket i counts frames that took [i, i+1) milliseconds; the last
+	// bucket also collects everything slower than that.
+	enum { HISTOGRAM_BUCKETS = 50 };
+
+	// Number of frames shown (showBackBuffer() calls) in the last second.
+	int fps;
+	// Number of waitTick() calls since the stats were last reset.
+	unsigned long frames;
+	// Number of waitTick() calls that were reached after their deadline.
+	unsigned long missedDeadlines;
+	// Number of frames dropped because the program fell more than a whole
+	// frame behind.
+	unsigned long droppedFrames;
+	// Time between the last two waitTick() returns, in microseconds.
+	int lastFrameUsec;
+	// Slowest such interval since the stats were last reset.
+	int worstFrameUsec;
+	unsigned long histogram[HISTOGRAM_BUCKETS];
+};
+
 class GraphicsBackend
 {
 public:	
@@ -121,6 +146,22 @@ public:
 	*/
 	bool initialize();
 
+	/*
+	* Requests that initialize() not open a window or set a video mode. The
+	* virtual screen is then created as a memory bitmap at the first
+	* resolution registered with registerVirtualModes(), and the physical
+	* screen is taken to be the same size. showBackBuffer() and waitTick()
+	* return immediately, and the video mode setters do nothing.
+	* Used to run without a display, e.g. for benchmarks.
+	* Must be called before initialize(). Has no effect afterwards.
+	*/
+	void setHeadless(bool headless);
+
+	/*
+	* Queries whether the graphics backend is running without a display.
+	*/
+	bool isHeadless() { return headless_; }
+
 	/*
 	* Queries the mode chosen for the virtual screen during initialization.
 	* The return value will be an index into the list of desired virtual
@@ -230,6 +271,10 @@ public:
 	* Pauses the program, until the next tick of a clock running at fps frames
 	* per second. Call this function once per event loop iteration to maintain
 	* the program at a constant frame rate.
+	* The wait sleeps for most of the remaining frame time and only spins for
+	* the last millisecond or two, so an idle program doesn't hold a core busy.
+	* If the program falls more than a whole frame behind, the missed ticks
+	* are dropped rather than run back-to-back.
 	* Can only be called after the graphics backend has been initialized.
 	* Does nothing otherwise.
 	*/
@@ -256,13 +301,20 @@ public:
 	bool showBackBuffer();
 
 	/*
-	* Returns the number of frames rendered (i.e., the number of times
-	* showBackBuffer() was called) in the last second. Estimates the
-	* actual FPS of the running programming.
-	* Can only be called after the graphics bakcend has been initialized.
-	* Return value is undefined otherwise.
+	* Returns the frame timing statistics gathered by waitTick(): the number
+	* of frames rendered in the last second (an estimate of the actual FPS
+	* of the running program), a histogram of frame times, and the number
+	* of missed deadlines.
+	* Can only be called after the graphics backend has been initialized.
+	* Contents are undefined otherwise.
+	*/
+	const FrameTimingStats &getFrameStats() { return stats_; }
+
+	/*
+	* Clears the frame time histogram and the missed deadline counters. The
+	* FPS estimate is unaffected.
 	*/
-	int getLastFPS();
+	void resetFrameStats();
 
 	/*
 	* Returns a text description of the video driver and mode currently
@@ -299,7 +351,6 @@ public:
 	*/
 	void virtualToPhysical(int &x, int &y);		
 
-	friend void update_frame_counter();
 	friend void onSwitchIn();
 	friend void onSwitchOut();
 	friend class Backend;
@@ -308,12 +359,14 @@ private:
 	GraphicsBackend();
 
 	bool trySettingVideoMode();
+	void recordFrame(unsigned long long now);
 
 	BITMAP *hw_screen_;
 	BITMAP *backbuffer_;
 	BITMAP *nativebuffer_;
 
 	bool initialized_;
+	bool headless_;
 	int screenw_, screenh_;
 	bool fullscreen_;	
 	bool native_;
@@ -331,9 +384,13 @@ private:
 
 	static bool windowsFullscreenFix_;
 
-	static volatile int frame_counter;
-	static volatile int frames_this_second;
-	static volatile int prev_frames_this_second;
+	// Frame pacing state, in microseconds of the monotonic clock
+	unsigned long long deadline_;
+	unsigned long long lastTick_;
+	unsigned long long secondStart_;
+	int spinMargin_;
+	int framesThisSecond_;
+	FrameTimingStats stats_;
 };
 
 #endif
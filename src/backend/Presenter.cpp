@@ -0,0 +1,132 @@
+#include "Presenter.h"
+#include <cstring>
+#include <vector>
+
+// One magnified source row, already converted to the destination format
+static std::vector<unsigned char> rowbuf;
+
+template<typename T>
+static void expandRow(const unsigned char *src, T *dst, int first, int count, int scale, const T *lut)
+{
+	// first is the offset of the leftmost output pixel from the start of
+	// the magnified row
+	int srcx = first / scale;
+	int run = scale - first % scale;
+
+	while (count > 0)
+	{
+		T c = lut[src[srcx++]];
+		int n = run < count ? run : count;
+
+		for (int i = 0; i < n; i++)
+			dst[i] = c;
+
+		dst += n;
+		count -= n;
+		run = scale;
+	}
+}
+
+template<typename T>
+static void presentRows(BITMAP *src, BITMAP *dest, int sx, int sy, int dx, int dy,
+	int x0, int x1, int y0, int y1, int scale, int scanlineColor, const T *lut)
+{
+	int width = x1 - x0;
+	size_t bytes = width * sizeof(T);
+
+	if (rowbuf.size() < bytes)
+		rowbuf.resize(bytes);
+
+	T *row = (T *)&rowbuf[0];
+	T blank = scanlineColor >= 0 ? lut[scanlineColor & 0xFF] : 0;
+	int expanded = -1;
+
+	acquire_bitmap(dest);
+
+	for (int y = y0; y < y1; y++)
+	{
+		int ry = y - dy;
+		uintptr_t addr = bmp_write_line(dest, y);
+		T *out = (T *)addr + x0;
+
+		if (scanlineColor >= 0 && ry >= 1 && (ry - 1) % scale == 0)
+		{
+			for (int i = 0; i < width; i++)
+				out[i] = blank;
+			continue;
+		}
+
+		int srcrow = ry / scale;
+
+		// Convert each source row once, then copy it to the rest of its
+		// magnified rows
+		if (srcrow != expanded)
+		{
+			expandRow<T>(src->line[sy + srcrow] + sx, row, x0 - dx, width, scale, lut);
+			expanded = srcrow;
+		}
+
+		memcpy(out, row, bytes);
+	}
+
+	bmp_unwrite_line(dest);
+	release_bitmap(dest);
+}
+
+bool blitIntegerScaled(BITMAP *src, BITMAP *dest, int sx, int sy, int w, int h,
+	int dx, int dy, int scale, int scanlineColor, const RGB *pal)
+{
+	if (scale < 1 || !is_memory_bitmap(src) || bitmap_color_depth(src) != 8 || !is_linear_bitmap(dest))
+		return false;
+
+	if (sx < 0 || sy < 0 || sx + w > src->w || sy + h > src->h)
+		return false;
+
+	int depth = bitmap_color_depth(dest);
+
+	if (depth != 8 && (pal == NULL || (depth != 15 && depth != 16 && depth != 32)))
+		return false;
+
+	int x0 = dx > dest->cl ? dx : dest->cl;
+	int y0 = dy > dest->ct ? dy : dest->ct;
+	int x1 = dx + w * scale < dest->cr ? dx + w * scale : dest->cr;
+	int y1 = dy + h * scale < dest->cb ? dy + h * scale : dest->cb;
+
+	if (x0 >= x1 || y0 >= y1)
+		return true;
+
+	if (depth == 8)
+	{
+		static unsigned char identity[256];
+		static bool init = false;
+
+		if (!init)
+		{
+			for (int i = 0; i < 256; i++)
+				identity[i] = (unsigned char)i;
+			init = true;
+		}
+
+		presentRows<unsigned char>(src, dest, sx, sy, dx, dy, x0, x1, y0, y1, scale, scanlineColor, identity);
+	}
+	else if (depth == 32)
+	{
+		uint32_t lut[256];
+
+		for (int i = 0; i < 256; i++)
+			lut[i] = makecol32(_rgb_scale_6[pal[i].r], _rgb_scale_6[pal[i].g], _rgb_scale_6[pal[i].b]);
+
+		presentRows<uint32_t>(src, dest, sx, sy, dx, dy, x0, x1, y0, y1, scale, scanlineColor, lut);
+	}
+	else
+	{
+		uint16_t lut[256];
+
+		for (int i = 0; i < 256; i++)
+			lut[i] = (uint16_t)makecol_depth(depth, _rgb_scale_6[pal[i].r], _rgb_scale_6[pal[i].g], _rgb_scale_6[pal[i].b]);
+
+		presentRows<uint16_t>(src, dest, sx, sy, dx, dy, x0, x1, y0, y1, scale, scanlineColor, lut);
+	}
+
+	return true;
+}
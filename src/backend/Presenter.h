@@ -0,0 +1,28 @@
+#ifndef PRESENTER_H
+#define PRESENTER_H
+
+#include "../zc_alleg.h"
+
+/*
+* Copies the w x h area of the 8-bit bitmap src at (sx, sy) onto dest at
+* (dx, dy), magnified by the integer factor scale. The result is clipped
+* to dest's clipping rectangle. Every destination pixel is written exactly
+* once, and no intermediate bitmaps are used.
+*
+* If dest is 8-bit, the palette indices are copied as they are. If dest is
+* 15-, 16- or 32-bit, each pixel is converted through pal, which must then
+* be supplied. The conversion gives the same colors as a COLORCONV_TOTAL
+* blit would with pal as the current palette.
+*
+* If scanlineColor is not negative, every destination row that is one row
+* below the top of a magnified source row, except the first, is filled with
+* that color instead. With a scale of 2 this gives the usual scanline look.
+*
+* dest can be a video bitmap, as long as it is linear.
+* Returns false, and draws nothing, if src or dest is of an unsupported
+* type or depth. The caller should fall back to stretch_blit() in that case.
+*/
+bool blitIntegerScaled(BITMAP *src, BITMAP *dest, int sx, int sy, int w, int h,
+	int dx, int dy, int scale, int scanlineColor = -1, const RGB *pal = NULL);
+
+#endif
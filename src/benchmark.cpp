@@ -0,0 +1,202 @@
+#include "precompiled.h" //always first
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "benchmark.h"
+#include "zc_clock.h"
+
+#define REPLAY_MAGIC "ZCREPLAY 1"
+
+enum { REPLAY_NONE, REPLAY_RECORD, REPLAY_PLAYBACK };
+
+static int replay_mode = REPLAY_NONE;
+static bool replay_begun = false;
+static unsigned int replay_seed_value = 0;
+static FILE *replay_file = NULL;
+static std::vector<unsigned int> replay_frames;
+static size_t replay_pos = 0;
+
+bool replay_open_record(const char *filename)
+{
+    replay_close();
+    replay_file = fopen(filename, "w");
+    
+    if(!replay_file)
+        return false;
+        
+    replay_mode = REPLAY_RECORD;
+    return true;
+}
+
+bool replay_open_playback(const char *filename)
+{
+    replay_close();
+    FILE *f = fopen(filename, "r");
+    
+    if(!f)
+        return false;
+        
+    char line[64];
+    
+    if(!fgets(line, sizeof(line), f) || strncmp(line, REPLAY_MAGIC, strlen(REPLAY_MAGIC)) != 0 ||
+       fscanf(f, " seed %u", &replay_seed_value) != 1)
+    {
+        fclose(f);
+        return false;
+    }
+    
+    unsigned int mask;
+    
+    while(fscanf(f, " %x", &mask) == 1)
+        replay_frames.push_back(mask);
+        
+    fclose(f);
+    replay_mode = REPLAY_PLAYBACK;
+    return true;
+}
+
+unsigned int replay_seed(unsigned int fallback)
+{
+    if(replay_mode == REPLAY_NONE)
+        return fallback;
+        
+    if(!replay_begun)
+    {
+        replay_begun = true;
+        
+        if(replay_mode == REPLAY_RECORD)
+        {
+            replay_seed_value = fallback;
+            fprintf(replay_file, "%s\nseed %u\n", REPLAY_MAGIC, replay_seed_value);
+        }
+    }
+    
+    return replay_seed_value;
+}
+
+void replay_control_state(bool *state, int count)
+{
+    if(!replay_begun)
+        return;
+        
+    if(replay_mode == REPLAY_RECORD)
+    {
+        unsigned int mask = 0;
+        
+        for(int i=0; i<count; i++)
+            if(state[i])
+                mask |= 1 << i;
+                
+        fprintf(replay_file, "%x\n", mask);
+    }
+    else if(replay_mode == REPLAY_PLAYBACK)
+    {
+        unsigned int mask = replay_pos < replay_frames.size() ? replay_frames[replay_pos++] : 0;
+        
+        for(int i=0; i<count; i++)
+            state[i] = (mask >> i) & 1;
+    }
+}
+
+void replay_close()
+{
+    if(replay_file)
+        fclose(replay_file);
+        
+    replay_file = NULL;
+    replay_frames.clear();
+    replay_pos = 0;
+    replay_mode = REPLAY_NONE;
+    replay_begun = false;
+}
+
+static int bench_target = 0;
+static std::string bench_csv;
+static std::vector<unsigned int> bench_times;
+static unsigned long long bench_last = 0;
+static bool bench_running = false;
+
+void benchmark_start(int frames, const char *csvfile)
+{
+    bench_target = frames;
+    bench_csv = csvfile;
+    bench_times.clear();
+    bench_times.reserve(frames);
+    bench_running = true;
+    bench_last = zc_clock_usec();
+}
+
+bool benchmark_running()
+{
+    return bench_running;
+}
+
+bool benchmark_frame()
+{
+    if(!bench_running)
+        return false;
+        
+    unsigned long long now = zc_clock_usec();
+    bench_times.push_back((unsigned int)(now - bench_last));
+    bench_last = now;
+    return (int)bench_times.size() >= bench_target;
+}
+
+void benchmark_finish(BITMAP *frame, RGB *pal)
+{
+    bench_running = false;
+    
+    // 64-bit FNV-1a over the final frame and palette
+    unsigned long long hash = 14695981039346656037ULL;
+    
+    for(int y=0; y<frame->h; y++)
+    {
+        for(int x=0; x<frame->w; x++)
+        {
+            hash ^= (unsigned char)getpixel(frame, x, y);
+            hash *= 1099511628211ULL;
+        }
+    }
+    
+    for(int i=0; i<PAL_SIZE; i++)
+    {
+        hash ^= pal[i].r | (pal[i].g << 8) | (pal[i].b << 16);
+        hash *= 1099511628211ULL;
+    }
+    
+    unsigned long long total = 0;
+    unsigned int worst = 0;
+    unsigned int best = bench_times.empty() ? 0 : bench_times[0];
+    FILE *f = fopen(bench_csv.c_str(), "w");
+    
+    if(f)
+        fprintf(f, "frame,usec\n");
+        
+    for(size_t i=0; i<bench_times.size(); i++)
+    {
+        total += bench_times[i];
+        
+        if(bench_times[i] > worst) worst = bench_times[i];
+        
+        if(bench_times[i] < best) best = bench_times[i];
+        
+        if(f)
+            fprintf(f, "%d,%u\n", (int)i, bench_times[i]);
+    }
+    
+    if(f)
+        fclose(f);
+    else
+        al_trace("Benchmark: couldn't write %s\n", bench_csv.c_str());
+        
+    int frames = (int)bench_times.size();
+    double avg = frames ? (double)total / frames / 1000.0 : 0.0;
+    char summary[256];
+    sprintf(summary, "Benchmark: %d/%d frames in %.3f ms (avg %.3f ms, min %.3f ms, max %.3f ms), frame hash %08x%08x\n",
+            frames, bench_target, total / 1000.0, avg, best / 1000.0, worst / 1000.0,
+            (unsigned int)(hash >> 32), (unsigned int)hash);
+    printf("%s", summary);
+    al_trace("%s", summary);
+}
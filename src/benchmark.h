@@ -0,0 +1,44 @@
+#ifndef _ZC_BENCHMARK_H_
+#define _ZC_BENCHMARK_H_
+
+#include "zc_alleg.h"
+
+// Input replays. The game input read by load_control_state() is written
+// to, or read back from, a file once per call, starting at the first
+// init_game(). Together with the fixed random seed stored in the file,
+// this makes a replayed game follow the recorded one frame for frame.
+
+// Opens filename for writing a new recording. Returns false on failure.
+bool replay_open_record(const char *filename);
+
+// Reads a recording made with replay_open_record(). Returns false if the
+// file couldn't be read or isn't a replay.
+bool replay_open_playback(const char *filename);
+
+// Returns the random seed to use for a new game. With a replay open this
+// is the recorded seed (and recording or playback begins with this call);
+// otherwise it's fallback.
+unsigned int replay_seed(unsigned int fallback);
+
+// Records state, or replaces it with the recorded input once playback
+// has begun. Past the end of a recording, no buttons are held.
+void replay_control_state(bool *state, int count);
+
+void replay_close();
+
+// Benchmarks. Each advanceframe() is timed from the end of the previous
+// one. When the requested number of frames have run, the timings are
+// written to a CSV file and a summary, with a hash of the final frame,
+// is printed.
+
+void benchmark_start(int frames, const char *csvfile);
+bool benchmark_running();
+
+// Call once per frame. Returns true once the last frame has been timed.
+bool benchmark_frame();
+
+// Writes the results. frame and pal are hashed to catch changes in
+// behaviour between builds.
+void benchmark_finish(BITMAP *frame, RGB *pal);
+
+#endif
@@ -29,6 +29,8 @@
 #include "rendertarget.h"
 #include "backend/AllBackends.h"
 #include "pal.h"
+#include "tiles.h"
+#include "profiler.h"
 #include "zdefs.h"
 #include "zq_class.h"
 
@@ -3297,6 +3299,7 @@ void set_register(const long arg, const long value)
         //FFC Variables
     case DATA:
         tmpscr->ffdata[ri->ffcref] = vbound(value / 10000, 0, MAXCOMBOS - 1);
+        screencombos_changed();
         break;
 
     case CHANGEFFSCRIPTR:
@@ -3308,10 +3311,10 @@ void set_register(const long arg, const long value)
         break;
 
     case FFSCRIPT:
-        for (long i = 1; i < MAX_ZCARRAY_SIZE; i++)
+        for (word i = firstOwnedArray(ri->ffcref), next; i != 0; i = next)
         {
-            if (arrayOwner[i] == ri->ffcref)
-                FFScript::deallocateZScriptArray(i);
+            next = nextOwnedArray(i);
+            FFScript::deallocateZScriptArray(i);
         }
 
         tmpscr->ffscript[ri->ffcref] = vbound(value / 10000, 0, scripts.ffscripts.size() - 1);
@@ -3903,7 +3906,7 @@ void set_register(const long arg, const long value)
         //TODO script module support        
         if (0 != (s = checkItem(ri->itemref)))
         {
-            ItemDefinitionRef newref(((item *)s)->itemDefinition.module, value / 10000);
+            ItemDefinitionRef newref = ItemDefinitionRef::fromId(((item *)s)->itemDefinition.moduleId, value / 10000);
             if (!curQuest->isValid(newref))
             {
                 Z_scripterrlog("Cannot set item to invalid item ID %ld", value / 10000);
@@ -3911,7 +3914,7 @@ void set_register(const long arg, const long value)
             else
             {
                 ((item *)s)->itemDefinition = newref;
-                flushItemCache();
+                verifyItems();
             }
         }
 
@@ -5238,6 +5241,7 @@ if(GuyH::loadNPC(ri->guyref, str) == SH::_NoError) \
             }
             
             combobuf[tmpscr->data[pos]].type=value/10000;
+            combotypes_changed();
             
             for(int i = 0; i < 176; i++)
             {
@@ -5264,7 +5268,10 @@ if(GuyH::loadNPC(ri->guyref, str) == SH::_NoError) \
         int pos = (ri->d[0])/10000;
         
         if(pos >= 0 && pos < 176)
+        {
             combobuf[tmpscr->data[pos]].walk=(value/10000)&15;
+            walkflags_changed();
+        }
     }
     break;
     
@@ -5378,6 +5385,7 @@ if(GuyH::loadNPC(ri->guyref, str) == SH::_NoError) \
         }
         
         combobuf[cdata].type=value/10000;
+        combotypes_changed();
         
         for(int i = 0; i < 176; i++)
         {
@@ -5420,6 +5428,7 @@ if(GuyH::loadNPC(ri->guyref, str) == SH::_NoError) \
         
         long scr = m*MAPSCRS+sc;
         combobuf[TheMaps[scr].data[pos]].walk=(value/10000)&15;
+        walkflags_changed();
     }
     break;
     
@@ -5864,9 +5873,9 @@ void do_allocatemem(const bool v, const bool local, const byte i)
     if(local)
     {
         //localRAM[0] is used as an invalid container, so 0 can be the NULL pointer in ZScript
-        for(ptrval = 1; localRAM[ptrval].Size() != 0; ptrval++) ;
+        ptrval = allocLocalArraySlot(i);
         
-        if(ptrval >= MAX_ZCARRAY_SIZE)
+        if(ptrval == 0)
         {
             Z_scripterrlog("%d local arrays already in use, no more can be allocated\n", MAX_ZCARRAY_SIZE-1);
             ptrval = 0;
@@ -5879,22 +5888,22 @@ void do_allocatemem(const bool v, const bool local, const byte i)
             
             for(dword j = 0; j < (dword)size; j++)
                 a[j] = 0; //initialize array
-                
-            // Keep track of which FFC created the array so we know which to deallocate when changing screens
-            arrayOwner[ptrval]=i;
         }
     }
     else
     {
         //Globals are only allocated here at first play, otherwise in init_game
-        for(ptrval = 0; game->globalRAM[ptrval].Size() != 0; ptrval++) ;
+        long slot = allocGlobalArraySlot();
         
-        if(ptrval >= game->globalRAM.size())
+        if(slot < 0)
         {
-            al_trace("Invalid pointer value of %ld passed to global allocate\n", ptrval);
+            al_trace("No global array left to allocate\n");
             //this shouldn't happen, unless people are putting ALLOCATEGMEM in their ZASM scripts where they shouldn't be
+            set_register(sarg1, 0);
+            return;
         }
         
+        ptrval = slot;
         ZScriptArray &a = game->globalRAM[ptrval];
         
         a.Resize(size);
@@ -7378,111 +7387,114 @@ void do_message(const bool v)
 
 INLINE void set_drawing_command_args(const int j, const word numargs)
 {
+    int *sdci = script_drawing_commands[j];
+    
     for(int k = 1; k <= numargs; k++)
-        script_drawing_commands[j][k] = SH::read_stack(ri->sp + (numargs - k));
+        sdci[k] = SH::read_stack(ri->sp + (numargs - k));
 }
 
-void do_drawing_command(const int script_command)
+// Number of stack arguments taken by each drawing command.
+static word drawing_command_args(const int script_command)
 {
-    int j = script_drawing_commands.GetNext();
-    
-    if(j == -1)  //out of drawing command space
-    {
-        Z_scripterrlog("Max draw primitive limit reached\n");
-        return;
-    }
-    
-    script_drawing_commands[j][0] = script_command;
-    script_drawing_commands[j][18] = zscriptDrawingRenderTarget->GetCurrentRenderTarget(); // no fixed bs.
-    
     switch(script_command)
     {
     case RECTR:
-        set_drawing_command_args(j, 12);
-        break;
+        return 12;
         
     case CIRCLER:
-        set_drawing_command_args(j, 11);
-        break;
+        return 11;
         
     case ARCR:
-        set_drawing_command_args(j, 14);
-        break;
+        return 14;
         
     case ELLIPSER:
-        set_drawing_command_args(j, 12);
-        break;
+        return 12;
         
     case LINER:
-        set_drawing_command_args(j, 11);
-        break;
+        return 11;
         
     case PUTPIXELR:
-        set_drawing_command_args(j, 8);
-        break;
+        return 8;
         
     case DRAWTILER:
-        set_drawing_command_args(j, 15);
-        break;
+        return 15;
         
     case DRAWCOMBOR:
-        set_drawing_command_args(j, 16);
-        break;
+        return 16;
         
     case FASTTILER:
-        set_drawing_command_args(j, 6);
-        break;
+        return 6;
         
     case FASTCOMBOR:
-        set_drawing_command_args(j, 6);
-        break;
+        return 6;
         
     case DRAWCHARR:
-        set_drawing_command_args(j, 10);
-        break;
+        return 10;
         
     case DRAWINTR:
-        set_drawing_command_args(j, 11);
-        break;
+        return 11;
         
     case SPLINER:
-        set_drawing_command_args(j, 11);
-        break;
+        return 11;
         
     case QUADR:
-        set_drawing_command_args(j, 15);
-        break;
+        return 15;
         
     case TRIANGLER:
-        set_drawing_command_args(j, 13);
-        break;
+        return 13;
         
     case BITMAPR:
-        set_drawing_command_args(j, 12);
-        break;
-    
+        return 12;
+        
     case BITMAPEXR:
-        set_drawing_command_args(j, 16);
-        break;
+        return 16;
         
     case DRAWLAYERR:
-        set_drawing_command_args(j, 8);
-        break;
+        return 8;
         
     case DRAWSCREENR:
-        set_drawing_command_args(j, 6);
-        break;
+        return 6;
+        
+    case QUAD3DR:
+    case TRIANGLE3DR:
+        return 8;
+        
+    case DRAWSTRINGR:
+        return 9;
+    }
+    
+    return 0;
+}
+
+void do_drawing_command(const int script_command)
+{
+    const word numargs = drawing_command_args(script_command);
+    
+    if(numargs == 0)
+        return;
         
+    int j = script_drawing_commands.GetNext(script_command, numargs,
+                                            zscriptDrawingRenderTarget->GetCurrentRenderTarget());
+    
+    if(j == -1)  //out of drawing command space
+    {
+        Z_scripterrlog("Max draw primitive limit reached\n");
+        return;
+    }
+    
+    set_drawing_command_args(j, numargs);
+    
+    switch(script_command)
+    {
     case QUAD3DR:
     {
-        long* v = script_drawing_commands[j].AllocateDrawBuffer(26 * sizeof(long));
+        long* v = script_drawing_commands.AllocateDrawBuffer(j, 26 * sizeof(long));
         
         long* pos = v + 0;
         long* uv = v + 12;
         long* col = v + 20;
         long* size = v + 24;
         
-        set_drawing_command_args(j, 8);
         ArrayH::getValues(script_drawing_commands[j][2] / 10000, pos, 12);
         ArrayH::getValues(script_drawing_commands[j][3] / 10000, uv, 8);
         ArrayH::getValues(script_drawing_commands[j][4] / 10000, col, 4);
@@ -7494,14 +7506,13 @@ void do_drawing_command(const int script_command)
     
     case TRIANGLE3DR:
     {
-        long *v = script_drawing_commands[j].AllocateDrawBuffer(20 * sizeof(long));
+        long *v = script_drawing_commands.AllocateDrawBuffer(j, 20 * sizeof(long));
         
         long* pos = v + 0;
         long* uv = v + 9;
         long* col = v + 15;
         long* size = v + 18;
         
-        set_drawing_command_args(j, 8);
         ArrayH::getValues(script_drawing_commands[j][2] / 10000, pos, 8);
         ArrayH::getValues(script_drawing_commands[j][3] / 10000, uv, 6);
         ArrayH::getValues(script_drawing_commands[j][4] / 10000, col, 3);
@@ -7513,18 +7524,17 @@ void do_drawing_command(const int script_command)
     
     case DRAWSTRINGR:
     {
-        set_drawing_command_args(j, 9);
-
 		long arrayID = script_drawing_commands[j][8] / 10000;
 		int length = ArrayH::strlen(arrayID);
 		if(length > 0)
 		{
-			char *str = (char*)script_drawing_commands[j].AllocateDrawBuffer(length + 1);
+			char *str = (char*)script_drawing_commands.AllocateDrawBuffer(j, length + 1);
 			ArrayH::uncheckedGetCString(arrayID, str, length);
 		}
 		else
 		{
 			script_drawing_commands.AbortDrawingCommand();
+			return;
 		}
     }
     break;
@@ -7600,6 +7610,8 @@ void do_drawing_command(const int script_command)
 	//break;
 
 	} //switch
+    
+    script_drawing_commands.Submit(j);
 }
 
 void do_set_rendertarget(bool)
@@ -8154,10 +8166,294 @@ void do_combotile(const bool v)
     if(BC::checkCombo(combo, "Game->ComboTile") != SH::_NoError)
         return;
         
+    sync_combo_animation(combo);
     set_register(sarg1, combobuf[combo].tile * 10000);
 }
 
 
+///----------------------------------------------------------------------------------------------------//
+//                                       Instruction decoding                                          //
+///----------------------------------------------------------------------------------------------------//
+
+// Specialized handlers for decoded instructions. ZOP_SLOW goes through the
+// generic switch in run_script().
+enum
+{
+    ZOP_SLOW, ZOP_SET, ZOP_ADD, ZOP_SUB, ZOP_MULT, ZOP_COMP, ZOP_PUSH, ZOP_POP,
+    ZOP_LOADI, ZOP_STOREI, ZOP_GOTO, ZOP_GOTOR, ZOP_GOTOTRUE, ZOP_GOTOFALSE,
+    ZOP_GOTOMORE, ZOP_GOTOLESS, ZOP_SETTRUE, ZOP_SETFALSE, ZOP_SETMORE, ZOP_SETLESS
+};
+
+// Operand kinds
+enum
+{
+    ZARG_NONE, ZARG_VALUE, ZARG_DREG, ZARG_AREG, ZARG_SP, ZARG_VAR
+};
+
+static byte classify_register(const long arg)
+{
+    if(arg >= D(0) && arg <= D(7))
+        return ZARG_DREG;
+    else if(arg >= A(0) && arg <= A(1))
+        return ZARG_AREG;
+    else if(arg == SP)
+        return ZARG_SP;
+        
+    return ZARG_VAR;
+}
+
+// Builds the decoded copy of a script's commands. Any instruction touching an
+// engine variable is left to the generic path, since those can have side
+// effects that depend on sarg1/sarg2.
+static zasm_decoded *decode_script(ZAsmScript &s)
+{
+    s.decoded = new zasm_decoded[s.commands_len];
+    bool terminated = false;
+    
+    for(int j = 0; j < s.commands_len; j++)
+    {
+        const zasm &c = s.commands[j];
+        zasm_decoded &d = s.decoded[j];
+        d.command = c.command;
+        d.arg1 = c.arg1;
+        d.arg2 = c.arg2;
+        d.op = ZOP_SLOW;
+        d.kinds = 0;
+        
+        // Commands past the terminator were never read from the quest
+        if(terminated)
+            continue;
+            
+        if(c.command == 0xFFFF)
+        {
+            terminated = true;
+            continue;
+        }
+        
+        byte op = ZOP_SLOW;
+        byte k1 = ZARG_NONE, k2 = ZARG_NONE;
+        
+        switch(c.command)
+        {
+        case SETV:    op = ZOP_SET;    k1 = classify_register(c.arg1); k2 = ZARG_VALUE; break;
+        case SETR:    op = ZOP_SET;    k1 = classify_register(c.arg1); k2 = classify_register(c.arg2); break;
+        case ADDV:    op = ZOP_ADD;    k1 = classify_register(c.arg1); k2 = ZARG_VALUE; break;
+        case ADDR:    op = ZOP_ADD;    k1 = classify_register(c.arg1); k2 = classify_register(c.arg2); break;
+        case SUBV:    op = ZOP_SUB;    k1 = classify_register(c.arg1); k2 = ZARG_VALUE; break;
+        case SUBR:    op = ZOP_SUB;    k1 = classify_register(c.arg1); k2 = classify_register(c.arg2); break;
+        case MULTV:   op = ZOP_MULT;   k1 = classify_register(c.arg1); k2 = ZARG_VALUE; break;
+        case MULTR:   op = ZOP_MULT;   k1 = classify_register(c.arg1); k2 = classify_register(c.arg2); break;
+        case COMPAREV:op = ZOP_COMP;   k1 = classify_register(c.arg1); k2 = ZARG_VALUE; break;
+        case COMPARER:op = ZOP_COMP;   k1 = classify_register(c.arg1); k2 = classify_register(c.arg2); break;
+        case PUSHV:   op = ZOP_PUSH;   k1 = ZARG_VALUE; break;
+        case PUSHR:   op = ZOP_PUSH;   k1 = classify_register(c.arg1); break;
+        case POP:     op = ZOP_POP;    k1 = classify_register(c.arg1); break;
+        case LOADI:   op = ZOP_LOADI;  k1 = classify_register(c.arg1); k2 = classify_register(c.arg2); break;
+        case STOREI:  op = ZOP_STOREI; k1 = classify_register(c.arg1); k2 = classify_register(c.arg2); break;
+        case GOTO:    op = ZOP_GOTO;      break;
+        case GOTOTRUE:op = ZOP_GOTOTRUE;  break;
+        case GOTOFALSE:op = ZOP_GOTOFALSE;break;
+        case GOTOMORE:op = ZOP_GOTOMORE;  break;
+        case GOTOLESS:op = ZOP_GOTOLESS;  break;
+        case GOTOR:   op = ZOP_GOTOR;   k1 = classify_register(c.arg1); break;
+        case SETTRUE: op = ZOP_SETTRUE; k1 = classify_register(c.arg1); break;
+        case SETFALSE:op = ZOP_SETFALSE;k1 = classify_register(c.arg1); break;
+        case SETMORE: op = ZOP_SETMORE; k1 = classify_register(c.arg1); break;
+        case SETLESS: op = ZOP_SETLESS; k1 = classify_register(c.arg1); break;
+        }
+        
+        if(k1 == ZARG_VAR || k2 == ZARG_VAR)
+            continue;
+            
+        d.op = op;
+        d.kinds = k1 | (k2 << 4);
+    }
+    
+    return s.decoded;
+}
+
+static INLINE long decoded_read(const byte kind, const long arg)
+{
+    switch(kind)
+    {
+    case ZARG_DREG:
+        return ri->d[arg - D(0)];
+        
+    case ZARG_AREG:
+        return ri->a[arg - A(0)];
+        
+    case ZARG_SP:
+        return ri->sp * 10000;
+    }
+    
+    return arg;
+}
+
+static INLINE void decoded_write(const byte kind, const long arg, const long value)
+{
+    switch(kind)
+    {
+    case ZARG_DREG:
+        ri->d[arg - D(0)] = value;
+        break;
+        
+    case ZARG_AREG:
+        ri->a[arg - A(0)] = value;
+        break;
+        
+    case ZARG_SP:
+        ri->sp = value / 10000;
+        break;
+    }
+}
+
+// Runs one specialized instruction. These mirror the do_* functions used by
+// the generic path exactly, minus the get_register/set_register lookups.
+static INLINE void run_decoded(const zasm_decoded &c, dword &pc, bool &increment)
+{
+    const byte k1 = c.kinds & 0x0F;
+    const byte k2 = c.kinds >> 4;
+    
+    switch(c.op)
+    {
+    case ZOP_SET:
+        decoded_write(k1, c.arg1, decoded_read(k2, c.arg2));
+        break;
+        
+    case ZOP_ADD:
+    {
+        long temp = decoded_read(k2, c.arg2);
+        long temp2 = decoded_read(k1, c.arg1);
+        decoded_write(k1, c.arg1, temp2 + temp);
+    }
+    break;
+    
+    case ZOP_SUB:
+    {
+        long temp = decoded_read(k2, c.arg2);
+        long temp2 = decoded_read(k1, c.arg1);
+        decoded_write(k1, c.arg1, temp2 - temp);
+    }
+    break;
+    
+    case ZOP_MULT:
+    {
+        long long temp = decoded_read(k2, c.arg2);
+        long temp2 = decoded_read(k1, c.arg1);
+        decoded_write(k1, c.arg1, long((temp * temp2) / 10000));
+    }
+    break;
+    
+    case ZOP_COMP:
+    {
+        long temp = decoded_read(k2, c.arg2);
+        long temp2 = decoded_read(k1, c.arg1);
+        
+        if(temp2 >= temp)   ri->scriptflag |= MOREFLAG;
+        else                ri->scriptflag &= ~MOREFLAG;
+        
+        if(temp2 == temp)   ri->scriptflag |= TRUEFLAG;
+        else                ri->scriptflag &= ~TRUEFLAG;
+    }
+    break;
+    
+    case ZOP_PUSH:
+    {
+        const long value = decoded_read(k1, c.arg1);
+        ri->sp--;
+        SH::write_stack(ri->sp, value);
+    }
+    break;
+    
+    case ZOP_POP:
+    {
+        const long value = SH::read_stack(ri->sp);
+        ri->sp++;
+        decoded_write(k1, c.arg1, value);
+    }
+    break;
+    
+    case ZOP_LOADI:
+    {
+        const long stackoffset = decoded_read(k2, c.arg2) / 10000;
+        const long value = SH::read_stack(stackoffset);
+        decoded_write(k1, c.arg1, value);
+    }
+    break;
+    
+    case ZOP_STOREI:
+    {
+        const long stackoffset = decoded_read(k2, c.arg2) / 10000;
+        const long value = decoded_read(k1, c.arg1);
+        SH::write_stack(stackoffset, value);
+    }
+    break;
+    
+    case ZOP_GOTO:
+        pc = c.arg1;
+        increment = false;
+        break;
+        
+    case ZOP_GOTOR:
+        pc = (decoded_read(k1, c.arg1) / 10000) - 1;
+        increment = false;
+        break;
+        
+    case ZOP_GOTOTRUE:
+        if(ri->scriptflag & TRUEFLAG)
+        {
+            pc = c.arg1;
+            increment = false;
+        }
+        
+        break;
+        
+    case ZOP_GOTOFALSE:
+        if(!(ri->scriptflag & TRUEFLAG))
+        {
+            pc = c.arg1;
+            increment = false;
+        }
+        
+        break;
+        
+    case ZOP_GOTOMORE:
+        if(ri->scriptflag & MOREFLAG)
+        {
+            pc = c.arg1;
+            increment = false;
+        }
+        
+        break;
+        
+    case ZOP_GOTOLESS:
+        if(!(ri->scriptflag & MOREFLAG) || (!get_bit(quest_rules,qr_GOTOLESSNOTEQUAL) && (ri->scriptflag & TRUEFLAG)))
+        {
+            pc = c.arg1;
+            increment = false;
+        }
+        
+        break;
+        
+    case ZOP_SETTRUE:
+        decoded_write(k1, c.arg1, (ri->scriptflag & TRUEFLAG) ? 1 : 0);
+        break;
+        
+    case ZOP_SETFALSE:
+        decoded_write(k1, c.arg1, (ri->scriptflag & TRUEFLAG) ? 0 : 1);
+        break;
+        
+    case ZOP_SETMORE:
+        decoded_write(k1, c.arg1, (ri->scriptflag & MOREFLAG) ? 1 : 0);
+        break;
+        
+    case ZOP_SETLESS:
+        decoded_write(k1, c.arg1, (!(ri->scriptflag & MOREFLAG)
+                                   || (ri->scriptflag & TRUEFLAG)) ? 1 : 0);
+        break;
+    }
+}
+
 ///----------------------------------------------------------------------------------------------------//
 //                                       Run the script                                                //
 ///----------------------------------------------------------------------------------------------------//
@@ -8240,10 +8536,11 @@ int run_script(const byte type, const word script, const byte i)
         break;
     }
     
+    const zasm_decoded *code = curscript->decoded ? curscript->decoded : decode_script(*curscript);
     dword pc = ri->pc; //this is (marginally) quicker than dereferencing ri each time
-    word scommand = curscript->commands[pc].command;
-    sarg1 = curscript->commands[pc].arg1;
-    sarg2 = curscript->commands[pc].arg2;
+    word scommand = code[pc].command;
+    sarg1 = code[pc].arg1;
+    sarg2 = code[pc].arg2;
     
     
 #ifdef _FFDISSASSEMBLY
@@ -8294,7 +8591,9 @@ int run_script(const byte type, const word script, const byte i)
 #endif
 #endif
         
-        switch(scommand)
+        if(code[pc].op != ZOP_SLOW)
+            run_decoded(code[pc], pc, increment);
+        else switch(scommand)
         {
         case QUIT:
             scommand = 0xFFFF;
@@ -9372,9 +9671,9 @@ int run_script(const byte type, const word script, const byte i)
         
         if(scommand != 0xFFFF)
         {
-            scommand = curscript->commands[pc].command;
-            sarg1 = curscript->commands[pc].arg1;
-            sarg2 = curscript->commands[pc].arg2;
+            scommand = code[pc].command;
+            sarg1 = code[pc].arg1;
+            sarg2 = code[pc].arg2;
         }
     }
     
@@ -9433,6 +9732,8 @@ int run_script(const byte type, const word script, const byte i)
 
 int ffscript_engine(const bool preload)
 {
+    ProfileScope prof(PROF_FFC_SCRIPTS);
+    
     for(byte i = 0; i < MAXFFCS; i++)
     {
         if(tmpscr->ffscript[i] == 0)
@@ -9630,7 +9931,7 @@ void FFScript::deallocateZScriptArray(const long ptrval)
         Z_scripterrlog("Script tried to deallocate memory at invalid address %ld\n", ptrval);
     else
     {
-        arrayOwner[ptrval] = 255;
+        freeLocalArraySlot(ptrval);
         
         if(localRAM[ptrval].Size() == 0)
             Z_scripterrlog("Script tried to deallocate memory that was not allocated at address %ld\n", ptrval);
@@ -9868,10 +10169,10 @@ void FFScript::do_triggersecret(const bool v)
 
 void FFScript::do_changeffcscript(const bool v){
 	long ID = vbound((SH::get_arg(sarg1, v) / 10000), 0, 255);
-	for(long i = 1; i < MAX_ZCARRAY_SIZE; i++)
+	for(word i = firstOwnedArray(ri->ffcref), next; i != 0; i = next)
 	{
-	    if(arrayOwner[i]==ri->ffcref)
-		FFScript::deallocateZScriptArray(i);
+	    next = nextOwnedArray(i);
+	    FFScript::deallocateZScriptArray(i);
 	}
 	
 	tmpscr->ffscript[ri->ffcref] = vbound(ID/10000, 0, scripts.ffscripts.size()-1);
@@ -10220,7 +10521,8 @@ void set_itemdata_register(long arg, long value)
     {
     case IDATAFAMILY:
         idata.family = vbound(value / 10000, 0, 254);
-        flushItemCache();
+        Quest::itemFamiliesChanged();
+        verifyItems();
         break;
 
     case IDATAUSEWPN:
@@ -10297,7 +10599,8 @@ void set_itemdata_register(long arg, long value)
     //item level
     case IDATALEVEL:
         idata.fam_type = vbound(value / 10000, 0, 512);
-        flushItemCache();
+        Quest::itemFamiliesChanged();
+        verifyItems();
         break;
         //bool keep
     case IDATAKEEP:
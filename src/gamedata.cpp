@@ -12,6 +12,7 @@
 #include "precompiled.h" //always first
 
 #include <stdio.h>
+#include <algorithm>
 #include "zc_alleg.h"
 #include "zdefs.h"
 #include "zelda.h"
@@ -19,11 +20,30 @@
 #include "pal.h"
 
 extern int dlevel;
-extern void flushItemCache();
+extern void verifyItems();
 extern zinitdata zinit;
 extern void Z_eventlog(char *format,...);
 extern void ringcolor(bool forceDefault);
 
+// Orders the owned items of a family by level, breaking ties the way the
+// quest's module tables are laid out (module name, then slot).
+struct family_item_order
+{
+    bool operator()(const ItemDefinitionRef &a, const ItemDefinitionRef &b) const
+    {
+        int alevel = curQuest->getItemDefinition(a).fam_type;
+        int blevel = curQuest->getItemDefinition(b).fam_type;
+        
+        if (alevel != blevel)
+            return alevel < blevel;
+            
+        if (a.moduleId != b.moduleId)
+            return a.moduleName() < b.moduleName();
+            
+        return a.slot < b.slot;
+    }
+};
+
 // Debug variables: these log certain operations on gamedata when active.
 // Should help me debug those item bugs.
 
@@ -40,6 +60,7 @@ void gamedata::Clear()
     _cheat=0;
     inventoryItems.clear();
     disabledItems.clear();
+    familyItemsEpoch=0;
     std::fill(_maxcounter, _maxcounter+32, 0);
     std::fill(_counter, _counter+32, 0);
     std::fill(_dcounter, _dcounter+32, 0);
@@ -81,6 +102,7 @@ void gamedata::Copy(const gamedata& g)
     
     inventoryItems = g.inventoryItems;
     disabledItems = g.disabledItems;
+    familyItemsEpoch = 0;
     
     for(byte i = 0; i < 32; i++)
     {
@@ -786,7 +808,7 @@ void gamedata::set_cont_percent(bool ispercent)
 void gamedata::set_item(const ItemDefinitionRef &itemref, bool value)
 {
     set_item_no_flush(itemref, value);
-    flushItemCache();
+    verifyItems();
 }
 
 void gamedata::set_disabled_item(const ItemDefinitionRef &itemref, uint8_t value)
@@ -821,6 +843,49 @@ void gamedata::set_item_no_flush(const ItemDefinitionRef &itemref, bool value)
         if (it != inventoryItems.end())
             inventoryItems.erase(it);
     }
+    
+    if (value != curvalue && familyItemsEpoch == Quest::itemFamilyEpoch() && curQuest->isValid(itemref))
+    {
+        std::vector<ItemDefinitionRef> &items = familyItems[curQuest->getItemDefinition(itemref).family];
+        std::vector<ItemDefinitionRef>::iterator it = std::lower_bound(items.begin(), items.end(), itemref, family_item_order());
+        
+        if (value)
+            items.insert(it, itemref);
+        else if (it != items.end() && *it == itemref)
+            items.erase(it);
+    }
+}
+
+void gamedata::clear_items()
+{
+    inventoryItems.clear();
+    disabledItems.clear();
+    familyItemsEpoch=0;
+}
+
+const std::vector<ItemDefinitionRef> &gamedata::get_family_items(byte family)
+{
+    if (familyItemsEpoch != Quest::itemFamilyEpoch())
+    {
+        for (int i = 0; i < 256; i++)
+            familyItems[i].clear();
+            
+        for (std::set<ItemDefinitionRef>::iterator it = inventoryItems.begin(); it != inventoryItems.end(); ++it)
+        {
+            if (curQuest->isValid(*it))
+                familyItems[curQuest->getItemDefinition(*it).family].push_back(*it);
+        }
+        
+        for (int i = 0; i < 256; i++)
+        {
+            if (familyItems[i].size() > 1)
+                std::sort(familyItems[i].begin(), familyItems[i].end(), family_item_order());
+        }
+        
+        familyItemsEpoch = Quest::itemFamilyEpoch();
+    }
+    
+    return familyItems[family];
 }
 
 /*** end of gamedata.cpp ***/
@@ -13,6 +13,7 @@
 
 #include <string.h>
 #include <stdio.h>
+#include <algorithm>
 #include "zc_alleg.h"
 #include "guys.h"
 #include "zelda.h"
@@ -752,7 +753,7 @@ void enemy::FireWeapon()
         int bc=0;
 
         //TODO module support for summoning?
-        EnemyDefinitionRef summon(enemyDefinition.module, dmiscs[2]);
+        EnemyDefinitionRef summon = EnemyDefinitionRef::fromId(enemyDefinition.moduleId, dmiscs[2]);
         
         for(int gc=0; gc<guys.Count(); gc++)
         {
@@ -4707,6 +4708,8 @@ void enemy::removearmos(int ax,int ay)
         Backend::sfx->play(tmpscr->secretsfx,128);
     }
     
+    screencombos_changed();
+    
     if(f == mfARMOS_ITEM || f2 == mfARMOS_ITEM)
     {
         if(!getmapflag())
@@ -6892,7 +6895,7 @@ bool eStalfos::animate(int index)
         stop_bgsfx(index);
         int kids = guys.Count();
         //TODO module support for splitting?
-        EnemyDefinitionRef child(enemyDefinition.module, dmiscs[2]);
+        EnemyDefinitionRef child = EnemyDefinitionRef::fromId(enemyDefinition.moduleId, dmiscs[2]);
         for(int i=0; i < dmiscs[3]; i++)
         {
             int spawndir = curQuest->getEnemyDefinition(child).family == eeKEESE ? 0 : i;
@@ -7329,7 +7332,7 @@ bool eStalfos::animate(int index)
     {
         int kids = guys.Count();
         //TODO module split support?        
-        EnemyDefinitionRef id2(enemyDefinition.module, dmiscs[2]);
+        EnemyDefinitionRef id2 = EnemyDefinitionRef::fromId(enemyDefinition.moduleId, dmiscs[2]);
         
         for(int i=0; i<dmiscs[3]; i++)
         {
@@ -7716,7 +7719,7 @@ bool eKeese::animate(int index)
                 int kids = guys.Count();
                 bool success = false;
                 //TODO module support for enemy splitting?
-                EnemyDefinitionRef id2(enemyDefinition.module, dmiscs[2]);
+                EnemyDefinitionRef id2 = EnemyDefinitionRef::fromId(enemyDefinition.moduleId, dmiscs[2]);
                 success = 0 != addenemy((fix)x,(fix)y,id2,-24);
                 
                 if(success)
@@ -7952,7 +7955,7 @@ void eWizzrobe::wizzrobe_attack_for_real()
         int bc=0;
 
         //TODO module support for summoning?
-        EnemyDefinitionRef ref(enemyDefinition.module, dmiscs[2]);
+        EnemyDefinitionRef ref = EnemyDefinitionRef::fromId(enemyDefinition.moduleId, dmiscs[2]);
         
         for(int gc=0; gc<guys.Count(); gc++)
         {
@@ -9015,7 +9018,7 @@ bool eBigDig::animate(int index)
         for (int i = 0; i < dmiscs[4]; i++)
         {
             int curpos = guys.Count();
-            EnemyDefinitionRef child(enemyDefinition.module, dmiscs[0]);
+            EnemyDefinitionRef child = EnemyDefinitionRef::fromId(enemyDefinition.moduleId, dmiscs[0]);
             if (addenemy(x, y, child, -15))
             {
                 ((enemy *)guys.spr(curpos))->count_enemy = false;
@@ -9025,7 +9028,7 @@ bool eBigDig::animate(int index)
         for (int i = 0; i < dmiscs[5]; i++)
         {
             int curpos = guys.Count();
-            EnemyDefinitionRef child(enemyDefinition.module, dmiscs[1]);
+            EnemyDefinitionRef child = EnemyDefinitionRef::fromId(enemyDefinition.moduleId, dmiscs[1]);
             if (addenemy(x, y, child, -15))
             {
                 ((enemy *)guys.spr(curpos))->count_enemy = false;
@@ -9035,7 +9038,7 @@ bool eBigDig::animate(int index)
         for (int i = 0; i < dmiscs[6]; i++)
         {
             int curpos = guys.Count();
-            EnemyDefinitionRef child(enemyDefinition.module, dmiscs[2]);
+            EnemyDefinitionRef child = EnemyDefinitionRef::fromId(enemyDefinition.moduleId, dmiscs[2]);
             if (addenemy(x, y, child, -15))
             {
                 ((enemy *)guys.spr(curpos))->count_enemy = false;
@@ -9045,7 +9048,7 @@ bool eBigDig::animate(int index)
         for (int i = 0; i < dmiscs[7]; i++)
         {
             int curpos = guys.Count();
-            EnemyDefinitionRef child(enemyDefinition.module, dmiscs[3]);
+            EnemyDefinitionRef child = EnemyDefinitionRef::fromId(enemyDefinition.moduleId, dmiscs[3]);
             if (addenemy(x, y, child, -15))
             {
                 ((enemy *)guys.spr(curpos))->count_enemy = false;
@@ -12808,6 +12811,7 @@ void screen_combo_modify_preroutine(mapscr *s, int pos)
 // Everything that must be done after we change a screen's combo to another combo. -L
 void screen_combo_modify_postroutine(mapscr *s, int pos)
 {
+    screencombos_changed();
     activate_fireball_statue(pos);
     
     if(combobuf[s->data[pos]].type==cSPINTILE1)
@@ -14289,21 +14293,46 @@ int message_more_y()
 
 /***  Collision detection & handling  ***/
 
+// Aquamentus stretches its hit box when tested against some weapons
+static bool unbounded_enemy(sprite *s)
+{
+    return ((enemy*)s)->family==eeAQUA;
+}
+
+// After a hit, sprites may have moved, spawned or been removed. Rebuild and
+// pick up with the candidates that come after index j.
+static unsigned int recheck_candidates(collision_grid &grid, sprite *s, std::vector<int> &candidates, int j)
+{
+    grid.invalidate();
+    grid.query(s, candidates);
+    return std::upper_bound(candidates.begin(), candidates.end(), j) - candidates.begin();
+}
+
 void check_collisions()
 {
+    static collision_grid enemygrid(guys, unbounded_enemy);
+    static collision_grid itemgrid(items);
+    static std::vector<int> candidates;
+    enemygrid.invalidate();
+    itemgrid.invalidate();
+    
     for(int i=0; i<Lwpns.Count(); i++)
     {
         weapon *w = (weapon*)Lwpns.spr(i);
         
         if(!(w->Dead()) && w->id!=wSword && w->id!=wHammer && w->id!=wWand)
         {
-            for(int j=0; j<guys.Count(); j++)
+            enemygrid.query(w, candidates);
+            
+            for(unsigned int c=0; c<candidates.size();)
             {
+                int j = candidates[c];
                 enemy *e = (enemy*)guys.spr(j);
                 
                 if(e->hit(w))
                 {
                     int h = e->takehit(w);
+                    itemgrid.invalidate();
                     
                     // NOT FOR PUBLIC RELEASE
                     /*if(h==3) //Mirror shield
@@ -14343,8 +14372,15 @@ void check_collisions()
                     
                     if(h==2)
                     {
+                        enemygrid.invalidate();
                         break;
                     }
+                    
+                    c = recheck_candidates(enemygrid, w, candidates, j);
+                }
+                else
+                {
+                    ++c;
                 }
                 
                 if(w->Dead())
@@ -14357,8 +14393,12 @@ void check_collisions()
             {
                 if(w->id == wBrang || w->id==wHookshot)
                 {
-                    for(int j=0; j<items.Count(); j++)
+                    itemgrid.query(w, candidates);
+                    
+                    for(unsigned int c=0; c<candidates.size(); c++)
                     {
+                        int j = candidates[c];
+                        
                         if(items.spr(j)->hit(w))
                         {
                             bool priced = ((item*)items.spr(j))->PriceIndex >-1;
@@ -14391,8 +14431,12 @@ void check_collisions()
             {
                 if(w->id == wBrang || w->id == wArrow || w->id==wHookshot)
                 {
-                    for(int j=0; j<items.Count(); j++)
+                    itemgrid.query(w, candidates);
+                    
+                    for(unsigned int c=0; c<candidates.size();)
                     {
+                        int j = candidates[c];
+                        
                         if(items.spr(j)->hit(w))
                         {
                             bool priced = ((item*)items.spr(j))->PriceIndex >-1;
@@ -14409,8 +14453,13 @@ void check_collisions()
                                 //items.del(j);
                                 Link->checkitems(j);
                                 //--j;
+                                enemygrid.invalidate();
+                                c = recheck_candidates(itemgrid, w, candidates, j);
+                                continue;
                             }
                         }
+                        
+                        ++c;
                     }
                 }
             }
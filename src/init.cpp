@@ -1944,8 +1944,7 @@ void resetItems(gamedata *game2, zinitdata *zinit2, bool lvlitems)
     game2->set_maxcounter(zinit2->max_keys, 5);
     
     //set up the items
-    game2->inventoryItems.clear();
-    game2->disabledItems.clear();
+    game2->clear_items();
 
     for (std::set<ItemDefinitionRef>::iterator it = zinit2->inventoryItems.begin(); it != zinit2->inventoryItems.end(); ++it)
     {
@@ -1969,7 +1968,7 @@ void resetItems(gamedata *game2, zinitdata *zinit2, bool lvlitems)
         }
     }
     
-    flushItemCache();
+    verifyItems();
     
     //Then set up the counters
     game2->set_bombs(zinit2->bombs);
@@ -2014,6 +2013,6 @@ void resetItems(gamedata *game2, zinitdata *zinit2, bool lvlitems)
     game2->set_arrows(zinit2->arrows);
     
     //flush the cache again (in case bombs became illegal to use by setting bombs to 0)
-    flushItemCache();
+    verifyItems();
 }
 
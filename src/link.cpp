@@ -2474,6 +2474,8 @@ void LinkClass::check_slash_block(int bx, int by)
         }
     }
     
+    screencombos_changed();
+    
     if(!ignorescreen)
     {
         if(!isTouchyType(type)) set_bit(screengrid,i,1);
@@ -2725,11 +2727,16 @@ void LinkClass::check_pound_block(int bx, int by)
         }
     }
     
+    screencombos_changed();
+    
     if(!ignorescreen)
     {
         if(pound)
+        {
             s->data[i]+=1;
-            
+            screencombos_changed();
+        }
+        
         set_bit(screengrid,i,1);
         
         if((flag==mfARMOS_ITEM||flag2==mfARMOS_ITEM) && !getmapflag())
@@ -3706,6 +3713,29 @@ void LinkClass::addsparkle2(int type1, int type2)
 }
 
 // returns true when game over
+static const int awarptypes[5] = { cAWARPA, cAWARPB, cAWARPC, cAWARPD, cAWARPR };
+
+// Position of the first combo (or FFC) on the screen that's an auto side
+// warp, or -1. which is set to its type's index in awarptypes.
+static int first_auto_warp(bool ff, int &which)
+{
+    int first = -1;
+    
+    for(int t=0; t<5; t++)
+    {
+        const byte *pos;
+        int n = ff ? ffcs_of_type(awarptypes[t], &pos) : combos_of_type(awarptypes[t], &pos);
+        
+        if(n && (first<0 || pos[0]<first))
+        {
+            first = pos[0];
+            which = t;
+        }
+    }
+    
+    return first;
+}
+
 bool LinkClass::animate(int)
 {
     int lsave=0;
@@ -4524,105 +4554,24 @@ bool LinkClass::animate(int)
         }
     }
     
-    bool awarp = false;
+    int awarptype;
     
-    for(int i=0; i<176; i++)
+    for(int ff=0; ff<2; ff++)
     {
-    
-        int ind=0;
-        
-        if(!awarp)
-        {
-            if(combobuf[tmpscr->data[i]].type==cAWARPA)
-            {
-                awarp=true;
-                ind=0;
-            }
-            else if(combobuf[tmpscr->data[i]].type==cAWARPB)
-            {
-                awarp=true;
-                ind=1;
-            }
-            else if(combobuf[tmpscr->data[i]].type==cAWARPC)
-            {
-                awarp=true;
-                ind=2;
-            }
-            else if(combobuf[tmpscr->data[i]].type==cAWARPD)
-            {
-                awarp=true;
-                ind=3;
-            }
-            else if(combobuf[tmpscr->data[i]].type==cAWARPR)
-            {
-                awarp=true;
-                ind=rand()%4;
-            }
+        if(first_auto_warp(ff!=0, awarptype) < 0)
+            continue;
             
-            if(awarp)
-            {
-                if(tmpscr->flags5&fDIRECTAWARP)
-                {
-                    didpit=true;
-                    pitx=x;
-                    pity=y;
-                }
-                
-                sdir = dir;
-                dowarp(1,ind);
-            }
-        }
-        
-    }
-    
-    awarp=false;
-    
-    for(int i=0; i<32; i++)
-    {
-        int ind=0;
+        int ind = (awarptype<4) ? awarptype : rand()%4;
         
-        if(!awarp)
+        if(tmpscr->flags5&fDIRECTAWARP)
         {
-            if(combobuf[tmpscr->ffdata[i]].type==cAWARPA)
-            {
-                awarp=true;
-                ind=0;
-            }
-            else if(combobuf[tmpscr->ffdata[i]].type==cAWARPB)
-            {
-                awarp=true;
-                ind=1;
-            }
-            else if(combobuf[tmpscr->ffdata[i]].type==cAWARPC)
-            {
-                awarp=true;
-                ind=2;
-            }
-            else if(combobuf[tmpscr->ffdata[i]].type==cAWARPD)
-            {
-                awarp=true;
-                ind=3;
-            }
-            else if(combobuf[tmpscr->ffdata[i]].type==cAWARPR)
-            {
-                awarp=true;
-                ind=rand()%4;
-            }
-            
-            if(awarp)
-            {
-                if(tmpscr->flags5&fDIRECTAWARP)
-                {
-                    didpit=true;
-                    pitx=x;
-                    pity=y;
-                }
-                
-                sdir = dir;
-                dowarp(1,ind);
-            }
+            didpit=true;
+            pitx=x;
+            pity=y;
         }
         
+        sdir = dir;
+        dowarp(1,ind);
     }
     
     if(ffwarp)
@@ -5478,12 +5427,12 @@ bool LinkClass::startwpn(const ItemDefinitionRef &itemid)
             int hookitem = curQuest->getItemDefinition(itemid).fam_type;
             int hookpower = curQuest->getItemDefinition(itemid).power;
             
-            if(Lwpns.Count()>=SLMAX)
+            if(Lwpns.Count()>=sprite_list::Limit())
             {
                 Lwpns.del(0);
             }
             
-            if(Lwpns.Count()>=SLMAX-1)
+            if(Lwpns.Count()>=sprite_list::Limit()-1)
             {
                 Lwpns.del(0);
             }
@@ -9540,6 +9489,7 @@ void LinkClass::checktouchblk()
                 }
                 case cBSGRAVE:
                     tmpscr->data[di]++;
+                    screencombos_changed();
 
                     //fall through
                 case cGRAVE:
@@ -10393,6 +10343,7 @@ void LinkClass::checkspecial2(int *ls)
             if(COMBOTYPE(tx+8,ty+8)==cSTEP)
             {
                 tmpscr->data[stepnext]++;
+                screencombos_changed();
             }
             
             if(COMBOTYPE(tx+8,ty+8)==cSTEPSAME)
@@ -10406,22 +10357,32 @@ void LinkClass::checkspecial2(int *ls)
                         tmpscr->data[k]++;
                     }
                 }
+                
+                screencombos_changed();
             }
             
             if(COMBOTYPE(tx+8,ty+8)==cSTEPALL)
             {
-                for(int k=0; k<176; k++)
+                static const int steptypes[4] = { cSTEP, cSTEPSAME, cSTEPALL, cSTEPCOPY };
+                byte steps[176];
+                int n = 0;
+                
+                // Collect them all first; the index changes as they're stepped
+                for(int t=0; t<4; t++)
                 {
-                    if(
-                        (combobuf[tmpscr->data[k]].type==cSTEP)||
-                        (combobuf[tmpscr->data[k]].type==cSTEPSAME)||
-                        (combobuf[tmpscr->data[k]].type==cSTEPALL)||
-                        (combobuf[tmpscr->data[k]].type==cSTEPCOPY)
-                    )
-                    {
-                        tmpscr->data[k]++;
-                    }
+                    const byte *pos;
+                    int count = combos_of_type(steptypes[t], &pos);
+                    
+                    for(int k=0; k<count; k++)
+                        steps[n++] = pos[k];
+                }
+                
+                for(int k=0; k<n; k++)
+                {
+                    tmpscr->data[steps[k]]++;
                 }
+                
+                screencombos_changed();
             }
         }
     }
@@ -15227,6 +15188,8 @@ void LinkClass::gameover()
                             trans_table2.data[0][q] = q;
                             trans_table2.data[q][q] = q;
                         }
+                        
+                        color_tables_changed();
                     }
                     
                     if(f>=60 && f<=169)
@@ -15251,6 +15214,8 @@ void LinkClass::gameover()
                             trans_table2.data[q][q] = q;
                         }
                         
+                        color_tables_changed();
+                        
                         refreshpal=true;
                     }
                 }
@@ -111,14 +111,13 @@ bool checktrigger=false;
 void debugging_box(int x1, int y1, int x2, int y2)
 {
     //reference/optimization: the start of the unused drawing command index can now be queried. -Gleeok
-    int index = script_drawing_commands.GetNext();
+    int index = script_drawing_commands.GetNext(RECTR, 12, 0);
     
     if(index < 0)
         return;
         
-    int *sdci = &script_drawing_commands[index][0];
+    int *sdci = script_drawing_commands[index];
     
-    sdci[0] = RECTR;
     sdci[1] = 30000;
     sdci[2] = x1*10000;
     sdci[3] = y1*10000;
@@ -131,6 +130,8 @@ void debugging_box(int x1, int y1, int x2, int y2)
     sdci[10] = 0;
     sdci[11] = 10000;
     sdci[12] = 1280000;
+    
+    script_drawing_commands.Submit(index);
 }
 
 void clear_dmap(word i)
@@ -562,6 +563,7 @@ void update_combo_cycling()
     {
         x=tmpscr->data[i];
         y=animated_combo_table[x][0];
+        sync_combo_cycling(x);
         
         if(combobuf[x].animflags & AF_FRESH) continue;
         
@@ -585,6 +587,7 @@ void update_combo_cycling()
     {
         x=tmpscr->data[i];
         y=animated_combo_table2[x][0];
+        sync_combo_cycling(x);
         
         if(!(combobuf[x].animflags & AF_FRESH)) continue;
         
@@ -622,6 +625,7 @@ void update_combo_cycling()
     {
         x=tmpscr->ffdata[i];
         y=animated_combo_table[x][0];
+        sync_combo_cycling(x);
         
         if(combobuf[x].animflags & AF_FRESH) continue;
         
@@ -645,6 +649,7 @@ void update_combo_cycling()
     {
         x=tmpscr->ffdata[i];
         y=animated_combo_table2[x][0];
+        sync_combo_cycling(x);
         
         if(!(combobuf[x].animflags & AF_FRESH)) continue;
         
@@ -671,6 +676,7 @@ void update_combo_cycling()
             
         tmpscr->ffdata[i]=newdata[i];
         tmpscr->ffcset[i]=newcset[i];
+        screencombos_changed();
         
         newdata[i]=-1;
         newcset[i]=-1;
@@ -686,6 +692,7 @@ void update_combo_cycling()
             {
                 x=(tmpscr2+j)->data[i];
                 y=animated_combo_table[x][0];
+                sync_combo_cycling(x);
                 
                 if(combobuf[x].animflags & AF_FRESH) continue;
                 
@@ -709,6 +716,7 @@ void update_combo_cycling()
             {
                 x=(tmpscr2+j)->data[i];
                 y=animated_combo_table2[x][0];
+                sync_combo_cycling(x);
                 
                 if(!(combobuf[x].animflags & AF_FRESH)) continue;
                 
@@ -767,6 +775,7 @@ void update_combo_cycling()
     {
         if(restartanim[i])
         {
+            sync_combo_cycling(i);
             combobuf[i].tile = animated_combo_table[i][1];
             animated_combo_table4[animated_combo_table[i][0]][1]=0;
             restartanim[i]=false;
@@ -774,6 +783,7 @@ void update_combo_cycling()
         
         if(restartanim2[i])
         {
+            sync_combo_cycling(i);
             combobuf[i].tile = animated_combo_table2[i][1];
             animated_combo_table4[animated_combo_table[i][0]][1]=0;
             restartanim2[i]=false;
@@ -836,6 +846,7 @@ bool hiddenstair(int tmp,bool redraw)                       // tmp = index of tm
         s->data[di] = s->secretcombo[sSTAIRS];
         s->cset[di] = s->secretcset[sSTAIRS];
         s->sflag[di] = s->secretflag[sSTAIRS];
+        screencombos_changed();
         
         if(redraw)
             putcombo(scrollbuf,s->stairx,s->stairy,s->data[di],s->cset[di]);
@@ -877,6 +888,9 @@ bool remove_screenstatecombos(int tmp, int what1, int what2)
         }
     }
     
+    if(didit)
+        screencombos_changed();
+        
     return didit;
 }
 
@@ -1604,6 +1618,8 @@ void hidden_entrance(int tmp,bool , bool high16only,int single) //Perhaps better
     
 endhe:
 
+    screencombos_changed();
+    
     if(tmpscr->flags4&fDISABLETIME) //Finish timed warp if 'Secrets Disable Timed Warp'
     {
         activated_timed_warp=true;
@@ -1903,6 +1919,7 @@ void update_freeform_combos()
                         zc_swap(tmpscr->ffflags[j],tmpscr->ffflags[k]);
                     }
                     
+                    screencombos_changed();
                     break;
                 }
             }
@@ -1957,6 +1974,7 @@ void update_freeform_combos()
             {
                 tmpscr->ffdata[i]=0;
                 tmpscr->ffflags[i]&=~ffCARRYOVER;
+                screencombos_changed();
             }
         }
         
@@ -1974,6 +1992,7 @@ void update_freeform_combos()
             {
                 tmpscr->ffdata[i]=0;
                 tmpscr->ffflags[i]&=~ffCARRYOVER;
+                screencombos_changed();
             }
         }
         
@@ -1991,6 +2010,7 @@ void update_freeform_combos()
             {
                 tmpscr->ffdata[i]=0;
                 tmpscr->ffflags[i]&=~ffCARRYOVER;
+                screencombos_changed();
             }
         }
         
@@ -2008,6 +2028,7 @@ void update_freeform_combos()
             {
                 tmpscr->ffdata[i]=0;
                 tmpscr->ffflags[i]&=~ffCARRYOVER;
+                screencombos_changed();
             }
         }
     }
@@ -2239,17 +2260,11 @@ void do_scrolling_layer(BITMAP *bmp, int type, mapscr* layer, int x, int y, bool
                     {
                         if(tempscreen==2)
                         {
-                            for(int i=0; i<176; i++)
-                            {
-                                overcombo(bmp,((i&15)<<4)-x,(i&0xF0)+playing_field_offset-y,tmpscr2[type].data[i],tmpscr2[type].cset[i]);
-                            }
+                            put_layer_combos(bmp,-x,playing_field_offset-y,&tmpscr2[type].data[0],&tmpscr2[type].cset[0],true);
                         }
                         else
                         {
-                            for(int i=0; i<176; i++)
-                            {
-                                overcombo(bmp,((i&15)<<4)-x,(i&0xF0)+playing_field_offset-y,tmpscr3[type].data[i],tmpscr3[type].cset[i]);
-                            }
+                            put_layer_combos(bmp,-x,playing_field_offset-y,&tmpscr3[type].data[0],&tmpscr3[type].cset[0],true);
                         }
                     }
                     else
@@ -2276,17 +2291,11 @@ void do_scrolling_layer(BITMAP *bmp, int type, mapscr* layer, int x, int y, bool
                     {
                         if(tempscreen==2)
                         {
-                            for(int i=0; i<176; i++)
-                            {
-                                overcombo(bmp,((i&15)<<4)-x,(i&0xF0)+playing_field_offset-y,tmpscr2[type].data[i],tmpscr2[type].cset[i]);
-                            }
+                            put_layer_combos(bmp,-x,playing_field_offset-y,&tmpscr2[type].data[0],&tmpscr2[type].cset[0],true);
                         }
                         else
                         {
-                            for(int i=0; i<176; i++)
-                            {
-                                overcombo(bmp,((i&15)<<4)-x,(i&0xF0)+playing_field_offset-y,tmpscr3[type].data[i],tmpscr3[type].cset[i]);
-                            }
+                            put_layer_combos(bmp,-x,playing_field_offset-y,&tmpscr3[type].data[0],&tmpscr3[type].cset[0],true);
                         }
                     }
                     else
@@ -2325,34 +2334,22 @@ void do_scrolling_layer(BITMAP *bmp, int type, mapscr* layer, int x, int y, bool
                         {
                             if(tempscreen==2)
                             {
-                                for(int i=0; i<176; i++)
-                                {
-                                    putcombo(bmp,((i&15)<<4)-x,(i&0xF0)+playing_field_offset-y,tmpscr2[type].data[i],tmpscr2[type].cset[i]);
-                                }
+                                put_layer_combos(bmp,-x,playing_field_offset-y,&tmpscr2[type].data[0],&tmpscr2[type].cset[0],false);
                             }
                             else
                             {
-                                for(int i=0; i<176; i++)
-                                {
-                                    putcombo(bmp,((i&15)<<4)-x,(i&0xF0)+playing_field_offset-y,tmpscr3[type].data[i],tmpscr3[type].cset[i]);
-                                }
+                                put_layer_combos(bmp,-x,playing_field_offset-y,&tmpscr3[type].data[0],&tmpscr3[type].cset[0],false);
                             }
                         }
                         else
                         {
                             if(tempscreen==2)
                             {
-                                for(int i=0; i<176; i++)
-                                {
-                                    overcombo(bmp,((i&15)<<4)-x,(i&0xF0)+playing_field_offset-y,tmpscr2[type].data[i],tmpscr2[type].cset[i]);
-                                }
+                                put_layer_combos(bmp,-x,playing_field_offset-y,&tmpscr2[type].data[0],&tmpscr2[type].cset[0],true);
                             }
                             else
                             {
-                                for(int i=0; i<176; i++)
-                                {
-                                    overcombo(bmp,((i&15)<<4)-x,(i&0xF0)+playing_field_offset-y,tmpscr3[type].data[i],tmpscr3[type].cset[i]);
-                                }
+                                put_layer_combos(bmp,-x,playing_field_offset-y,&tmpscr3[type].data[0],&tmpscr3[type].cset[0],true);
                             }
                         }
                     }
@@ -2362,17 +2359,11 @@ void do_scrolling_layer(BITMAP *bmp, int type, mapscr* layer, int x, int y, bool
                         {
                             if(tempscreen==2)
                             {
-                                for(int i=0; i<176; i++)
-                                {
-                                    putcombo(bmp,((i&15)<<4)-x,(i&0xF0)+playing_field_offset-y,tmpscr2[type].data[i],tmpscr2[type].cset[i]);
-                                }
+                                put_layer_combos(bmp,-x,playing_field_offset-y,&tmpscr2[type].data[0],&tmpscr2[type].cset[0],false);
                             }
                             else
                             {
-                                for(int i=0; i<176; i++)
-                                {
-                                    putcombo(bmp,((i&15)<<4)-x,(i&0xF0)+playing_field_offset-y,tmpscr3[type].data[i],tmpscr3[type].cset[i]);
-                                }
+                                put_layer_combos(bmp,-x,playing_field_offset-y,&tmpscr3[type].data[0],&tmpscr3[type].cset[0],false);
                             }
                         }
                         else
@@ -2402,34 +2393,22 @@ void do_scrolling_layer(BITMAP *bmp, int type, mapscr* layer, int x, int y, bool
                         {
                             if(tempscreen==2)
                             {
-                                for(int i=0; i<176; i++)
-                                {
-                                    putcombo(bmp,((i&15)<<4)-x,(i&0xF0)+playing_field_offset-y,tmpscr2[type].data[i],tmpscr2[type].cset[i]);
-                                }
+                                put_layer_combos(bmp,-x,playing_field_offset-y,&tmpscr2[type].data[0],&tmpscr2[type].cset[0],false);
                             }
                             else
                             {
-                                for(int i=0; i<176; i++)
-                                {
-                                    putcombo(bmp,((i&15)<<4)-x,(i&0xF0)+playing_field_offset-y,tmpscr3[type].data[i],tmpscr3[type].cset[i]);
-                                }
+                                put_layer_combos(bmp,-x,playing_field_offset-y,&tmpscr3[type].data[0],&tmpscr3[type].cset[0],false);
                             }
                         }
                         else
                         {
                             if(tempscreen==2)
                             {
-                                for(int i=0; i<176; i++)
-                                {
-                                    overcombo(bmp,((i&15)<<4)-x,(i&0xF0)+playing_field_offset-y,tmpscr2[type].data[i],tmpscr2[type].cset[i]);
-                                }
+                                put_layer_combos(bmp,-x,playing_field_offset-y,&tmpscr2[type].data[0],&tmpscr2[type].cset[0],true);
                             }
                             else
                             {
-                                for(int i=0; i<176; i++)
-                                {
-                                    overcombo(bmp,((i&15)<<4)-x,(i&0xF0)+playing_field_offset-y,tmpscr3[type].data[i],tmpscr3[type].cset[i]);
-                                }
+                                put_layer_combos(bmp,-x,playing_field_offset-y,&tmpscr3[type].data[0],&tmpscr3[type].cset[0],true);
                             }
                         }
                     }
@@ -2439,17 +2418,11 @@ void do_scrolling_layer(BITMAP *bmp, int type, mapscr* layer, int x, int y, bool
                         {
                             if(tempscreen==2)
                             {
-                                for(int i=0; i<176; i++)
-                                {
-                                    putcombo(bmp,((i&15)<<4)-x,(i&0xF0)+playing_field_offset-y,tmpscr2[type].data[i],tmpscr2[type].cset[i]);
-                                }
+                                put_layer_combos(bmp,-x,playing_field_offset-y,&tmpscr2[type].data[0],&tmpscr2[type].cset[0],false);
                             }
                             else
                             {
-                                for(int i=0; i<176; i++)
-                                {
-                                    putcombo(bmp,((i&15)<<4)-x,(i&0xF0)+playing_field_offset-y,tmpscr3[type].data[i],tmpscr3[type].cset[i]);
-                                }
+                                put_layer_combos(bmp,-x,playing_field_offset-y,&tmpscr3[type].data[0],&tmpscr3[type].cset[0],false);
                             }
                         }
                         else
@@ -2489,34 +2462,22 @@ void do_scrolling_layer(BITMAP *bmp, int type, mapscr* layer, int x, int y, bool
                         {
                             if(tempscreen==2)
                             {
-                                for(int i=0; i<176; i++)
-                                {
-                                    putcombo(bmp,((i&15)<<4)-x,(i&0xF0)+playing_field_offset-y,tmpscr2[type].data[i],tmpscr2[type].cset[i]);
-                                }
+                                put_layer_combos(bmp,-x,playing_field_offset-y,&tmpscr2[type].data[0],&tmpscr2[type].cset[0],false);
                             }
                             else
                             {
-                                for(int i=0; i<176; i++)
-                                {
-                                    putcombo(bmp,((i&15)<<4)-x,(i&0xF0)+playing_field_offset-y,tmpscr3[type].data[i],tmpscr3[type].cset[i]);
-                                }
+                                put_layer_combos(bmp,-x,playing_field_offset-y,&tmpscr3[type].data[0],&tmpscr3[type].cset[0],false);
                             }
                         }
                         else
                         {
                             if(tempscreen==2)
                             {
-                                for(int i=0; i<176; i++)
-                                {
-                                    overcombo(bmp,((i&15)<<4)-x,(i&0xF0)+playing_field_offset-y,tmpscr2[type].data[i],tmpscr2[type].cset[i]);
-                                }
+                                put_layer_combos(bmp,-x,playing_field_offset-y,&tmpscr2[type].data[0],&tmpscr2[type].cset[0],true);
                             }
                             else
                             {
-                                for(int i=0; i<176; i++)
-                                {
-                                    overcombo(bmp,((i&15)<<4)-x,(i&0xF0)+playing_field_offset-y,tmpscr3[type].data[i],tmpscr3[type].cset[i]);
-                                }
+                                put_layer_combos(bmp,-x,playing_field_offset-y,&tmpscr3[type].data[0],&tmpscr3[type].cset[0],true);
                             }
                         }
                     }
@@ -2526,17 +2487,11 @@ void do_scrolling_layer(BITMAP *bmp, int type, mapscr* layer, int x, int y, bool
                         {
                             if(tempscreen==2)
                             {
-                                for(int i=0; i<176; i++)
-                                {
-                                    putcombo(bmp,((i&15)<<4)-x,(i&0xF0)+playing_field_offset-y,tmpscr2[type].data[i],tmpscr2[type].cset[i]);
-                                }
+                                put_layer_combos(bmp,-x,playing_field_offset-y,&tmpscr2[type].data[0],&tmpscr2[type].cset[0],false);
                             }
                             else
                             {
-                                for(int i=0; i<176; i++)
-                                {
-                                    putcombo(bmp,((i&15)<<4)-x,(i&0xF0)+playing_field_offset-y,tmpscr3[type].data[i],tmpscr3[type].cset[i]);
-                                }
+                                put_layer_combos(bmp,-x,playing_field_offset-y,&tmpscr3[type].data[0],&tmpscr3[type].cset[0],false);
                             }
                         }
                         else
@@ -2566,34 +2521,22 @@ void do_scrolling_layer(BITMAP *bmp, int type, mapscr* layer, int x, int y, bool
                         {
                             if(tempscreen==2)
                             {
-                                for(int i=0; i<176; i++)
-                                {
-                                    putcombo(bmp,((i&15)<<4)-x,(i&0xF0)+playing_field_offset-y,tmpscr2[type].data[i],tmpscr2[type].cset[i]);
-                                }
+                                put_layer_combos(bmp,-x,playing_field_offset-y,&tmpscr2[type].data[0],&tmpscr2[type].cset[0],false);
                             }
                             else
                             {
-                                for(int i=0; i<176; i++)
-                                {
-                                    putcombo(bmp,((i&15)<<4)-x,(i&0xF0)+playing_field_offset-y,tmpscr3[type].data[i],tmpscr3[type].cset[i]);
-                                }
+                                put_layer_combos(bmp,-x,playing_field_offset-y,&tmpscr3[type].data[0],&tmpscr3[type].cset[0],false);
                             }
                         }
                         else
                         {
                             if(tempscreen==2)
                             {
-                                for(int i=0; i<176; i++)
-                                {
-                                    overcombo(bmp,((i&15)<<4)-x,(i&0xF0)+playing_field_offset-y,tmpscr2[type].data[i],tmpscr2[type].cset[i]);
-                                }
+                                put_layer_combos(bmp,-x,playing_field_offset-y,&tmpscr2[type].data[0],&tmpscr2[type].cset[0],true);
                             }
                             else
                             {
-                                for(int i=0; i<176; i++)
-                                {
-                                    overcombo(bmp,((i&15)<<4)-x,(i&0xF0)+playing_field_offset-y,tmpscr3[type].data[i],tmpscr3[type].cset[i]);
-                                }
+                                put_layer_combos(bmp,-x,playing_field_offset-y,&tmpscr3[type].data[0],&tmpscr3[type].cset[0],true);
                             }
                         }
                     }
@@ -2603,17 +2546,11 @@ void do_scrolling_layer(BITMAP *bmp, int type, mapscr* layer, int x, int y, bool
                         {
                             if(tempscreen==2)
                             {
-                                for(int i=0; i<176; i++)
-                                {
-                                    putcombo(bmp,((i&15)<<4)-x,(i&0xF0)+playing_field_offset-y,tmpscr2[type].data[i],tmpscr2[type].cset[i]);
-                                }
+                                put_layer_combos(bmp,-x,playing_field_offset-y,&tmpscr2[type].data[0],&tmpscr2[type].cset[0],false);
                             }
                             else
                             {
-                                for(int i=0; i<176; i++)
-                                {
-                                    putcombo(bmp,((i&15)<<4)-x,(i&0xF0)+playing_field_offset-y,tmpscr3[type].data[i],tmpscr3[type].cset[i]);
-                                }
+                                put_layer_combos(bmp,-x,playing_field_offset-y,&tmpscr3[type].data[0],&tmpscr3[type].cset[0],false);
                             }
                         }
                         else
@@ -3479,6 +3416,7 @@ void put_door(BITMAP *dest,int t,int pos,int side,int type,bool redraw,bool even
             break;
         }
         
+        screencombos_changed();
         break;
         
     default:
@@ -3818,23 +3756,11 @@ void openshutters()
 void loadscr(int tmp,int destdmap, int scr,int ldir,bool overlay=false)
 {
     //  introclk=intropos=msgclk=msgpos=dmapmsgclk=0;
-    for(word x=0; x<animated_combos; x++)
-    {
-        if(combobuf[animated_combo_table4[x][0]].nextcombo!=0)
-        {
-            animated_combo_table4[x][1]=0;
-        }
-    }
-    
-    for(word x=0; x<animated_combos2; x++)
-    {
-        if(combobuf[animated_combo_table24[x][0]].nextcombo!=0)
-        {
-            animated_combo_table24[x][1]=0;
-        }
-    }
+    reset_combo_clocks();
+    reset_combo_clocks2();
     
     reset_combo_animations2();
+    combotypes_changed();
     
     
     mapscr ffscr = tmpscr[tmp];
@@ -3888,10 +3814,16 @@ void loadscr(int tmp,int destdmap, int scr,int ldir,bool overlay=false)
     if(tmp==0)
     {
         // Before loading new FFCs, deallocate the arrays used by those that aren't carrying over
-        for(long i = 1; i < MAX_ZCARRAY_SIZE; i++)
+        for(byte owner = 0; owner < 32; owner++)
         {
-            if(arrayOwner[i]<32 && (!(ffscr.ffflags[arrayOwner[i]]&ffCARRYOVER) || ffscr.flags5&fNOFFCARRYOVER))
+            if((ffscr.ffflags[owner]&ffCARRYOVER) && !(ffscr.flags5&fNOFFCARRYOVER))
+                continue;
+                
+            for(word i = firstOwnedArray(owner), next; i != 0; i = next)
+            {
+                next = nextOwnedArray(i);
                 FFScript::deallocateZScriptArray(i);
+            }
         }
         
         for(int i = 0; i < 32; i++)
@@ -4120,18 +4052,18 @@ void loadscr(int tmp,int destdmap, int scr,int ldir,bool overlay=false)
             }
         }
     }
+    
+    // the screen's combos were replaced after the combotypes_changed() above
+    screencombos_changed();
+    
+    if(tmp==0)
+        prefetch_DmapMusic();
 }
 
 // Screen is being viewed by the Overworld Map viewer.
 void loadscr2(int tmp,int scr,int)
 {
-    for(word x=0; x<animated_combos; x++)
-    {
-        if(combobuf[animated_combo_table4[x][0]].nextcombo!=0)
-        {
-            animated_combo_table4[x][1]=0;
-        }
-    }
+    reset_combo_clocks();
     
     const int _mapsSize = (ZCMaps[currmap].tileWidth)*(ZCMaps[currmap].tileHeight);
     
@@ -4293,27 +4225,180 @@ void loadscr2(int tmp,int scr,int)
     
 }
 
-void putscr(BITMAP* dest,int x,int y, mapscr* scrn)
+// Layer cache: the combos of a screen layer that look the same every frame
+// are drawn once into a 256x176 bitmap, which is then blitted each frame.
+// Animated and Link-facing combos are left out and drawn over it. A slot is
+// rebuilt when its combos or csets differ from the layer's, or a tile or combo
+// type changed.
+#define LAYER_CACHE_SLOTS 16
+
+// bumped by combotypes_changed()
+static dword combo_revision=0;
+
+struct layer_cache_slot
 {
-    if(scrn->valid==0||!show_layer_0)
+    BITMAP *bmp;
+    const word *source;
+    word data[176];
+    byte cset[176];
+    bool over;
+    dword tile_rev;
+    dword combo_rev;
+    dword last_used;
+    byte dynamic[176];
+    int dynamic_count;
+};
+
+static layer_cache_slot layer_cache[LAYER_CACHE_SLOTS];
+static dword layer_cache_clock=0;
+
+void clear_layer_cache()
+{
+    for(int i=0; i<LAYER_CACHE_SLOTS; i++)
     {
-        rectfill(dest,x,y,x+255,y+175,0);
-        return;
+        if(layer_cache[i].bmp)
+            destroy_bitmap(layer_cache[i].bmp);
+            
+        layer_cache[i].bmp=NULL;
+        layer_cache[i].source=NULL;
     }
+}
+
+static bool is_static_combo(int cmbdat)
+{
+    const newcombo &c = combobuf[cmbdat];
     
-    for(int i=0; i<176; i++)
+    if(c.frames>1 || combo_class_buf[c.type].directional_change_type)
+        return false;
+        
+    // bad tiles are drawn as an opaque black square, even by overcombo()
+    return c.tile<NEWMAXTILES;
+}
+
+static layer_cache_slot *get_layer_cache(const word *data, const byte *cset, bool over)
+{
+    layer_cache_slot *slot=NULL;
+    
+    for(int i=0; i<LAYER_CACHE_SLOTS && !slot; i++)
+    {
+        if(layer_cache[i].source==data)
+            slot=&layer_cache[i];
+    }
+    
+    if(!slot)
     {
-        if(scrn->flags7&fLAYER2BG||scrn->flags7&fLAYER3BG)
+        slot=&layer_cache[0];
+        
+        for(int i=1; i<LAYER_CACHE_SLOTS; i++)
         {
-            overcombo(dest,((i&15)<<4)+x,(i&0xF0)+y,scrn->data[i],scrn->cset[i]);
+            if(layer_cache[i].last_used<slot->last_used)
+                slot=&layer_cache[i];
         }
+        
+        slot->source=NULL;
+    }
+    
+    slot->last_used=++layer_cache_clock;
+    
+    if(slot->source==data && slot->over==over && slot->tile_rev==tile_revision &&
+            slot->combo_rev==combo_revision &&
+            !memcmp(slot->data, data, sizeof(slot->data)) && !memcmp(slot->cset, cset, sizeof(slot->cset)))
+        return slot;
+        
+    if(!slot->bmp)
+    {
+        slot->bmp=create_bitmap_ex(8,256,176);
+        
+        if(!slot->bmp)
+            return NULL;
+    }
+    
+    slot->source=data;
+    slot->over=over;
+    slot->tile_rev=tile_revision;
+    slot->combo_rev=combo_revision;
+    memcpy(slot->data, data, sizeof(slot->data));
+    memcpy(slot->cset, cset, sizeof(slot->cset));
+    slot->dynamic_count=0;
+    
+    if(over)
+        clear_bitmap(slot->bmp);
+        
+    for(int i=0; i<176; i++)
+    {
+        if(!is_static_combo(data[i]))
+            slot->dynamic[slot->dynamic_count++]=i;
+        else if(over)
+            overcombo(slot->bmp,(i&15)<<4,i&0xF0,data[i],cset[i]);
         else
+            putcombo(slot->bmp,(i&15)<<4,i&0xF0,data[i],cset[i]);
+    }
+    
+    return slot;
+}
+
+// Same as calling overcombo() (or putcombo() if !over) for each of the 176
+// combos, with the layer's top left corner at x,y.
+void put_layer_combos(BITMAP *dest, int x, int y, const word *data, const byte *cset, bool over)
+{
+    // putcombo() skips combos that don't fit entirely, so only the
+    // overcombo() version can clip the cached bitmap.
+    layer_cache_slot *slot=NULL;
+    
+    if(over || (x>=0 && y>=0 && x+256<=dest->w && y+176<=dest->h))
+        slot=get_layer_cache(data, cset, over);
+        
+    if(!slot)
+    {
+        for(int i=0; i<176; i++)
         {
-            putcombo(dest,((i&15)<<4)+x,(i&0xF0)+y,scrn->data[i],scrn->cset[i]);
+            if(over)
+                overcombo(dest,((i&15)<<4)+x,(i&0xF0)+y,data[i],cset[i]);
+            else
+                putcombo(dest,((i&15)<<4)+x,(i&0xF0)+y,data[i],cset[i]);
         }
+        
+        return;
+    }
+    
+    // The tile drawers ignore the clipping rectangle, so this must too.
+    int cx1, cy1, cx2, cy2;
+    int clip=get_clip_state(dest);
+    get_clip_rect(dest,&cx1,&cy1,&cx2,&cy2);
+    set_clip_state(dest,1);
+    set_clip_rect(dest,0,0,dest->w-1,dest->h-1);
+    
+    if(over)
+        masked_blit(slot->bmp,dest,0,0,x,y,256,176);
+    else
+        blit(slot->bmp,dest,0,0,x,y,256,176);
+        
+    set_clip_rect(dest,cx1,cy1,cx2,cy2);
+    set_clip_state(dest,clip);
+    
+    for(int n=0; n<slot->dynamic_count; n++)
+    {
+        int i=slot->dynamic[n];
+        
+        if(over)
+            overcombo(dest,((i&15)<<4)+x,(i&0xF0)+y,data[i],cset[i]);
+        else
+            putcombo(dest,((i&15)<<4)+x,(i&0xF0)+y,data[i],cset[i]);
     }
 }
 
+void putscr(BITMAP* dest,int x,int y, mapscr* scrn)
+{
+    if(scrn->valid==0||!show_layer_0)
+    {
+        rectfill(dest,x,y,x+255,y+175,0);
+        return;
+    }
+    
+    bool over=(scrn->flags7&fLAYER2BG||scrn->flags7&fLAYER3BG)!=0;
+    put_layer_combos(dest,x,y,&scrn->data[0],&scrn->cset[0],over);
+}
+
 void putscrdoors(BITMAP *dest,int x,int y, mapscr* scrn)
 {
     if(scrn->valid==0||!show_layer_0)
@@ -4342,6 +4427,67 @@ void putscrdoors(BITMAP *dest,int x,int y, mapscr* scrn)
     }
 }
 
+/****  Walkability  ****/
+
+// _walkflag() and water_walkflag() combine the walk bits and water types of
+// the combos on layers 0-2. That's worked out once per position and kept,
+// along with the three combos it came from, so a combo changed by secrets,
+// cycling or a script is picked up the next time its position is checked.
+// Changing a combo's own walk bits needs walkflags_changed(), and its type
+// combotypes_changed().
+struct walkcell
+{
+    word combos[3];
+    dword epoch;
+    byte solid;      // quarters solid on any layer
+    byte drysolid;   // quarters solid on a layer whose combo isn't water
+    byte topsolid;   // quarters where the topmost solid combo isn't water
+    bool water;      // any of the three combos is water
+};
+
+static walkcell walkcells[176];
+static dword walkepoch = 1;
+
+void walkflags_changed()
+{
+    ++walkepoch;
+}
+
+static const walkcell &get_walkcell(int bx)
+{
+    mapscr *s1, *s2;
+    s1=(((*tmpscr).layermap[0]-1)>=0)?tmpscr2:tmpscr;
+    s2=(((*tmpscr).layermap[1]-1)>=0)?tmpscr2+1:tmpscr;
+    
+    word cmb[3] = { tmpscr->data[bx], s1->data[bx], s2->data[bx] };
+    walkcell &w = walkcells[bx];
+    
+    if(w.epoch==walkepoch && w.combos[0]==cmb[0] && w.combos[1]==cmb[1] && w.combos[2]==cmb[2])
+        return w;
+        
+    w.solid = w.drysolid = w.topsolid = 0;
+    w.water = false;
+    
+    for(int i=2; i>=0; i--)
+    {
+        const newcombo &c = combobuf[cmb[i]];
+        bool water = iswater_type(c.type);
+        
+        w.combos[i] = cmb[i];
+        w.solid |= c.walk;
+        w.water = w.water || water;
+        
+        if(!water)
+            w.drysolid |= c.walk;
+            
+        // Working up from layer 2, a higher solid combo decides the quarter
+        w.topsolid = water ? (w.topsolid & ~c.walk) : (w.topsolid | c.walk);
+    }
+    
+    w.epoch = walkepoch;
+    return w;
+}
+
 bool _walkflag(int x,int y,int cnt)
 {
     //  walkflagx=x; walkflagy=y;
@@ -4366,24 +4512,16 @@ bool _walkflag(int x,int y,int cnt)
         if(y>168) return false;
     }
     
-    mapscr *s1, *s2;
-    s1=(((*tmpscr).layermap[0]-1)>=0)?tmpscr2:tmpscr;
-    s2=(((*tmpscr).layermap[1]-1)>=0)?tmpscr2+1:tmpscr;
-    //  s2=TheMaps+((*tmpscr).layermap[1]-1)MAPSCRS+((*tmpscr).layerscreen[1]);
-    
     int bx=(x>>4)+(y&0xF0);
-    newcombo c = combobuf[tmpscr->data[bx]];
-    newcombo c1 = combobuf[s1->data[bx]];
-    newcombo c2 = combobuf[s2->data[bx]];
-    bool dried = (((iswater_type(c.type)) || (iswater_type(c1.type)) ||
-                   (iswater_type(c2.type))) && DRIEDLAKE);
+    const walkcell *w = &get_walkcell(bx);
+    bool dried = w->water && DRIEDLAKE;
     int b=1;
     
     if(x&8) b<<=2;
     
     if(y&8) b<<=1;
     
-    if(((c.walk&b) || (c1.walk&b) || (c2.walk&b)) && !dried)
+    if((w->solid&b) && !dried)
         return true;
         
     if(cnt==1) return false;
@@ -4394,17 +4532,14 @@ bool _walkflag(int x,int y,int cnt)
         b<<=2;
     else
     {
-        c  = combobuf[tmpscr->data[bx]];
-        c1 = combobuf[s1->data[bx]];
-        c2 = combobuf[s2->data[bx]];
-        dried = (((iswater_type(c.type)) || (iswater_type(c1.type)) ||
-                  (iswater_type(c2.type))) && DRIEDLAKE);
+        w = &get_walkcell(bx);
+        dried = w->water && DRIEDLAKE;
         b=1;
         
         if(y&8) b<<=1;
     }
     
-    return ((c.walk&b)||(c1.walk&b)||(c2.walk&b)) ? !dried : false;
+    return (w->solid&b) ? !dried : false;
 }
 
 bool water_walkflag(int x,int y,int cnt)
@@ -4430,35 +4565,15 @@ bool water_walkflag(int x,int y,int cnt)
         if(y>168) return false;
     }
     
-    mapscr *s1, *s2;
-    /*
-      s1=(((*tmpscr).layermap[0]-1)>=0)?
-      (TheMaps+((*tmpscr).layermap[0]-1)*MAPSCRS+((*tmpscr).layerscreen[0])):
-      tmpscr;
-      s2=(((*tmpscr).layermap[1]-1)>=0)?
-      (TheMaps+((*tmpscr).layermap[1]-1)*MAPSCRS+((*tmpscr).layerscreen[1])):
-      tmpscr;
-      */
-    s1=(((*tmpscr).layermap[0]-1)>=0)?tmpscr2:tmpscr;
-    s2=(((*tmpscr).layermap[1]-1)>=0)?tmpscr2+1:tmpscr;
-    
     int bx=(x>>4)+(y&0xF0);
-    newcombo c = combobuf[tmpscr->data[bx]];
-    newcombo c1 = combobuf[s1->data[bx]];
-    newcombo c2 = combobuf[s2->data[bx]];
+    const walkcell *w = &get_walkcell(bx);
     int b=1;
     
     if(x&8) b<<=2;
     
     if(y&8) b<<=1;
     
-    if((c.walk&b) && !iswater_type(c.type))
-        return true;
-        
-    if((c1.walk&b) && !iswater_type(c1.type))
-        return true;
-        
-    if((c2.walk&b) && !iswater_type(c2.type))
+    if(w->drysolid&b)
         return true;
         
     if(cnt==1) return false;
@@ -4467,17 +4582,116 @@ bool water_walkflag(int x,int y,int cnt)
         b<<=2;
     else
     {
-        c = combobuf[tmpscr->data[++bx]];
-        c1 = combobuf[s1->data[bx]];
-        c2 = combobuf[s2->data[bx]];
+        w = &get_walkcell(++bx);
         b=1;
         
         if(y&8) b<<=1;
     }
     
-    return (c.walk&b) ? !iswater_type(c.type) :
-           (c1.walk&b) ? !iswater_type(c1.type) :
-           (c2.walk&b) ? !iswater_type(c2.type) :false;
+    return (w->topsolid&b)!=0;
+}
+
+/****  Combo type index  ****/
+
+// Where each combo type appears on the current screen, for per-frame checks
+// like screen freezes and auto-warps. Positions of each type are kept in
+// order, counting-sort style. Code that changes the screen's combos must call
+// screencombos_changed() (or combotypes_changed() for combobuf types), which
+// bumps an epoch; within a frame, writes that don't are not seen. The once a
+// frame compare against a copy only bounds how long such a write goes unseen.
+struct combo_type_index
+{
+    const mapscr *scr;
+    dword epoch;
+    int frame;
+    word data[176];
+    word ffdata[32];
+    word start[257];
+    byte pos[176];
+    word ffstart[257];
+    byte ffpos[32];
+};
+
+static combo_type_index typeindex;
+static dword combotypeepoch = 1;
+
+void combotypes_changed()
+{
+    ++combotypeepoch;
+    ++combo_revision;
+    walkflags_changed();
+}
+
+void screencombos_changed()
+{
+    ++combotypeepoch;
+}
+
+static void bucket_combo_types(const word *combos, int count, word *start, byte *pos)
+{
+    memset(start, 0, 257*sizeof(word));
+    
+    for(int i=0; i<count; i++)
+        ++start[combobuf[combos[i]].type+1];
+        
+    for(int t=0; t<256; t++)
+        start[t+1] += start[t];
+        
+    word next[256];
+    memcpy(next, start, sizeof(next));
+    
+    for(int i=0; i<count; i++)
+        pos[next[combobuf[combos[i]].type]++] = i;
+}
+
+static const combo_type_index &get_combo_type_index()
+{
+    combo_type_index &idx = typeindex;
+    
+    if(idx.scr==tmpscr && idx.epoch==combotypeepoch && idx.frame==frame)
+        return idx;
+        
+    word data[176];
+    
+    for(int i=0; i<176; i++)
+        data[i] = tmpscr->data[i];
+        
+    idx.frame = frame;
+    
+    if(idx.scr==tmpscr && idx.epoch==combotypeepoch &&
+            !memcmp(idx.data, data, sizeof(data)) &&
+            !memcmp(idx.ffdata, tmpscr->ffdata, sizeof(idx.ffdata)))
+        return idx;
+        
+    idx.scr = tmpscr;
+    idx.epoch = combotypeepoch;
+    memcpy(idx.data, data, sizeof(data));
+    memcpy(idx.ffdata, tmpscr->ffdata, sizeof(idx.ffdata));
+    bucket_combo_types(idx.data, 176, idx.start, idx.pos);
+    bucket_combo_types(idx.ffdata, 32, idx.ffstart, idx.ffpos);
+    return idx;
+}
+
+int combos_of_type(int type, const byte **positions)
+{
+    const combo_type_index &idx = get_combo_type_index();
+    type &= 0xFF;
+    
+    if(positions)
+        *positions = idx.pos+idx.start[type];
+        
+    return idx.start[type+1]-idx.start[type];
+}
+
+int ffcs_of_type(int type, const byte **ffcs)
+{
+    const combo_type_index &idx = get_combo_type_index();
+    type &= 0xFF;
+    
+    if(ffcs)
+        *ffcs = idx.ffpos+idx.ffstart[type];
+        
+    return idx.ffstart[type+1]-idx.ffstart[type];
 }
 
 bool hit_walkflag(int x,int y,int cnt)
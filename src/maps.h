@@ -92,8 +92,23 @@ void showbombeddoor(BITMAP *dest, int side);
 void openshutters();
 void loadscr(int tmp,int destdmap,int scr,int ldir,bool overlay);
 void putscr(BITMAP* dest,int x,int y,mapscr* screen);
+// Draws a screen layer's 176 combos at x,y through the layer cache
+void put_layer_combos(BITMAP *dest, int x, int y, const word *data, const byte *cset, bool over);
+// Call when combo definitions are replaced, e.g. by loading a quest
+void clear_layer_cache();
 void putscrdoors(BITMAP *dest,int x,int y,mapscr* screen);
 bool _walkflag(int x,int y,int cnt);
+// Call after changing the walk bits of a combo that may be on screen
+void walkflags_changed();
+// Call after changing the type of a combo that may be on screen
+void combotypes_changed();
+// Call after changing which combos are on the current screen or its FFCs
+void screencombos_changed();
+// How many combos (or FFCs) on the current screen are of the given type.
+// If positions is given, it's pointed at their positions in ascending order;
+// the list is only good until the screen's combos next change.
+int combos_of_type(int type, const byte **positions = NULL);
+int ffcs_of_type(int type, const byte **ffcs = NULL);
 bool water_walkflag(int x,int y,int cnt);
 bool hit_walkflag(int x,int y,int cnt);
 void map_bkgsfx(bool on);
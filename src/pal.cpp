@@ -21,6 +21,7 @@
 #include "pal.h"
 #include "subscr.h"
 #include "backend/AllBackends.h"
+#include "thread.h"
 
 extern LinkClass *Link;
 
@@ -93,6 +94,199 @@ void loadfullpal()
 
 extern PALETTE tempgreypal;
 
+/* Colour tables
+ *
+ * rgb_table and the translucency tables depend only on the palette, and a
+ * lot of palette changes (fades, dark rooms, refreshpal being set again and
+ * again) go back and forth between the same few palettes. The last few
+ * sets of tables are kept, keyed by a hash of the palette they were built
+ * from. When a new rgb_table turns out the same as the last one, only the
+ * translucency rows and columns for the palette entries that changed are
+ * rebuilt; otherwise half of the translucency table is built on a worker
+ * thread.
+ */
+
+#define COLOR_TABLE_CACHE_SIZE 8
+
+struct color_tables
+{
+    bool valid;
+    bool mapped;
+    dword hash;
+    dword lastused;
+    PALETTE pal;
+    RGB_MAP rgb;
+    COLOR_MAP trans;
+};
+
+static color_tables *colortables = NULL;
+static int lastcolortables = -1;
+static dword colortableclock = 0;
+
+static dword hash_palette(const RGB *pal)
+{
+    dword h = 2166136261u;
+    
+    for(int i=0; i<PAL_SIZE; i++)
+    {
+        h = (h ^ pal[i].r) * 16777619u;
+        h = (h ^ pal[i].g) * 16777619u;
+        h = (h ^ pal[i].b) * 16777619u;
+    }
+    
+    return h;
+}
+
+static bool same_color(const RGB &a, const RGB &b)
+{
+    return a.r==b.r && a.g==b.g && a.b==b.b;
+}
+
+static bool same_palette(const RGB *a, const RGB *b)
+{
+    for(int i=0; i<PAL_SIZE; i++)
+    {
+        if(!same_color(a[i], b[i]))
+            return false;
+    }
+    
+    return true;
+}
+
+// One entry of a 50% translucency table, the same as create_zc_trans_table
+// computes with r=g=b=128
+static inline byte trans_entry(const RGB *pal, const RGB_MAP *map, int x, int y)
+{
+    int r = pal[x].r*128/255 + pal[y].r*127/255;
+    int g = pal[x].g*128/255 + pal[y].g*127/255;
+    int b = pal[x].b*128/255 + pal[y].b*127/255;
+    return map ? map->data[r>>1][g>>1][b>>1] : bestfit_color(pal, r, g, b);
+}
+
+struct trans_rows_job
+{
+    color_tables *tables;
+    const RGB_MAP *map;
+    int first, last;
+};
+
+static void build_trans_rows(void *arg)
+{
+    trans_rows_job *job = (trans_rows_job*)arg;
+    
+    for(int x=job->first; x<=job->last; x++)
+    {
+        for(int y=0; y<PAL_SIZE; y++)
+            job->tables->trans.data[x][y] = trans_entry(job->tables->pal, job->map, x, y);
+    }
+}
+
+static void build_color_tables(color_tables &t, const color_tables *prev)
+{
+    create_rgb_table(&t.rgb, t.pal, NULL);
+    
+    // create_zc_trans_table goes through rgb_map when there is one
+    const RGB_MAP *map = rgb_map ? &t.rgb : NULL;
+    
+    if(map && prev && prev->mapped && !memcmp(&prev->rgb, &t.rgb, sizeof(RGB_MAP)))
+    {
+        memcpy(&t.trans, &prev->trans, sizeof(COLOR_MAP));
+        
+        for(int i=0; i<PAL_SIZE; i++)
+        {
+            if(same_color(t.pal[i], prev->pal[i]))
+                continue;
+                
+            for(int j=0; j<PAL_SIZE; j++)
+            {
+                t.trans.data[i][j] = trans_entry(t.pal, map, i, j);
+                t.trans.data[j][i] = trans_entry(t.pal, map, j, i);
+            }
+        }
+        
+        return;
+    }
+    
+    trans_rows_job low = { &t, map, 0, PAL_SIZE/2-1 };
+    trans_rows_job high = { &t, map, PAL_SIZE/2, PAL_SIZE-1 };
+    
+    // bestfit_color sets up a static table on first use, so only split the
+    // work when the rgb map is being used
+    zc_thread *worker = map ? thread_start(build_trans_rows, &low) : NULL;
+    
+    if(!worker)
+        build_trans_rows(&low);
+        
+    build_trans_rows(&high);
+    
+    if(worker)
+        thread_join(worker);
+}
+
+void refresh_color_tables(RGB *pal)
+{
+    if(!colortables)
+    {
+        colortables = new color_tables[COLOR_TABLE_CACHE_SIZE];
+        
+        for(int i=0; i<COLOR_TABLE_CACHE_SIZE; i++)
+            colortables[i].valid = false;
+    }
+    
+    dword hash = hash_palette(pal);
+    int found = -1;
+    int victim = 0;
+    
+    for(int i=0; i<COLOR_TABLE_CACHE_SIZE; i++)
+    {
+        color_tables &t = colortables[i];
+        
+        if(t.valid && t.hash==hash && t.mapped==(rgb_map!=NULL) && same_palette(t.pal, pal))
+        {
+            found = i;
+            break;
+        }
+        
+        if(!t.valid || (colortables[victim].valid && t.lastused < colortables[victim].lastused))
+            victim = i;
+    }
+    
+    if(found < 0)
+    {
+        color_tables &t = colortables[victim];
+        const color_tables *prev = (lastcolortables>=0 && lastcolortables!=victim) ? &colortables[lastcolortables] : NULL;
+        memcpy(t.pal, pal, sizeof(PALETTE));
+        t.hash = hash;
+        t.mapped = rgb_map!=NULL;
+        build_color_tables(t, prev);
+        t.valid = true;
+        found = victim;
+    }
+    
+    color_tables &t = colortables[found];
+    t.lastused = ++colortableclock;
+    
+    if(found != lastcolortables)
+    {
+        memcpy(&rgb_table, &t.rgb, sizeof(RGB_MAP));
+        memcpy(&trans_table, &t.trans, sizeof(COLOR_MAP));
+        memcpy(&trans_table2, &t.trans, sizeof(COLOR_MAP));
+        
+        for(int q=0; q<PAL_SIZE; q++)
+        {
+            trans_table2.data[0][q] = q;
+            trans_table2.data[q][q] = q;
+        }
+        
+        lastcolortables = found;
+    }
+}
+
+void color_tables_changed()
+{
+    lastcolortables = -1;
+}
+
 void loadlvlpal(int level)
 {
     byte *si = colordata + CSET(level*pdLEVEL+poLEVEL)*3;
@@ -116,15 +310,7 @@ void loadlvlpal(int level)
 	tempgreypal[CSET(6)+2] = NESpal(0x37);
     }
         
-    create_rgb_table(&rgb_table, RAMpal, NULL);
-    create_zc_trans_table(&trans_table, RAMpal, 128, 128, 128);
-    memcpy(&trans_table2, &trans_table, sizeof(COLOR_MAP));
-    
-    for(int q=0; q<PAL_SIZE; q++)
-    {
-        trans_table2.data[0][q] = q;
-        trans_table2.data[q][q] = q;
-    }
+    refresh_color_tables(RAMpal);
     
     //! We need to store the new palette into the monochrome scratch palette. 
     //memcpy(tempgreypal, RAMpal, PAL_SIZE*sizeof(RGB));
@@ -364,15 +550,7 @@ int level = (Link->getSpecialCave()>0) ? (Link->getSpecialCave()>=GUYCAVE) ? 10
         if(!get_bit(quest_rules,qr_NOLEVEL3FIX) && level==3)
             RAMpal[CSET(6)+2] = NESpal(0x37);
             
-        create_rgb_table(&rgb_table, RAMpal, NULL);
-        create_zc_trans_table(&trans_table, RAMpal, 128, 128, 128);
-        memcpy(&trans_table2, &trans_table, sizeof(COLOR_MAP));
-        
-        for(int q=0; q<PAL_SIZE; q++)
-        {
-            trans_table2.data[0][q] = q;
-            trans_table2.data[q][q] = q;
-        }
+        refresh_color_tables(RAMpal);
         
         darkroom = newstate;
     }
@@ -29,6 +29,11 @@ extern RGB mixRGB(int r1,int g1,int b1,int r2,int g2,int b2,int ratio);
 extern void copy_pal(RGB *src,RGB *dest);
 extern void loadfullpal();
 extern void loadlvlpal(int level);
+// Sets rgb_table, trans_table and trans_table2 up for pal, reusing cached
+// tables when pal has been seen recently
+extern void refresh_color_tables(RGB *pal);
+// Call after changing rgb_table or the trans tables some other way
+extern void color_tables_changed();
 extern void loadpalset(int cset,int dataset);
 extern void loadfadepal(int dataset);
 extern void interpolatedfade();
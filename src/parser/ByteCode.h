@@ -654,6 +654,10 @@ public:
     {
         return new LiteralArgument(value);
     }
+    long getValue()
+    {
+        return value;
+    }
 private:
     long value;
 };
@@ -671,6 +675,10 @@ public:
     {
         return new VarArgument(ID);
     }
+    int getID()
+    {
+        return ID;
+    }
 private:
     int ID;
 };
@@ -709,6 +717,10 @@ public:
     {
         return ID;
     }
+    void setID(int id)
+    {
+        ID=id;
+    }
     void setLineNo(int l)
     {
         haslineno=true;
@@ -74,6 +74,7 @@ struct FunctionData;
 struct IntermediateData;
 
 class ASTProgram;
+class Optimizer;
 
 class ScriptParser
 {
@@ -95,6 +96,11 @@ public:
         return gid++;
     }
     static bool preprocess(ASTProgram* theAST, int reclevel);
+    // Absolute path that's the same however the file was named.
+    static string canonicalPath(string const& filename);
+    // Parses an import, or copies the tree from an earlier compile if the
+    // file hasn't changed since. Returns NULL if it can't be parsed.
+    static ASTProgram* parseImport(string const& filename, string const& path);
     static SymbolData* buildSymbolTable(ASTProgram* theAST);
     static IntermediateData* generateOCode(FunctionData& fdata);
     static ScriptsData* assemble(IntermediateData* id);
@@ -123,7 +129,7 @@ public:
 	}
 private:
     static string prepareFilename(string const& filename);
-    static vector<Opcode *> assembleOne(vector<Opcode *> script, std::map<int, vector<Opcode *> > &otherfuncs, int numparams);
+    static vector<Opcode *> assembleOne(vector<Opcode *> script, std::map<int, vector<Opcode *> > &otherfuncs, int numparams, Optimizer *optimizer);
     static int vid;
     static int fid;
     static int gid;
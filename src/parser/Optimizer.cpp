@@ -0,0 +1,791 @@
+#include "../precompiled.h" //always first
+
+#include "Optimizer.h"
+#include "ByteCode.h"
+#include <climits>
+#include <map>
+
+using std::map;
+
+namespace
+{
+    enum OpKind
+    {
+        OP_OTHER, OP_SETV, OP_SETR, OP_ARITHV, OP_ARITHR, OP_COMPAREV, OP_COMPARER,
+        OP_SETFLAG, OP_PUSH, OP_POP, OP_LOADI, OP_STOREI,
+        OP_GOTO, OP_GOTOCOND, OP_GOTOR, OP_QUIT
+    };
+
+    enum ArithOp
+    {
+        AR_NONE, AR_ADD, AR_SUB, AR_MULT, AR_DIV, AR_MOD,
+        AR_AND, AR_OR, AR_XOR, AR_LSHIFT, AR_RSHIFT
+    };
+
+    template <class T> bool is(Opcode *op)
+    {
+        return dynamic_cast<T *>(op) != NULL;
+    }
+
+    OpKind arithKind(ArithOp op, bool immediate, int &arith)
+    {
+        arith = op;
+        return immediate ? OP_ARITHV : OP_ARITHR;
+    }
+
+    OpKind classify(Opcode *op, int &arith)
+    {
+        arith = AR_NONE;
+
+        if(is<OSetImmediate>(op)) return OP_SETV;
+        if(is<OSetRegister>(op)) return OP_SETR;
+        if(is<OAddImmediate>(op)) return arithKind(AR_ADD, true, arith);
+        if(is<OAddRegister>(op)) return arithKind(AR_ADD, false, arith);
+        if(is<OSubImmediate>(op)) return arithKind(AR_SUB, true, arith);
+        if(is<OSubRegister>(op)) return arithKind(AR_SUB, false, arith);
+        if(is<OMultImmediate>(op)) return arithKind(AR_MULT, true, arith);
+        if(is<OMultRegister>(op)) return arithKind(AR_MULT, false, arith);
+        if(is<ODivImmediate>(op)) return arithKind(AR_DIV, true, arith);
+        if(is<ODivRegister>(op)) return arithKind(AR_DIV, false, arith);
+        if(is<OModuloImmediate>(op)) return arithKind(AR_MOD, true, arith);
+        if(is<OModuloRegister>(op)) return arithKind(AR_MOD, false, arith);
+        if(is<OAndImmediate>(op)) return arithKind(AR_AND, true, arith);
+        if(is<OAndRegister>(op)) return arithKind(AR_AND, false, arith);
+        if(is<OOrImmediate>(op)) return arithKind(AR_OR, true, arith);
+        if(is<OOrRegister>(op)) return arithKind(AR_OR, false, arith);
+        if(is<OXorImmediate>(op)) return arithKind(AR_XOR, true, arith);
+        if(is<OXorRegister>(op)) return arithKind(AR_XOR, false, arith);
+        if(is<OLShiftImmediate>(op)) return arithKind(AR_LSHIFT, true, arith);
+        if(is<OLShiftRegister>(op)) return arithKind(AR_LSHIFT, false, arith);
+        if(is<ORShiftImmediate>(op)) return arithKind(AR_RSHIFT, true, arith);
+        if(is<ORShiftRegister>(op)) return arithKind(AR_RSHIFT, false, arith);
+        if(is<OCompareImmediate>(op)) return OP_COMPAREV;
+        if(is<OCompareRegister>(op)) return OP_COMPARER;
+        if(is<OSetTrue>(op) || is<OSetFalse>(op) || is<OSetMore>(op) || is<OSetLess>(op)) return OP_SETFLAG;
+        if(is<OPushRegister>(op)) return OP_PUSH;
+        if(is<OPopRegister>(op)) return OP_POP;
+        if(is<OLoadIndirect>(op)) return OP_LOADI;
+        if(is<OStoreIndirect>(op)) return OP_STOREI;
+        if(is<OGotoImmediate>(op)) return OP_GOTO;
+        if(is<OGotoTrueImmediate>(op) || is<OGotoFalseImmediate>(op)
+                || is<OGotoMoreImmediate>(op) || is<OGotoLessImmediate>(op)) return OP_GOTOCOND;
+        if(is<OGotoRegister>(op)) return OP_GOTOR;
+        if(is<OQuit>(op)) return OP_QUIT;
+
+        return OP_OTHER;
+    }
+
+    OpKind classify(Opcode *op)
+    {
+        int arith;
+        return classify(op, arith);
+    }
+
+    // The D registers are plain storage. Anything else may be an engine
+    // variable whose reads or writes have side effects.
+    int scratchRegister(Argument *arg)
+    {
+        VarArgument *var = dynamic_cast<VarArgument *>(arg);
+
+        if(!var || var->getID() < 0 || var->getID() > WHAT_NO_7)
+            return -1;
+
+        return var->getID();
+    }
+
+    bool literalValue(Argument *arg, long &value)
+    {
+        LiteralArgument *lit = dynamic_cast<LiteralArgument *>(arg);
+
+        if(!lit)
+            return false;
+
+        value = lit->getValue();
+        return true;
+    }
+
+    int firstRegister(Opcode *op)
+    {
+        if(BinaryOpcode *bin = dynamic_cast<BinaryOpcode *>(op))
+            return scratchRegister(bin->getFirstArgument());
+
+        if(UnaryOpcode *un = dynamic_cast<UnaryOpcode *>(op))
+            return scratchRegister(un->getArgument());
+
+        return -1;
+    }
+
+    int secondRegister(Opcode *op)
+    {
+        BinaryOpcode *bin = dynamic_cast<BinaryOpcode *>(op);
+        return bin ? scratchRegister(bin->getSecondArgument()) : -1;
+    }
+
+    bool secondLiteral(Opcode *op, long &value)
+    {
+        BinaryOpcode *bin = dynamic_cast<BinaryOpcode *>(op);
+        return bin && literalValue(bin->getSecondArgument(), value);
+    }
+
+    LabelArgument *jumpTarget(Opcode *op)
+    {
+        UnaryOpcode *un = dynamic_cast<UnaryOpcode *>(op);
+        return un ? dynamic_cast<LabelArgument *>(un->getArgument()) : NULL;
+    }
+
+    struct Effects
+    {
+        bool known;     // only touches the registers below, the flags or the stack
+        bool removable; // does nothing but write `writes`
+        bool stack;     // pushes, pops or touches script memory
+        int reads;
+        int writes;
+    };
+
+    Effects effectsOf(Opcode *op)
+    {
+        Effects e = { false, false, false, 0, 0 };
+        int arith;
+        OpKind kind = classify(op, arith);
+        int a = firstRegister(op);
+        int b = secondRegister(op);
+
+        switch(kind)
+        {
+        case OP_SETV:
+        case OP_SETFLAG:
+            if(a < 0) return e;
+
+            e.writes = 1 << a;
+            e.removable = true;
+            break;
+
+        case OP_SETR:
+            if(a < 0 || b < 0) return e;
+
+            e.reads = 1 << b;
+            e.writes = 1 << a;
+            e.removable = true;
+            break;
+
+        case OP_ARITHV:
+        case OP_ARITHR:
+            if(a < 0 || (kind == OP_ARITHR && b < 0)) return e;
+
+            e.reads = (1 << a) | (kind == OP_ARITHR ? 1 << b : 0);
+            e.writes = 1 << a;
+            // Dividing by zero logs an error.
+            e.removable = arith != AR_DIV && arith != AR_MOD;
+            break;
+
+        case OP_COMPAREV:
+        case OP_COMPARER:
+            if(a < 0 || (kind == OP_COMPARER && b < 0)) return e;
+
+            e.reads = (1 << a) | (kind == OP_COMPARER ? 1 << b : 0);
+            break;
+
+        case OP_PUSH:
+            if(a < 0) return e;
+
+            e.reads = 1 << a;
+            e.stack = true;
+            break;
+
+        case OP_POP:
+            if(a < 0) return e;
+
+            e.writes = 1 << a;
+            e.stack = true;
+            break;
+
+        case OP_LOADI:
+            if(a < 0 || b < 0) return e;
+
+            e.reads = 1 << b;
+            e.writes = 1 << a;
+            e.stack = true;
+            break;
+
+        case OP_STOREI:
+            if(a < 0 || b < 0) return e;
+
+            e.reads = (1 << a) | (1 << b);
+            e.stack = true;
+            break;
+
+        default:
+            return e;
+        }
+
+        e.known = true;
+        return e;
+    }
+
+    // Mirrors do_add() and friends in ffscript.cpp. Gives up rather than
+    // guess at anything that would overflow at run time.
+    bool fold(int arith, long lhs, long rhs, long &result)
+    {
+        long long r;
+
+        switch(arith)
+        {
+        case AR_ADD:
+            r = (long long)lhs + rhs;
+            break;
+
+        case AR_SUB:
+            r = (long long)lhs - rhs;
+            break;
+
+        case AR_MULT:
+            r = ((long long)lhs * rhs) / 10000;
+            break;
+
+        case AR_DIV:
+            if(rhs == 0) return false;
+
+            r = ((long long)lhs * 10000) / rhs;
+            break;
+
+        case AR_MOD:
+            if(rhs == 0 || rhs == -1) return false;
+
+            r = lhs % rhs;
+            break;
+
+        case AR_AND:
+            r = (long long)((lhs / 10000) & (rhs / 10000)) * 10000;
+            break;
+
+        case AR_OR:
+            r = (long long)((lhs / 10000) | (rhs / 10000)) * 10000;
+            break;
+
+        case AR_XOR:
+            r = (long long)((lhs / 10000) ^ (rhs / 10000)) * 10000;
+            break;
+
+        default:
+            return false;
+        }
+
+        if(r < INT_MIN || r > INT_MAX)
+            return false;
+
+        result = (long)r;
+        return true;
+    }
+
+    Opcode *makeImmediate(int arith, int reg, long value)
+    {
+        Argument *a = new VarArgument(reg);
+        Argument *b = new LiteralArgument(value);
+
+        switch(arith)
+        {
+        case AR_ADD:
+            return new OAddImmediate(a, b);
+        case AR_SUB:
+            return new OSubImmediate(a, b);
+        case AR_MULT:
+            return new OMultImmediate(a, b);
+        case AR_DIV:
+            return new ODivImmediate(a, b);
+        case AR_MOD:
+            return new OModuloImmediate(a, b);
+        case AR_AND:
+            return new OAndImmediate(a, b);
+        case AR_OR:
+            return new OOrImmediate(a, b);
+        case AR_XOR:
+            return new OXorImmediate(a, b);
+        case AR_LSHIFT:
+            return new OLShiftImmediate(a, b);
+        case AR_RSHIFT:
+            return new ORShiftImmediate(a, b);
+        }
+
+        delete a;
+        delete b;
+        return NULL;
+    }
+
+    bool commutative(int arith)
+    {
+        return arith == AR_ADD || arith == AR_MULT || arith == AR_AND
+               || arith == AR_OR || arith == AR_XOR;
+    }
+
+    void replace(vector<Opcode *> &code, size_t i, Opcode *op)
+    {
+        op->setLabel(code[i]->getLabel());
+        delete code[i];
+        code[i] = op;
+    }
+
+    map<int, size_t> labelIndices(vector<Opcode *> &code)
+    {
+        map<int, size_t> rval;
+
+        for(size_t i = 0; i < code.size(); i++)
+        {
+            if(code[i]->getLabel() != -1)
+                rval[code[i]->getLabel()] = i;
+        }
+
+        return rval;
+    }
+
+    class CollectLabels : public ArgumentVisitor
+    {
+    public:
+        void caseLabel(LabelArgument &host, void *param)
+        {
+            map<int, bool> *labels = (map<int, bool> *)param;
+            (*labels)[host.getID()] = true;
+        }
+    };
+
+    class RenameLabels : public ArgumentVisitor
+    {
+    public:
+        void caseLabel(LabelArgument &host, void *param)
+        {
+            map<int, int> *aliases = (map<int, int> *)param;
+            map<int, int>::iterator it = aliases->find(host.getID());
+
+            if(it != aliases->end())
+                host.setID(it->second);
+        }
+    };
+}
+
+void Optimizer::optimize(vector<Opcode *> &code)
+{
+    before += (int)code.size();
+
+    // Each pass can open up work for the others; a handful of rounds is
+    // enough for anything the code generator emits.
+    for(int round = 0; round < 8; round++)
+    {
+        bool changed = false;
+        changed |= dropUnusedLabels(code);
+        changed |= threadJumps(code);
+        changed |= removeUnreachable(code);
+        changed |= removeJumpsToNext(code);
+        changed |= foldPushPop(code);
+        changed |= propagateConstants(code);
+        changed |= removeCopies(code);
+        changed |= removeDeadStores(code);
+
+        if(!changed)
+            break;
+    }
+
+    after += (int)code.size();
+}
+
+// Labels nothing refers to any more would otherwise keep dead code alive.
+bool Optimizer::dropUnusedLabels(vector<Opcode *> &code)
+{
+    map<int, bool> used;
+    bool changed = false;
+
+    for(vector<Opcode *>::iterator it = code.begin(); it != code.end(); it++)
+    {
+        CollectLabels temp;
+        (*it)->execute(temp, &used);
+    }
+
+    for(vector<Opcode *>::iterator it = code.begin(); it != code.end(); it++)
+    {
+        if((*it)->getLabel() != -1 && used.find((*it)->getLabel()) == used.end())
+        {
+            (*it)->setLabel(-1);
+            changed = true;
+        }
+    }
+
+    return changed;
+}
+
+// Points jumps that land on an unconditional GOTO straight at its target, and
+// turns a GOTO to a QUIT into the QUIT itself.
+bool Optimizer::threadJumps(vector<Opcode *> &code)
+{
+    map<int, size_t> labels = labelIndices(code);
+    bool changed = false;
+
+    for(size_t i = 0; i < code.size(); i++)
+    {
+        OpKind kind = classify(code[i]);
+
+        if(kind != OP_GOTO && kind != OP_GOTOCOND)
+            continue;
+
+        LabelArgument *target = jumpTarget(code[i]);
+
+        if(!target)
+            continue;
+
+        // Cycles of jumps just stop after a few hops.
+        for(int hops = 0; hops < 16; hops++)
+        {
+            map<int, size_t>::iterator it = labels.find(target->getID());
+
+            if(it == labels.end() || it->second == i)
+                break;
+
+            Opcode *dest = code[it->second];
+
+            if(kind == OP_GOTO && classify(dest) == OP_QUIT)
+            {
+                replace(code, i, new OQuit());
+                changed = true;
+                break;
+            }
+
+            if(classify(dest) != OP_GOTO)
+                break;
+
+            LabelArgument *next = jumpTarget(dest);
+
+            if(!next || next->getID() == target->getID())
+                break;
+
+            target->setID(next->getID());
+            changed = true;
+        }
+    }
+
+    return changed;
+}
+
+// Anything after an unconditional jump or QUIT can only be reached through a
+// label, since every jump target (including return addresses) is one.
+bool Optimizer::removeUnreachable(vector<Opcode *> &code)
+{
+    vector<bool> dead(code.size(), false);
+    bool reachable = true;
+
+    for(size_t i = 0; i < code.size(); i++)
+    {
+        if(code[i]->getLabel() != -1)
+            reachable = true;
+
+        if(!reachable)
+            dead[i] = true;
+
+        OpKind kind = classify(code[i]);
+
+        if(kind == OP_GOTO || kind == OP_GOTOR || kind == OP_QUIT)
+            reachable = false;
+    }
+
+    return compact(code, dead);
+}
+
+bool Optimizer::removeJumpsToNext(vector<Opcode *> &code)
+{
+    vector<bool> dead(code.size(), false);
+
+    for(size_t i = 0; i + 1 < code.size(); i++)
+    {
+        OpKind kind = classify(code[i]);
+
+        if(kind != OP_GOTO && kind != OP_GOTOCOND)
+            continue;
+
+        LabelArgument *target = jumpTarget(code[i]);
+
+        if(target && target->getID() == code[i + 1]->getLabel())
+            dead[i] = true;
+    }
+
+    return compact(code, dead);
+}
+
+// PUSHR a ... POP b becomes SETR b,a when the instructions in between don't
+// touch b or the stack. The code generator does this around every binary
+// operator, usually with just a load of the right-hand side in between.
+bool Optimizer::foldPushPop(vector<Opcode *> &code)
+{
+    vector<bool> dead(code.size(), false);
+    bool changed = false;
+
+    for(size_t i = 0; i < code.size(); i++)
+    {
+        if(classify(code[i]) != OP_PUSH || !effectsOf(code[i]).known)
+            continue;
+
+        int a = firstRegister(code[i]);
+        int touched = 0;
+
+        for(size_t j = i + 1; j < code.size() && j <= i + 16; j++)
+        {
+            if(code[j]->getLabel() != -1)
+                break;
+
+            Effects e = effectsOf(code[j]);
+
+            if(!e.known)
+                break;
+
+            if(classify(code[j]) == OP_POP)
+            {
+                int b = firstRegister(code[j]);
+
+                if(touched & (1 << b))
+                    break;
+
+                if(a == b)
+                    dead[i] = true;
+                else
+                    replace(code, i, new OSetRegister(new VarArgument(b), new VarArgument(a)));
+
+                dead[j] = true;
+                changed = true;
+                i = j;
+                break;
+            }
+
+            if(e.stack)
+                break;
+
+            touched |= e.reads | e.writes;
+        }
+    }
+
+    return compact(code, dead) || changed;
+}
+
+// Tracks D registers holding known literals within a straight run of code,
+// turning register operands into immediates and folding arithmetic on them.
+bool Optimizer::propagateConstants(vector<Opcode *> &code)
+{
+    long values[WHAT_NO_7 + 1];
+    int known = 0;
+    bool changed = false;
+
+    for(size_t i = 0; i < code.size(); i++)
+    {
+        if(code[i]->getLabel() != -1)
+            known = 0;
+
+        Effects e = effectsOf(code[i]);
+
+        if(!e.known)
+        {
+            known = 0;
+            continue;
+        }
+
+        int arith;
+        OpKind kind = classify(code[i], arith);
+        int a = firstRegister(code[i]);
+        int b = secondRegister(code[i]);
+        long value;
+
+        switch(kind)
+        {
+        case OP_SETV:
+            if(secondLiteral(code[i], value))
+            {
+                known |= 1 << a;
+                values[a] = value;
+            }
+            else
+                known &= ~(1 << a);
+
+            break;
+
+        case OP_SETR:
+            if(known & (1 << b))
+            {
+                replace(code, i, new OSetImmediate(new VarArgument(a), new LiteralArgument(values[b])));
+                known |= 1 << a;
+                values[a] = values[b];
+                changed = true;
+            }
+            else
+                known &= ~(1 << a);
+
+            break;
+
+        case OP_ARITHR:
+            if(known & (1 << b))
+            {
+                replace(code, i, makeImmediate(arith, a, values[b]));
+                changed = true;
+            }
+            else if(commutative(arith) && i > 0 && code[i]->getLabel() == -1
+                    && classify(code[i - 1]) == OP_SETV && firstRegister(code[i - 1]) == a
+                    && secondLiteral(code[i - 1], value))
+            {
+                // SETV a,c; OPR a,b is SETR a,b; OPV a,c. That's what's left
+                // of "x + 1" once its PUSHR/POP is gone, and removeCopies()
+                // then drops the SETR.
+                replace(code, i - 1, new OSetRegister(new VarArgument(a), new VarArgument(b)));
+                replace(code, i, makeImmediate(arith, a, value));
+                known &= ~(1 << a);
+                changed = true;
+                break;
+            }
+            else
+            {
+                known &= ~(1 << a);
+                break;
+            }
+
+            // fall through to fold the new immediate
+        case OP_ARITHV:
+            if((known & (1 << a)) && secondLiteral(code[i], value)
+                    && fold(arith, values[a], value, value))
+            {
+                replace(code, i, new OSetImmediate(new VarArgument(a), new LiteralArgument(value)));
+                values[a] = value;
+                changed = true;
+            }
+            else
+                known &= ~(1 << a);
+
+            break;
+
+        case OP_COMPARER:
+            if(known & (1 << b))
+            {
+                replace(code, i, new OCompareImmediate(new VarArgument(a), new LiteralArgument(values[b])));
+                changed = true;
+            }
+
+            break;
+
+        default:
+            known &= ~e.writes;
+        }
+    }
+
+    return changed;
+}
+
+// SETR a,a, and SETR a,b right after SETR b,a, copy nothing.
+bool Optimizer::removeCopies(vector<Opcode *> &code)
+{
+    vector<bool> dead(code.size(), false);
+
+    for(size_t i = 0; i < code.size(); i++)
+    {
+        if(classify(code[i]) != OP_SETR || !effectsOf(code[i]).known)
+            continue;
+
+        int a = firstRegister(code[i]);
+        int b = secondRegister(code[i]);
+
+        if(a == b)
+        {
+            dead[i] = true;
+            continue;
+        }
+
+        if(i + 1 < code.size() && code[i + 1]->getLabel() == -1
+                && classify(code[i + 1]) == OP_SETR
+                && firstRegister(code[i + 1]) == b && secondRegister(code[i + 1]) == a)
+        {
+            dead[i + 1] = true;
+            i++;
+        }
+    }
+
+    return compact(code, dead);
+}
+
+// Drops a write to a D register that's overwritten before anything reads it.
+// The scan stops at anything it doesn't understand, including every jump, so
+// a value is only dropped when it's dead along the fall-through path.
+bool Optimizer::removeDeadStores(vector<Opcode *> &code)
+{
+    vector<bool> dead(code.size(), false);
+
+    for(size_t i = 0; i < code.size(); i++)
+    {
+        Effects e = effectsOf(code[i]);
+
+        if(!e.known || !e.removable || !e.writes)
+            continue;
+
+        for(size_t j = i + 1; j < code.size(); j++)
+        {
+            Effects next = effectsOf(code[j]);
+
+            if(!next.known || (next.reads & e.writes))
+                break;
+
+            if(next.writes & e.writes)
+            {
+                dead[i] = true;
+                break;
+            }
+        }
+    }
+
+    return compact(code, dead);
+}
+
+// Deletes the marked instructions. A label on a deleted instruction moves to
+// the next one that's kept; if that already has a label, references to the
+// old one are renamed instead.
+bool Optimizer::compact(vector<Opcode *> &code, vector<bool> &dead)
+{
+    map<int, int> aliases;
+    size_t next = code.size();
+
+    for(size_t i = code.size(); i-- > 0;)
+    {
+        if(!dead[i])
+        {
+            next = i;
+            continue;
+        }
+
+        int label = code[i]->getLabel();
+
+        if(label == -1)
+            continue;
+
+        if(next == code.size())
+        {
+            // Nothing after it to take the label.
+            dead[i] = false;
+            next = i;
+        }
+        else if(code[next]->getLabel() == -1)
+            code[next]->setLabel(label);
+        else
+            aliases[label] = code[next]->getLabel();
+    }
+
+    vector<Opcode *> kept;
+
+    for(size_t i = 0; i < code.size(); i++)
+    {
+        if(dead[i])
+            delete code[i];
+        else
+            kept.push_back(code[i]);
+    }
+
+    bool changed = kept.size() != code.size();
+    code.swap(kept);
+
+    if(!aliases.empty())
+    {
+        for(vector<Opcode *>::iterator it = code.begin(); it != code.end(); it++)
+        {
+            RenameLabels temp;
+            (*it)->execute(temp, &aliases);
+        }
+    }
+
+    return changed;
+}
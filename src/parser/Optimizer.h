@@ -0,0 +1,30 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include "Compiler.h"
+
+// Peephole passes over an assembled script, run before its labels are turned
+// into line numbers. Only the D registers are treated as plain storage;
+// anything touching an engine variable, the stack or the flags is left alone.
+class Optimizer
+{
+public:
+    Optimizer() : before(0), after(0) {}
+    void optimize(vector<Opcode *> &code);
+
+    // Instruction counts over every script passed to optimize().
+    int before;
+    int after;
+private:
+    bool dropUnusedLabels(vector<Opcode *> &code);
+    bool threadJumps(vector<Opcode *> &code);
+    bool removeUnreachable(vector<Opcode *> &code);
+    bool removeJumpsToNext(vector<Opcode *> &code);
+    bool foldPushPop(vector<Opcode *> &code);
+    bool propagateConstants(vector<Opcode *> &code);
+    bool removeCopies(vector<Opcode *> &code);
+    bool removeDeadStores(vector<Opcode *> &code);
+    bool compact(vector<Opcode *> &code, vector<bool> &dead);
+};
+
+#endif
@@ -5,11 +5,14 @@
 #include "ByteCode.h"
 #include "CompileError.h"
 #include "GlobalSymbols.h"
+#include "Optimizer.h"
 #include "y.tab.hpp"
 #include <iostream>
 #include <assert.h>
 #include <string>
 #include <cstdlib>
+#include <cctype>
+#include <set>
 
 #include "ASTVisitors.h"
 #include "DataStructs.h"
@@ -25,6 +28,24 @@ ASTProgram* resAST;
 
 ScriptsData* compile(const char *filename);
 
+namespace
+{
+    // Canonical paths of the files in the current compile, so each one is
+    // only imported once.
+    set<string> importedFiles;
+
+    // Imports parsed by earlier compiles, by canonical path. An entry is
+    // reused as long as the file's contents still hash the same.
+    struct ParsedImport
+    {
+        unsigned long long hash;
+        size_t size;
+        ASTProgram* ast;
+    };
+
+    map<string, ParsedImport> parsedImports;
+}
+
 #ifdef PARSER_DEBUG
 int main(int argc, char *argv[])
 {
@@ -36,6 +57,8 @@ int main(int argc, char *argv[])
 ScriptsData* compile(const char *filename)
 {
     ScriptParser::resetState();
+    importedFiles.clear();
+    importedFiles.insert(ScriptParser::canonicalPath(filename));
 
     box_out("Pass 1: Parsing");
     box_eol();
@@ -123,6 +146,83 @@ string ScriptParser::prepareFilename(string const& filename)
     return retval;
 }
 
+string ScriptParser::canonicalPath(string const& filename)
+{
+#ifdef _WIN32
+    char buf[_MAX_PATH];
+
+    if (!_fullpath(buf, filename.c_str(), _MAX_PATH))
+        return filename;
+
+    // Paths aren't case sensitive here.
+    string retval(buf);
+
+    for (size_t i = 0; i < retval.size(); ++i)
+        retval[i] = tolower((unsigned char)retval[i]);
+
+    return retval;
+#else
+    char* buf = realpath(filename.c_str(), NULL);
+
+    if (!buf)
+        return filename;
+
+    string retval(buf);
+    free(buf);
+    return retval;
+#endif
+}
+
+ASTProgram* ScriptParser::parseImport(string const& filename, string const& path)
+{
+    // FNV-1a over the file's contents.
+    unsigned long long hash = 14695981039346656037ULL;
+    size_t size = 0;
+    bool hashed = false;
+
+    if (FILE* f = fopen(filename.c_str(), "rb"))
+    {
+        char buf[4096];
+        size_t count;
+
+        while ((count = fread(buf, 1, sizeof(buf), f)) > 0)
+        {
+            for (size_t i = 0; i < count; ++i)
+            {
+                hash ^= (unsigned char)buf[i];
+                hash *= 1099511628211ULL;
+            }
+
+            size += count;
+        }
+
+        hashed = !ferror(f);
+        fclose(f);
+    }
+
+    map<string, ParsedImport>::iterator it = parsedImports.find(path);
+
+    if (hashed && it != parsedImports.end()
+        && it->second.hash == hash && it->second.size == size)
+        return it->second.ast->clone();
+
+    if (go(filename.c_str()) != 0 || !resAST)
+        return NULL;
+
+    if (hashed)
+    {
+        if (it != parsedImports.end())
+            delete it->second.ast;
+
+        ParsedImport& entry = parsedImports[path];
+        entry.hash = hash;
+        entry.size = size;
+        entry.ast = resAST->clone();
+    }
+
+    return resAST;
+}
+
 bool ScriptParser::preprocess(ASTProgram* theAST, int reclimit)
 {
     if (reclimit == 0)
@@ -137,14 +237,23 @@ bool ScriptParser::preprocess(ASTProgram* theAST, int reclimit)
 		 it != imports.end(); it = imports.erase(it))
     {
         string fn = prepareFilename((*it)->filename);
+        string path = canonicalPath(fn);
+
+        // Already imported, maybe by another file or under another name.
+        if (!importedFiles.insert(path).second)
+        {
+            delete *it;
+            continue;
+        }
 
-        if (go(fn.c_str()) != 0 || !resAST)
+        ASTProgram* recAST = parseImport(fn, path);
+
+        if (!recAST)
         {
 			CompileError::CantOpenImport.print(*it, fn);
             return false;
         }
 
-        ASTProgram* recAST = resAST;
         if (!preprocess(recAST, reclimit - 1))
         {
             delete recAST;
@@ -369,14 +478,18 @@ ScriptsData *ScriptParser::assemble(IntermediateData *id)
         ginit.push_back(new OGotoImmediate(new LabelArgument(label)));
     }
     
-    rval->theScripts["~Init"] = assembleOne(ginit, funcs, 0);
+    // optimize_zscript comes from the ZQuest config
+    Optimizer optimizer;
+    Optimizer *opt = optimize_zscript ? &optimizer : NULL;
+    
+    rval->theScripts["~Init"] = assembleOne(ginit, funcs, 0, opt);
     rval->scriptTypes["~Init"] = SCRIPTTYPE_GLOBAL;
     
     for(map<string, int>::iterator it2 = scripts.begin(); it2 != scripts.end(); it2++)
     {
         vector<Opcode *> code = funcs[it2->second];
 		int numparams = id->program.getScript(it2->first)->getRun()->paramTypes.size();
-        rval->theScripts[it2->first] = assembleOne(code, funcs, numparams);
+        rval->theScripts[it2->first] = assembleOne(code, funcs, numparams, opt);
         rval->scriptTypes[it2->first] = scripttypes[it2->first];
     }
     
@@ -393,10 +506,18 @@ ScriptsData *ScriptParser::assemble(IntermediateData *id)
         }
     }
     
+    if(opt)
+    {
+        char buf[100];
+        sprintf(buf, "Optimized %d instructions down to %d", optimizer.before, optimizer.after);
+        box_out(buf);
+        box_eol();
+    }
+    
     return rval;
 }
 
-vector<Opcode *> ScriptParser::assembleOne(vector<Opcode *> script, map<int, vector<Opcode *> > &otherfuncs, int numparams)
+vector<Opcode *> ScriptParser::assembleOne(vector<Opcode *> script, map<int, vector<Opcode *> > &otherfuncs, int numparams, Optimizer *optimizer)
 {
     vector<Opcode *> rval;
     //first, push on the params to the run
@@ -462,6 +583,9 @@ vector<Opcode *> ScriptParser::assembleOne(vector<Opcode *> script, map<int, vec
         }
     }
     
+    if(optimizer)
+        optimizer->optimize(rval);
+        
     //set the label line numbers
     map<int, int> linenos;
     int lineno=1;
@@ -0,0 +1,116 @@
+#include "precompiled.h" //always first
+
+#include <stdio.h>
+#include <string.h>
+#include "zdefs.h"
+#include "profiler.h"
+#include "zc_clock.h"
+
+static const char *phase_names[PROF_PHASES] =
+{
+    "global", "ffc", "enemies", "link", "collide", "draw", "prims", "present"
+};
+
+static const char *phase_columns[PROF_PHASES] =
+{
+    "global_script", "ffc_scripts", "enemies", "link", "collisions", "draw_screen", "primitives", "updatescr"
+};
+
+struct profile_frame
+{
+    unsigned int total;
+    unsigned int phase[PROF_PHASES];
+};
+
+static profile_frame frames[PROFILE_FRAMES];
+static int framepos = 0;                                    // slot being filled
+static int framecount = 0;                                  // completed frames
+static unsigned long long framestart = 0;
+static unsigned long long phasestart[PROF_PHASES];
+static int phasedepth[PROF_PHASES];
+
+void profile_begin(int phase)
+{
+    // Recursive entries are counted once, by the outermost one
+    if(phasedepth[phase]++ == 0)
+        phasestart[phase] = zc_clock_usec();
+}
+
+void profile_end(int phase)
+{
+    if(phasedepth[phase] > 0 && --phasedepth[phase] == 0)
+        frames[framepos].phase[phase] += (unsigned int)(zc_clock_usec() - phasestart[phase]);
+}
+
+void profile_next_frame()
+{
+    unsigned long long now = zc_clock_usec();
+    
+    if(framestart == 0)
+        framestart = now;
+        
+    frames[framepos].total = (unsigned int)(now - framestart);
+    framestart = now;
+    framepos = (framepos + 1) % PROFILE_FRAMES;
+    memset(&frames[framepos], 0, sizeof(profile_frame));
+    
+    if(framecount < PROFILE_FRAMES)
+        ++framecount;
+}
+
+void profile_draw(BITMAP *target, int x, int y)
+{
+    int n = framecount < 60 ? framecount : 60;
+    
+    if(n == 0)
+        return;
+        
+    textprintf_ex(target, font, x, y, 254, BLACK, "%-8s %6s %6s", "ms", "avg", "max");
+    
+    for(int p = -1; p < PROF_PHASES; p++)
+    {
+        unsigned int sum = 0, worst = 0;
+        
+        for(int i = 1; i <= n; i++)
+        {
+            const profile_frame &f = frames[(framepos - i + PROFILE_FRAMES) % PROFILE_FRAMES];
+            unsigned int t = p < 0 ? f.total : f.phase[p];
+            sum += t;
+            
+            if(t > worst)
+                worst = t;
+        }
+        
+        textprintf_ex(target, font, x, y + 8 * (p + 2), 254, BLACK, "%-8s %6.2f %6.2f",
+                      p < 0 ? "frame" : phase_names[p], sum / 1000.0 / n, worst / 1000.0);
+    }
+}
+
+bool profile_save_csv(const char *filename)
+{
+    FILE *f = fopen(filename, "w");
+    
+    if(!f)
+        return false;
+        
+    fprintf(f, "frame,total");
+    
+    for(int p = 0; p < PROF_PHASES; p++)
+        fprintf(f, ",%s", phase_columns[p]);
+        
+    fprintf(f, "\n");
+    
+    for(int i = framecount; i > 0; i--)
+    {
+        const profile_frame &fr = frames[(framepos - i + PROFILE_FRAMES) % PROFILE_FRAMES];
+        fprintf(f, "%d,%u", framecount - i, fr.total);
+        
+        for(int p = 0; p < PROF_PHASES; p++)
+            fprintf(f, ",%u", fr.phase[p]);
+            
+        fprintf(f, "\n");
+    }
+    
+    fclose(f);
+    return true;
+}
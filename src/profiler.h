@@ -0,0 +1,49 @@
+#ifndef _ZC_PROFILER_H_
+#define _ZC_PROFILER_H_
+
+#include "zc_alleg.h"
+
+// Per-frame timings of the main phases of a game frame. Timings are kept
+// for the last PROFILE_FRAMES frames, and can be drawn as an overlay or
+// saved as CSV. Phases can nest (do_primitives() runs inside
+// draw_screen()), and a phase entered several times in a frame is summed.
+
+enum
+{
+    PROF_GLOBAL_SCRIPT, PROF_FFC_SCRIPTS, PROF_ENEMIES, PROF_LINK,
+    PROF_COLLISIONS, PROF_DRAW_SCREEN, PROF_PRIMITIVES, PROF_UPDATESCR,
+    PROF_PHASES
+};
+
+#define PROFILE_FRAMES 600
+
+void profile_begin(int phase);
+void profile_end(int phase);
+
+// Closes the current frame. Call once per frame.
+void profile_next_frame();
+
+// Draws the average and worst time of each phase over the last second.
+void profile_draw(BITMAP *target, int x, int y);
+
+// Writes every recorded frame, oldest first. Returns false on failure.
+bool profile_save_csv(const char *filename);
+
+// Times the enclosing block as the given phase
+class ProfileScope
+{
+public:
+    ProfileScope(int phase) : phase_(phase)
+    {
+        profile_begin(phase);
+    }
+    ~ProfileScope()
+    {
+        profile_end(phase_);
+    }
+    
+private:
+    int phase_;
+};
+
+#endif
@@ -38,6 +38,7 @@
 #include <sstream>
 #include "backend/AllBackends.h"
 #include "scripting/ZASMdefs.h"
+#include "thread.h"
 
 #ifdef _MSC_VER
 	#define strncasecmp _strnicmp
@@ -83,6 +84,12 @@ extern refInfo ffcScriptData[32];
 
 bool combosread=false;
 bool mapsread=false;
+
+// Set on the worker threads loadquest uses to read some sections early.
+// Readers running there leave messages and shared caches to the main thread.
+struct quest_section_job;
+static ZC_THREAD_LOCAL quest_section_job *section_job = NULL;
+static void section_message(const char *format, ...);
 bool fixffcs=false;
 bool fixpolsvoice=false;
 
@@ -661,8 +668,6 @@ bool valid_zqt(const char *filename)
 
 PACKFILE *open_quest_file(int *open_error, const char *filename, char *deletefilename, bool compressed,bool encrypted, bool show_progress)
 {
-    char tmpfilename[32];
-    temp_name(tmpfilename);
     char percent_done[30];
     int current_method=0;
     
@@ -673,6 +678,14 @@ PACKFILE *open_quest_file(int *open_error, const char *filename, char *deletefil
     bool oldquest = false;
     int ret;
     
+    // The file is read once and decoded in memory; the section readers then
+    // read the result through a memory PACKFILE instead of a temp file.
+    byte *srcdata = NULL, *decoded = NULL;
+    long srcsize = 0, decoded_size = 0;
+    
+    if(deletefilename)
+        deletefilename[0]=0;
+        
     if(show_progress)
     {
         box_start(1, "Loading Quest", lfont, font, true);
@@ -691,7 +704,12 @@ PACKFILE *open_quest_file(int *open_error, const char *filename, char *deletefil
     {
         box_out("Decrypting...");
         box_save_x();
-        ret = decode_file_007(filename, tmpfilename, ENC_STR, ENC_METHOD_MAX-1, strstr(filename, ".dat#")!=NULL, passwd);
+        ret = read_file_007(filename, strstr(filename, ".dat#")!=NULL, passwd, &srcdata, &srcsize);
+        
+        if(!ret)
+        {
+            ret = decode_buf_007(srcdata, srcsize, ENC_STR, ENC_METHOD_MAX-1, &decoded, &decoded_size);
+        }
         
         if(ret)
         {
@@ -705,12 +723,12 @@ PACKFILE *open_quest_file(int *open_error, const char *filename, char *deletefil
                 return NULL;
                 
             case 2:
+                zc_free(srcdata);
                 box_out("error.");
                 box_eol();
                 box_end(true);
                 *open_error=qe_internal;
                 return NULL;
-                // be sure not to delete tmpfilename now...
             }
             
             if(ret==5)                                              //old encryption?
@@ -719,7 +737,7 @@ PACKFILE *open_quest_file(int *open_error, const char *filename, char *deletefil
                 sprintf(percent_done, "%d%%", (current_method*100)/ENC_METHOD_MAX);
                 box_out(percent_done);
                 box_load_x();
-                ret = decode_file_007(filename, tmpfilename, ENC_STR, ENC_METHOD_211B9, strstr(filename, ".dat#")!=NULL, passwd);
+                ret = decode_buf_007(srcdata, srcsize, ENC_STR, ENC_METHOD_211B9, &decoded, &decoded_size);
             }
             
             if(ret==5)                                              //old encryption?
@@ -728,7 +746,7 @@ PACKFILE *open_quest_file(int *open_error, const char *filename, char *deletefil
                 sprintf(percent_done, "%d%%", (current_method*100)/ENC_METHOD_MAX);
                 box_out(percent_done);
                 box_load_x();
-                ret = decode_file_007(filename, tmpfilename, ENC_STR, ENC_METHOD_192B185, strstr(filename, ".dat#")!=NULL, passwd);
+                ret = decode_buf_007(srcdata, srcsize, ENC_STR, ENC_METHOD_192B185, &decoded, &decoded_size);
             }
             
             if(ret==5)                                              //old encryption?
@@ -737,7 +755,7 @@ PACKFILE *open_quest_file(int *open_error, const char *filename, char *deletefil
                 sprintf(percent_done, "%d%%", (current_method*100)/ENC_METHOD_MAX);
                 box_out(percent_done);
                 box_load_x();
-                ret = decode_file_007(filename, tmpfilename, ENC_STR, ENC_METHOD_192B105, strstr(filename, ".dat#")!=NULL, passwd);
+                ret = decode_buf_007(srcdata, srcsize, ENC_STR, ENC_METHOD_192B105, &decoded, &decoded_size);
             }
             
             if(ret==5)                                              //old encryption?
@@ -746,7 +764,7 @@ PACKFILE *open_quest_file(int *open_error, const char *filename, char *deletefil
                 sprintf(percent_done, "%d%%", (current_method*100)/ENC_METHOD_MAX);
                 box_out(percent_done);
                 box_load_x();
-                ret = decode_file_007(filename, tmpfilename, ENC_STR, ENC_METHOD_192B104, strstr(filename, ".dat#")!=NULL, passwd);
+                ret = decode_buf_007(srcdata, srcsize, ENC_STR, ENC_METHOD_192B104, &decoded, &decoded_size);
             }
             
             if(ret)
@@ -756,6 +774,7 @@ PACKFILE *open_quest_file(int *open_error, const char *filename, char *deletefil
             }
         }
         
+        zc_free(srcdata);
         box_out("okay.");
         box_eol();
     }
@@ -765,34 +784,38 @@ PACKFILE *open_quest_file(int *open_error, const char *filename, char *deletefil
     }
     
     box_out("Opening...");
-    f = pack_fopen_password(oldquest ? filename : tmpfilename, compressed ? F_READ_PACKED : F_READ, passwd);
     
-    if(!f)
+    if(oldquest)
+    {
+        f = pack_fopen_password(filename, compressed ? F_READ_PACKED : F_READ, passwd);
+        
+        if(!f && (compressed==1)&&(errno==EDOM))
+        {
+            f = pack_fopen_password(filename, F_READ, passwd);
+        }
+    }
+    else
     {
-        if((compressed==1)&&(errno==EDOM))
+        f = pack_fopen_decoded(decoded, decoded_size, compressed, passwd);
+        
+        if(!f && (compressed==1)&&(errno==EDOM))
         {
-            f = pack_fopen_password(oldquest ? filename : tmpfilename, F_READ, passwd);
+            f = pack_fopen_decoded(decoded, decoded_size, false, passwd);
         }
         
         if(!f)
         {
-            if(!oldquest)
-            {
-                delete_file(tmpfilename);
-            }
-            
-            box_out("error.");
-            box_eol();
-            box_end(true);
-            *open_error=qe_invalid;
-            return NULL;
+            zc_free(decoded);
         }
     }
     
-    if(!oldquest)
+    if(!f)
     {
-        if(deletefilename)
-            sprintf(deletefilename, "%s", tmpfilename);
+        box_out("error.");
+        box_eol();
+        box_end(true);
+        *open_error=qe_invalid;
+        return NULL;
     }
     
     box_out("okay.");
@@ -2624,7 +2647,7 @@ int readstrings(PACKFILE *f, zquestheader *Header, bool keepdata)
             
             if(temp_msg_count >= msg_strings_size)
             {
-                Z_message("Reallocating string buffer...\n");
+                section_message("Reallocating string buffer...\n");
                 
                 if((MsgStrings=(MsgStr*)_al_sane_realloc(MsgStrings,sizeof(MsgStr)*MAXMSGS))==NULL)
                     return qe_nomem;
@@ -2737,7 +2760,7 @@ int readstrings(PACKFILE *f, zquestheader *Header, bool keepdata)
         
         if(temp_msg_count >= msg_strings_size)
         {
-            Z_message("Reallocating string buffer...\n");
+            section_message("Reallocating string buffer...\n");
             
             if((MsgStrings=(MsgStr*)_al_sane_realloc(MsgStrings,sizeof(MsgStr)*MAXMSGS))==NULL)
                 return qe_nomem;
@@ -4681,7 +4704,7 @@ int readmisc(PACKFILE *f, zquestheader *Header, miscQdata *Misc, bool keepdata)
 
 void reset_itembuf(itemdata *item, const ItemDefinitionRef &iref)
 {
-    if(iref.module == "CORE" && iref.slot<iLast)
+    if(iref.moduleId == QUEST_MODULE_CORE && iref.slot<iLast)
     {
         // Copy everything *EXCEPT* the tile, misc, cset, frames, speed, delay and ltm.
         word tile = item->tile;
@@ -8345,6 +8368,7 @@ int read_one_script(PACKFILE *f, zquestheader *, int , word s_version, word , in
     
 	script.commands_len = num_commands;
 	delete[] script.commands;
+	script.clearDecoded();
 
 	// some old quests have no commands, not even 0xFFFF
 	if (script.commands_len == 0)
@@ -11368,6 +11392,7 @@ int readmaps(PACKFILE *f, zquestheader *Header, bool keepdata)
     {
         const int _mapsSize = MAPSCRS*temp_map_count;
         TheMaps.resize(_mapsSize);
+        al_trace("Map buffer: %d screens of %d bytes, %s\n", _mapsSize, (int)sizeof(mapscr), byte_conversion(sizeof(mapscr)*_mapsSize, -1));
         
         for(int i(0); i<_mapsSize; i++)
             TheMaps[i].zero_memory();
@@ -11540,10 +11565,14 @@ int readcombos(PACKFILE *f, zquestheader *Header, word version, word build, word
     //these are here to bypass compiler warnings about unused arguments
     Header=Header;
     
-    reset_combo_animations();
-    reset_combo_animations2();
-    
-    init_combo_classes();
+    // start_section_jobs does this on the main thread for a worker
+    if(!section_job)
+    {
+        reset_combo_animations();
+        reset_combo_animations2();
+        
+        init_combo_classes();
+    }
     
     // combos
     word combos_used=0;
@@ -12293,7 +12322,30 @@ int readtiles(PACKFILE *f, tiledata *buf, zquestheader *Header, word version, wo
     {
         for(int i=start_tile+tiles_used; i<max_tiles; ++i)
         {
-            reset_tile(buf,i,tf4Bit);
+            // reset_tile() also drops the unpacked copy, which belongs to
+            // the main thread; finish_section_job invalidates them all
+            if(section_job)
+            {
+                if(buf[i].data)
+                {
+                    zc_free(buf[i].data);
+                }
+                
+                buf[i].format=tf4Bit;
+                buf[i].data=(byte *)zc_malloc(tilesize(tf4Bit));
+                
+                if(buf[i].data==NULL)
+                {
+                    delete[] temp_tile;
+                    return qe_nomem;
+                }
+                
+                memset(buf[i].data,0,tilesize(tf4Bit));
+            }
+            else
+            {
+                reset_tile(buf,i,tf4Bit);
+            }
         }
         
         if((version < 0x192)|| ((version == 0x192)&&(build<186)))
@@ -12344,6 +12396,11 @@ int readtiles(PACKFILE *f, tiledata *buf, zquestheader *Header, word version, wo
         register_blank_tiles();
     }
     
+    if(!section_job)
+    {
+        invalidate_unpacked_tiles();
+    }
+    
     //memset(temp_tile, 0, tilesize(tf32Bit));
     delete[] temp_tile;
     temp_tile=NULL;
@@ -14096,6 +14153,317 @@ const char *skip_text[skip_max]=
     "skip_favorites"
 };
 
+// Strings, combos, tiles and tunes are the bulk of a quest, and their readers
+// only touch data of their own (plus the rules, which come first). Once the
+// rules have been read, loadquest hands those sections to worker threads,
+// each reading its own slice of the decoded quest, and picks the results up
+// in file order when its main loop reaches them.
+#define MAX_SECTION_JOBS 4
+
+struct quest_section_job
+{
+    dword id;
+    byte *start;                                            // just past the section id
+    byte *end;
+    PACKFILE *f;
+    zc_thread *thread;
+    zquestheader *header;
+    zctune *tunes;
+    bool keepdata;
+    bool consumed;                                          // reader stopped exactly at end
+    int ret;
+    int readsize;                                           // added to readsize when picked up
+    std::string messages;                                   // printed when picked up
+};
+
+static void section_message(const char *format, ...)
+{
+    char buf[2048];
+    
+    va_list ap;
+    va_start(ap, format);
+    vsprintf(buf, format, ap);
+    va_end(ap);
+    
+    if(section_job)
+    {
+        section_job->messages+=buf;
+    }
+    else
+    {
+        Z_message("%s", buf);
+    }
+}
+
+struct quest_section_jobs
+{
+    quest_section_job job[MAX_SECTION_JOBS];
+    int count;
+    byte *buffer;                                           // decoded quest, once taken from f
+    
+    quest_section_jobs(): count(0), buffer(NULL) {}
+    
+    ~quest_section_jobs()
+    {
+        for(int i=0; i<count; ++i)
+        {
+            finish(job[i]);
+        }
+        
+        if(buffer)
+        {
+            zc_free(buffer);
+        }
+    }
+    
+    static void finish(quest_section_job &j)
+    {
+        if(j.thread)
+        {
+            thread_join(j.thread);
+            j.thread=NULL;
+        }
+        
+        if(j.f)
+        {
+            pack_fclose(j.f);
+            j.f=NULL;
+        }
+    }
+};
+
+static bool is_quest_section(dword id)
+{
+    switch(id)
+    {
+    case ID_RULES:
+    case ID_STRINGS:
+    case ID_MISC:
+    case ID_TILES:
+    case ID_COMBOS:
+    case ID_COMBOALIASES:
+    case ID_CSETS:
+    case ID_MAPS:
+    case ID_DMAPS:
+    case ID_DOORS:
+    case ID_ITEMS:
+    case ID_WEAPONS:
+    case ID_COLORS:
+    case ID_ICONS:
+    case ID_INITDATA:
+    case ID_GUYS:
+    case ID_LINKSPRITES:
+    case ID_SUBSCREEN:
+    case ID_FFSCRIPT:
+    case ID_SFX:
+    case ID_MIDIS:
+    case ID_CHEATS:
+    case ID_ITEMDROPSETS:
+    case ID_FAVORITES:
+        return true;
+    }
+    
+    return false;
+}
+
+static void read_section_job(void *arg)
+{
+    quest_section_job *j=(quest_section_job *)arg;
+    zquestheader *Header=j->header;
+    section_job=j;
+    readsize=0;
+    
+    switch(j->id)
+    {
+    case ID_STRINGS:
+        j->ret=readstrings(j->f, Header, j->keepdata);
+        break;
+        
+    case ID_TILES:
+        j->ret=readtiles(j->f, newtilebuf, Header, Header->zelda_version, Header->build, 0, NEWMAXTILES, false, j->keepdata);
+        break;
+        
+    case ID_COMBOS:
+        j->ret=readcombos(j->f, Header, Header->zelda_version, Header->build, 0, MAXCOMBOS, j->keepdata);
+        break;
+        
+    case ID_MIDIS:
+        j->ret=readtunes(j->f, Header, j->tunes, j->keepdata);
+        break;
+    }
+    
+    byte *pos, *end;
+    j->consumed=pack_memory_range(j->f, &pos, &end) && pos==end;
+    j->readsize=readsize;
+    section_job=NULL;
+}
+
+// Indexes the sections following the current position of f, the same way
+// find_section skips over them, and starts a worker for each one that can be
+// read on its own. Stops at the first bad token, since loadquest has to
+// search byte by byte from there. Does nothing for files read from disk.
+static void start_section_jobs(PACKFILE *f, quest_section_jobs &jobs, zquestheader *Header, zctune *tunes, bool keepall, byte *skip_flags)
+{
+    byte *pos, *end;
+    
+    if(!pack_memory_range(f, &pos, &end))
+    {
+        return;
+    }
+    
+    while(end-pos>=12 && jobs.count<MAX_SECTION_JOBS)
+    {
+        dword id=((dword)pos[0]<<24)|(pos[1]<<16)|(pos[2]<<8)|pos[3];
+        
+        if(!is_quest_section(id))
+        {
+            break;
+        }
+        
+        //section version info, then section size
+        byte *start=pos+4;
+        dword size=start[4]|(start[5]<<8)|(start[6]<<16)|((dword)start[7]<<24);
+        
+        if(size>(dword)(end-start-8))
+        {
+            break;
+        }
+        
+        pos=start+8+size;
+        
+        int skip;
+        
+        switch(id)
+        {
+        case ID_STRINGS:
+            skip=skip_strings;
+            break;
+            
+        case ID_TILES:
+            // tiles are taken from the template instead
+            if(!Header->data_flags[ZQ_TILES])
+            {
+                continue;
+            }
+            
+            // old BS Zelda quests fix up tiles using the weapons section
+            if((Header->zelda_version < 0x192)||((Header->zelda_version == 0x192)&&(Header->build<186)))
+            {
+                continue;
+            }
+            
+            skip=skip_tiles;
+            break;
+            
+        case ID_COMBOS:
+            skip=skip_combos;
+            break;
+            
+        case ID_MIDIS:
+            skip=skip_midis;
+            break;
+            
+        default:
+            continue;
+        }
+        
+        quest_section_job &j=jobs.job[jobs.count++];
+        j.id=id;
+        j.start=start;
+        j.end=pos;
+        j.f=NULL;
+        j.thread=NULL;
+        j.header=Header;
+        j.tunes=tunes;
+        j.keepdata=keepall&&!get_bit(skip_flags, skip);
+        j.consumed=false;
+        j.ret=0;
+        j.readsize=0;
+        j.messages.clear();
+    }
+    
+    if(!jobs.count)
+    {
+        return;
+    }
+    
+    // f is still read after the jobs finish, so the buffer is freed with them
+    jobs.buffer=pack_memory_release(f);
+    
+    // readcombos leaves these to the main thread. They restore the old
+    // combos' tiles, so they have to run before the new ones are read.
+    for(int i=0; i<jobs.count; ++i)
+    {
+        if(jobs.job[i].id==ID_COMBOS)
+        {
+            reset_combo_animations();
+            reset_combo_animations2();
+            
+            init_combo_classes();
+        }
+    }
+    
+    for(int i=0; i<jobs.count; ++i)
+    {
+        quest_section_job &j=jobs.job[i];
+        j.f=pack_fopen_memory(NULL, j.start, j.end-j.start);
+        
+        if(j.f)
+        {
+            j.thread=thread_start(read_section_job, &j);
+        }
+    }
+}
+
+// Called by loadquest with f just past the id of a section that may have
+// been handed to a worker. Waits for that worker, and if it read this very
+// section cleanly, skips f past it and returns true. Otherwise the section
+// is left for loadquest to read as usual. Whatever the worker had to leave
+// to the main thread (its byte count, messages, cached tiles) is done here.
+static bool finish_section_job(PACKFILE *f, quest_section_jobs &jobs, dword id)
+{
+    for(int i=0; i<jobs.count; ++i)
+    {
+        quest_section_job &j=jobs.job[i];
+        
+        if(j.id!=id || !j.f)
+        {
+            continue;
+        }
+        
+        bool started=(j.thread!=NULL);
+        quest_section_jobs::finish(j);
+        
+        byte *pos, *end;
+        
+        if(!started || j.ret!=0 || !j.consumed || !pack_memory_range(f, &pos, &end) || pos!=j.start)
+        {
+            return false;
+        }
+        
+        if(pack_fseek(f, j.end-j.start)!=0)
+        {
+            return false;
+        }
+        
+        readsize+=j.readsize;
+        
+        if(!j.messages.empty())
+        {
+            Z_message("%s", j.messages.c_str());
+        }
+        
+        if(id==ID_TILES)
+        {
+            invalidate_unpacked_tiles();
+        }
+        
+        return true;
+    }
+    
+    return false;
+}
+
 int loadquest(const char *filename, zquestheader *Header, miscQdata *Misc, zctune *tunes, bool show_progress, bool compressed, bool encrypted, bool keepall, byte *skip_flags)
 {
     combosread=false;
@@ -14179,6 +14547,7 @@ int loadquest(const char *filename, zquestheader *Header, miscQdata *Misc, zctun
     if(!f)
         return open_error;
         
+    quest_section_jobs jobs;
     int ret=0;
     
     //header
@@ -14218,6 +14587,12 @@ int loadquest(const char *filename, zquestheader *Header, miscQdata *Misc, zctun
                 checkstatus(ret);
                 box_out("okay.");
                 box_eol();
+                
+                if (!jobs.count)
+                {
+                    start_section_jobs(f, jobs, &tempheader, tunes, keepall, skip_flags);
+                }
+                
                 break;
 
             case ID_STRINGS:
@@ -14231,7 +14606,10 @@ int loadquest(const char *filename, zquestheader *Header, miscQdata *Misc, zctun
                 }
 
                 box_out("Reading Strings...");
-                ret = readstrings(f, &tempheader, keepall && !get_bit(skip_flags, skip_strings));
+                if (!finish_section_job(f, jobs, ID_STRINGS))
+                {
+                    ret = readstrings(f, &tempheader, keepall && !get_bit(skip_flags, skip_strings));
+                }
                 checkstatus(ret);
                 box_out("okay.");
                 box_eol();
@@ -14265,7 +14643,10 @@ int loadquest(const char *filename, zquestheader *Header, miscQdata *Misc, zctun
                 }
 
                 box_out("Reading Tiles...");
-                ret = readtiles(f, newtilebuf, &tempheader, tempheader.zelda_version, tempheader.build, 0, NEWMAXTILES, false, keepall && !get_bit(skip_flags, skip_tiles));
+                if (!finish_section_job(f, jobs, ID_TILES))
+                {
+                    ret = readtiles(f, newtilebuf, &tempheader, tempheader.zelda_version, tempheader.build, 0, NEWMAXTILES, false, keepall && !get_bit(skip_flags, skip_tiles));
+                }
                 checkstatus(ret);
                 box_out("okay.");
                 box_eol();
@@ -14282,7 +14663,10 @@ int loadquest(const char *filename, zquestheader *Header, miscQdata *Misc, zctun
                 }
 
                 box_out("Reading Combos...");
-                ret = readcombos(f, &tempheader, tempheader.zelda_version, tempheader.build, 0, MAXCOMBOS, keepall && !get_bit(skip_flags, skip_combos));
+                if (!finish_section_job(f, jobs, ID_COMBOS))
+                {
+                    ret = readcombos(f, &tempheader, tempheader.zelda_version, tempheader.build, 0, MAXCOMBOS, keepall && !get_bit(skip_flags, skip_combos));
+                }
                 combosread = true;
                 checkstatus(ret);
                 box_out("okay.");
@@ -14629,7 +15013,11 @@ int loadquest(const char *filename, zquestheader *Header, miscQdata *Misc, zctun
                 }
                 
                 box_out("Reading Tunes...");
-                ret=readtunes(f, &tempheader, tunes, keepall&&!get_bit(skip_flags, skip_midis));
+                if(!finish_section_job(f, jobs, ID_MIDIS))
+                {
+                    ret=readtunes(f, &tempheader, tunes, keepall&&!get_bit(skip_flags, skip_midis));
+                }
+                
                 checkstatus(ret);
                 box_out("okay.");
                 box_eol();
@@ -1,12 +1,29 @@
 #include "Quest.h"
 
+uint32_t Quest::itemFamilyEpoch_ = 1;
+
+void QuestModule::setItemDefTable(ItemDefinitionTable &idt)
+{
+    itemDefTable_ = idt;
+    Quest::itemFamiliesChanged();
+}
+
 QuestModule &Quest::getModule(const std::string &name)
 {
     if (name.length() == 0)
     {
         assert(!"Invalid module name");
     }
-    return questModules_[name]; 
+
+    QuestModule &module = questModules_[name];
+    uint32_t id = internQuestModule(name);
+    if (id != QUEST_MODULE_NONE)
+    {
+        if (id >= modulesById_.size())
+            modulesById_.resize(id + 1, NULL);
+        modulesById_[id] = &module;
+    }
+    return module;
 }
 
 itemdata &Quest::getItemDefinition(const ItemDefinitionRef &ref)
@@ -15,7 +32,7 @@ itemdata &Quest::getItemDefinition(const ItemDefinitionRef &ref)
     {
         assert(!"Invalid item ref");
     }
-    return questModules_[ref.module].itemDefTable().getItemDefinition(ref.slot);
+    return moduleById(ref.moduleId)->itemDefTable().getItemDefinition(ref.slot);
 }
 
 wpndata &Quest::getSpriteDefinition(const SpriteDefinitionRef &ref)
@@ -24,7 +41,7 @@ wpndata &Quest::getSpriteDefinition(const SpriteDefinitionRef &ref)
     {
         assert(!"Invalid item ref");
     }
-    return questModules_[ref.module].spriteDefTable().getSpriteDefinition(ref.slot);
+    return moduleById(ref.moduleId)->spriteDefTable().getSpriteDefinition(ref.slot);
 }
 
 guydata &Quest::getEnemyDefinition(const EnemyDefinitionRef &ref)
@@ -33,34 +50,37 @@ guydata &Quest::getEnemyDefinition(const EnemyDefinitionRef &ref)
     {
         assert(!"Invalid item ref");
     }
-    return questModules_[ref.module].enemyDefTable().getEnemyDefinition(ref.slot);
+    return moduleById(ref.moduleId)->enemyDefTable().getEnemyDefinition(ref.slot);
 }
 
 bool Quest::isValid(const ItemDefinitionRef &ref)
 {
-    if (ref.module.length() == 0)               
+    QuestModule *module = moduleById(ref.moduleId);
+    if (!module)
         return false;
-    return questModules_[ref.module].itemDefTable().isValid(ref.slot);
+    return module->itemDefTable().isValid(ref.slot);
 }
 
 bool Quest::isValid(const SpriteDefinitionRef &ref)
 {
-    if (ref.module.length() == 0)               
+    QuestModule *module = moduleById(ref.moduleId);
+    if (!module)
         return false;
-    return questModules_[ref.module].spriteDefTable().isValid(ref.slot);
+    return module->spriteDefTable().isValid(ref.slot);
 }
 
 bool Quest::isValid(const EnemyDefinitionRef &ref)
 {
-    if (ref.module.length() == 0)               
+    QuestModule *module = moduleById(ref.moduleId);
+    if (!module)
         return false;
-    return questModules_[ref.module].enemyDefTable().isValid(ref.slot);
+    return module->enemyDefTable().isValid(ref.slot);
 }
 
 
 ItemDefinitionRef Quest::getCanonicalItemID(int family)
 {
-    std::string lowestmodule;
+    uint32_t lowestmodule = QUEST_MODULE_NONE;
     int lowestid = -1;
     int lowestlevel = -1;
 
@@ -73,65 +93,56 @@ ItemDefinitionRef Quest::getCanonicalItemID(int family)
             {
                 lowestlevel = id.fam_type;
                 lowestid = i;
-                lowestmodule = it->first;
+                lowestmodule = internQuestModule(it->first);
             }
         }
     }
 
-    return ItemDefinitionRef(lowestmodule, lowestid);
+    return ItemDefinitionRef::fromId(lowestmodule, lowestid);
 }
 
 ItemDefinitionRef Quest::getHighestLevelOfFamily(gamedata *source, int family, bool checkenabled)
 {
-    std::string resmodule;
-    int result = -1;
-    int highestlevel = -1;
+    if (family < 0 || family > 255)
+        return ItemDefinitionRef();
 
-    for (std::map<std::string, QuestModule>::iterator it = questModules_.begin(); it != questModules_.end(); ++it)
+    const std::vector<ItemDefinitionRef> &items = source->get_family_items(family);
+
+    for (size_t i = items.size(); i-- > 0;)
     {
-        QuestModule &module = it->second;
-        for (uint32_t i = 0; i < module.itemDefTable().getNumItemDefinitions(); i++)
-        {
-            ItemDefinitionRef ref(it->first, i);
-            if (module.itemDefTable().getItemDefinition(i).family == family && source->get_item(ref) && (checkenabled ? (!(source->get_disabled_item(ref))) : 1))
-            {
-                if (module.itemDefTable().getItemDefinition(i).fam_type >= highestlevel)
-                {
-                    highestlevel = module.itemDefTable().getItemDefinition(i).fam_type;
-                    result = i;
-                    resmodule = it->first;
-                }
-            }
-        }
+        if (!checkenabled || !source->get_disabled_item(items[i]))
+            return items[i];
     }
-    return ItemDefinitionRef(resmodule, result);
+
+    return ItemDefinitionRef();
 }
 
 ItemDefinitionRef Quest::getHighestLevelOfFamily(zinitdata *source, int family)
 {
-    std::string resmodule;
+    uint32_t resmodule = QUEST_MODULE_NONE;
     int result = -1;
     int highestlevel = -1;
 
     for (std::map<std::string, QuestModule>::iterator it = questModules_.begin(); it != questModules_.end(); ++it)
     {
         QuestModule &module = it->second;
+        uint32_t moduleId = internQuestModule(it->first);
         for(uint32_t i=0; i<module.itemDefTable().getNumItemDefinitions(); i++)
         {
-            ItemDefinitionRef ref(it->first, i);
+            ItemDefinitionRef ref = ItemDefinitionRef::fromId(moduleId, i);
             if(module.itemDefTable().getItemDefinition(i).family == family && source->inventoryItems.count(ref)>0)
             {
                 if(module.itemDefTable().getItemDefinition(i).fam_type >= highestlevel)
                 {
                     highestlevel = module.itemDefTable().getItemDefinition(i).fam_type;
                     result=i;
-                    resmodule = it->first;
+                    resmodule = moduleId;
                 }
             }
         }
     }
 
-    return ItemDefinitionRef(resmodule, result);
+    return ItemDefinitionRef::fromId(resmodule, result);
 }
 
 
@@ -142,11 +153,12 @@ ItemDefinitionRef Quest::getItemFromFamilyLevel(int family, int level)
     for (std::map<std::string, QuestModule>::iterator it = questModules_.begin(); it != questModules_.end(); ++it)
     {
         QuestModule &module = it->second;
+        uint32_t moduleId = internQuestModule(it->first);
 
         for (uint32_t i = 0; i < module.itemDefTable().getNumItemDefinitions(); i++)
         {
             if (module.itemDefTable().getItemDefinition(i).family == family && module.itemDefTable().getItemDefinition(i).fam_type == level)
-                return ItemDefinitionRef(it->first, i);
+                return ItemDefinitionRef::fromId(moduleId, i);
         }
     }
 
@@ -183,10 +195,11 @@ ItemDefinitionRef Quest::getItemFromFamilyPower(int family, int power)
     for (std::map<std::string, QuestModule>::iterator it = questModules_.begin(); it != questModules_.end(); ++it)
     {
         QuestModule &module = it->second;
+        uint32_t moduleId = internQuestModule(it->first);
         for (uint32_t i = 0; i < module.itemDefTable().getNumItemDefinitions(); i++)
         {
             if (module.itemDefTable().getItemDefinition(i).family == family && module.itemDefTable().getItemDefinition(i).power == power)
-                return ItemDefinitionRef(it->first, i);
+                return ItemDefinitionRef::fromId(moduleId, i);
         }
     }
 
@@ -200,11 +213,12 @@ void Quest::removeItemsOfFamily(zinitdata *z, int family)
     for (std::map<std::string, QuestModule>::iterator it = questModules_.begin(); it != questModules_.end(); ++it)
     {
         QuestModule &module = it->second;
+        uint32_t moduleId = internQuestModule(it->first);
         for (uint32_t i = 0; i < module.itemDefTable().getNumItemDefinitions(); i++)
         {
             if (module.itemDefTable().getItemDefinition(i).family == family)
             {
-                std::set<ItemDefinitionRef>::iterator it2 = z->inventoryItems.find(ItemDefinitionRef(it->first, i));
+                std::set<ItemDefinitionRef>::iterator it2 = z->inventoryItems.find(ItemDefinitionRef::fromId(moduleId, i));
                 if (it2 != z->inventoryItems.end())
                     z->inventoryItems.erase(*it2);
             }
@@ -217,10 +231,11 @@ void Quest::removeLowerLevelItemsOfFamily(gamedata *g, int family, int level)
     for (std::map<std::string, QuestModule>::iterator it = questModules_.begin(); it != questModules_.end(); ++it)
     {
         QuestModule &module = it->second;
+        uint32_t moduleId = internQuestModule(it->first);
         for (uint32_t i = 0; i < module.itemDefTable().getNumItemDefinitions(); i++)
         {
             if (module.itemDefTable().getItemDefinition(i).family == family && module.itemDefTable().getItemDefinition(i).fam_type < level)
-                g->set_item(ItemDefinitionRef(it->first,i), false);
+                g->set_item(ItemDefinitionRef::fromId(moduleId, i), false);
         }
     }
 }
@@ -232,8 +247,9 @@ int Quest::computeOldStyleBitfield(zinitdata *source, int family)
     for (std::map<std::string, QuestModule>::iterator it = questModules_.begin(); it != questModules_.end(); ++it)
     {
         QuestModule &module = it->second;
+        uint32_t moduleId = internQuestModule(it->first);
         for (uint32_t i = 0; i < module.itemDefTable().getNumItemDefinitions(); i++) {
-            if (module.itemDefTable().getItemDefinition(i).family == family && source->inventoryItems.count(ItemDefinitionRef(it->first, i)) > 0)
+            if (module.itemDefTable().getItemDefinition(i).family == family && source->inventoryItems.count(ItemDefinitionRef::fromId(moduleId, i)) > 0)
             {
                 if (module.itemDefTable().getItemDefinition(i).fam_type > 0)
                     rval |= 1 << (module.itemDefTable().getItemDefinition(i).fam_type - 1);
@@ -249,10 +265,11 @@ void Quest::removeItemsOfFamily(gamedata *g, int family)
     for (std::map<std::string, QuestModule>::iterator it = questModules_.begin(); it != questModules_.end(); ++it)
     {
         QuestModule &module = it->second;
+        uint32_t moduleId = internQuestModule(it->first);
         for (uint32_t i = 0; i < module.itemDefTable().getNumItemDefinitions(); i++) {
             {
                 if (module.itemDefTable().getItemDefinition(i).family == family)
-                    g->set_item(ItemDefinitionRef(it->first, i), false);
+                    g->set_item(ItemDefinitionRef::fromId(moduleId, i), false);
             }
         }
     }
@@ -260,5 +277,9 @@ void Quest::removeItemsOfFamily(gamedata *g, int family)
 
 void Quest::deleteModule(const std::string &moduleName)
 {
+    uint32_t id = internQuestModule(moduleName);
+    if (id < modulesById_.size())
+        modulesById_[id] = NULL;
     questModules_.erase(moduleName);
+    itemFamiliesChanged();
 }
\ No newline at end of file
@@ -22,7 +22,7 @@ public:
      * Replaces the entire table of item definitions in this module with the
      * new table idt. 
      */
-    void setItemDefTable(ItemDefinitionTable &idt) { itemDefTable_ = idt; }
+    void setItemDefTable(ItemDefinitionTable &idt);
 
     /*
      * Retrives the list of item definitions in this module.
@@ -69,6 +69,8 @@ private:
 class Quest
 {
 public:
+    Quest() { itemFamiliesChanged(); }
+
     /* 
      * Retrieves the module in the quest with the given module name. The
      * name must be valid.
@@ -91,7 +93,7 @@ public:
      * instance
      * getItemDefinition(ref)
      * is equivalent to
-     * getModule(ref.module).getItemDefinition(ref.slot)
+     * getModule(ref.moduleName()).getItemDefinition(ref.slot)
      * and the reference must be valid!
      */
     itemdata &getItemDefinition(const ItemDefinitionRef &ref);    
@@ -205,8 +207,39 @@ public:
     */
     void removeItemsOfFamily(gamedata *g, int family);
 
+    /*
+    * gamedata keeps an index of owned items by family and level (see
+    * gamedata::get_family_items). Call this after changing the family or
+    * level of any item definition so that the index is rebuilt; replacing
+    * the item tables or the quest itself does so automatically.
+    */
+    static void itemFamiliesChanged()
+    {
+        if (++itemFamilyEpoch_ == 0)
+            itemFamilyEpoch_ = 1;
+    }
+
+    /*
+    * Counter bumped by itemFamiliesChanged. Never 0.
+    */
+    static uint32_t itemFamilyEpoch() { return itemFamilyEpoch_; }
+
 private:
+    static uint32_t itemFamilyEpoch_;
+
+    // Refs look their module up by id, skipping the map. Entries point into
+    // questModules_ (whose nodes never move) and are NULL for ids with no
+    // module in this quest.
+    QuestModule *moduleById(uint32_t id)
+    {
+        return id < modulesById_.size() ? modulesById_[id] : NULL;
+    }
+
+    Quest(const Quest &);
+    Quest &operator=(const Quest &);
+
     std::map<std::string, QuestModule> questModules_;
+    std::vector<QuestModule *> modulesById_;
 
     SpecialSpriteIndex specialSpriteIndex_;
     SpecialItemIndex specialItemIndex_;
@@ -0,0 +1,50 @@
+#include "../zdefs.h"
+#include "QuestRefs.h"
+#include <vector>
+
+// Names indexed by module id. Built on first use, since refs are also
+// constructed during static initialization.
+static std::vector<std::string> &moduleNames()
+{
+    static std::vector<std::string> names;
+    if (names.empty())
+    {
+        names.push_back("");
+        names.push_back("CORE");
+    }
+    return names;
+}
+
+uint32_t internQuestModule(const char *name)
+{
+    if (!name[0])
+        return QUEST_MODULE_NONE;
+
+    // Quests only ever have a handful of modules, so a linear scan beats a
+    // map here and never allocates for names that are already known.
+    std::vector<std::string> &names = moduleNames();
+    for (uint32_t i = 1; i < names.size(); i++)
+    {
+        if (names[i] == name)
+            return i;
+    }
+
+    names.push_back(name);
+    return (uint32_t)(names.size() - 1);
+}
+
+uint32_t internQuestModule(const std::string &name)
+{
+    return internQuestModule(name.c_str());
+}
+
+const std::string &questModuleName(uint32_t id)
+{
+    std::vector<std::string> &names = moduleNames();
+    if (id >= names.size())
+    {
+        assert(!"Invalid module id");
+        return names[QUEST_MODULE_NONE];
+    }
+    return names[id];
+}
@@ -1,89 +1,144 @@
 #ifndef QUESTREFS_H
 #define QUESTREFS_H
 
+#include <stdint.h>
 #include <string>
 
+/*
+ * Module names are interned to small integer ids the first time they are
+ * seen, so that refs can be copied, compared and looked up without touching
+ * any strings. Id 0 is the empty name (used by invalid refs), and the CORE
+ * module is always id 1.
+ */
+#define QUEST_MODULE_NONE 0
+#define QUEST_MODULE_CORE 1
+
+/*
+ * Returns the id of the module with the given name, interning it if needed.
+ * Not thread-safe for names that haven't been seen yet.
+ */
+uint32_t internQuestModule(const char *name);
+uint32_t internQuestModule(const std::string &name);
+
+/*
+ * Retrieves the name of an interned module id.
+ */
+const std::string &questModuleName(uint32_t id);
+
 struct ItemDefinitionRef
 {
-    ItemDefinitionRef() : module(""), slot(0) {}
-    ItemDefinitionRef(std::string module_, uint32_t slot_) : module(module_), slot(slot_) {}
+    ItemDefinitionRef() : moduleId(QUEST_MODULE_NONE), slot(0) {}
+    ItemDefinitionRef(const char *module_, uint32_t slot_) : moduleId(internQuestModule(module_)), slot(slot_) {}
+    ItemDefinitionRef(const std::string &module_, uint32_t slot_) : moduleId(internQuestModule(module_)), slot(slot_) {}
+
+    // Builds a ref from an already interned module id. A named factory rather
+    // than a constructor, so a literal 0 can't pick the const char * overload.
+    static ItemDefinitionRef fromId(uint32_t moduleId_, uint32_t slot_)
+    {
+        ItemDefinitionRef ref;
+        ref.moduleId = moduleId_;
+        ref.slot = slot_;
+        return ref;
+    }
 
     bool operator<(const ItemDefinitionRef &other) const
     {
-        if (module < other.module)
-            return true;
-        else if (module > other.module)
-            return false;
+        if (moduleId != other.moduleId)
+            return moduleId < other.moduleId;
         return slot < other.slot;
     }
 
     bool operator==(const ItemDefinitionRef &other) const
     {
-        return !(*this < other) && !(other < *this);
+        return moduleId == other.moduleId && slot == other.slot;
     }
 
     bool operator!=(const ItemDefinitionRef &other) const
     {
-        return (*this < other) || (other < *this);
+        return !(*this == other);
     }
 
-    std::string module;
+    const std::string &moduleName() const { return questModuleName(moduleId); }
+
+    uint32_t moduleId;
     uint32_t slot;
 };
 
 struct SpriteDefinitionRef
 {
-    SpriteDefinitionRef() : module(""), slot(0) {}
-    SpriteDefinitionRef(std::string module_, uint32_t slot_) : module(module_), slot(slot_) {}
+    SpriteDefinitionRef() : moduleId(QUEST_MODULE_NONE), slot(0) {}
+    SpriteDefinitionRef(const char *module_, uint32_t slot_) : moduleId(internQuestModule(module_)), slot(slot_) {}
+    SpriteDefinitionRef(const std::string &module_, uint32_t slot_) : moduleId(internQuestModule(module_)), slot(slot_) {}
+
+    // Builds a ref from an already interned module id. A named factory rather
+    // than a constructor, so a literal 0 can't pick the const char * overload.
+    static SpriteDefinitionRef fromId(uint32_t moduleId_, uint32_t slot_)
+    {
+        SpriteDefinitionRef ref;
+        ref.moduleId = moduleId_;
+        ref.slot = slot_;
+        return ref;
+    }
 
     bool operator<(const SpriteDefinitionRef &other) const
     {
-        if (module < other.module)
-            return true;
-        else if (module > other.module)
-            return false;
+        if (moduleId != other.moduleId)
+            return moduleId < other.moduleId;
         return slot < other.slot;
     }
 
     bool operator==(const SpriteDefinitionRef &other) const
     {
-        return !(*this < other) && !(other < *this);
+        return moduleId == other.moduleId && slot == other.slot;
     }
 
     bool operator!=(const SpriteDefinitionRef &other) const
     {
-        return (*this < other) || (other < *this);
+        return !(*this == other);
     }
 
-    std::string module;
+    const std::string &moduleName() const { return questModuleName(moduleId); }
+
+    uint32_t moduleId;
     uint32_t slot;
 };
 
 struct EnemyDefinitionRef
 {
-    EnemyDefinitionRef() : module(""), slot(0) {}
-    EnemyDefinitionRef(std::string module_, uint32_t slot_) : module(module_), slot(slot_) {}
+    EnemyDefinitionRef() : moduleId(QUEST_MODULE_NONE), slot(0) {}
+    EnemyDefinitionRef(const char *module_, uint32_t slot_) : moduleId(internQuestModule(module_)), slot(slot_) {}
+    EnemyDefinitionRef(const std::string &module_, uint32_t slot_) : moduleId(internQuestModule(module_)), slot(slot_) {}
+
+    // Builds a ref from an already interned module id. A named factory rather
+    // than a constructor, so a literal 0 can't pick the const char * overload.
+    static EnemyDefinitionRef fromId(uint32_t moduleId_, uint32_t slot_)
+    {
+        EnemyDefinitionRef ref;
+        ref.moduleId = moduleId_;
+        ref.slot = slot_;
+        return ref;
+    }
 
     bool operator<(const EnemyDefinitionRef &other) const
     {
-        if (module < other.module)
-            return true;
-        else if (module > other.module)
-            return false;
+        if (moduleId != other.moduleId)
+            return moduleId < other.moduleId;
         return slot < other.slot;
     }
 
     bool operator==(const EnemyDefinitionRef &other) const
     {
-        return !(*this < other) && !(other < *this);
+        return moduleId == other.moduleId && slot == other.slot;
     }
 
     bool operator!=(const EnemyDefinitionRef &other) const
     {
-        return (*this < other) || (other < *this);
+        return !(*this == other);
     }
 
-    std::string module;
+    const std::string &moduleName() const { return questModuleName(moduleId); }
+
+    uint32_t moduleId;
     uint32_t slot;
 };
 
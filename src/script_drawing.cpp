@@ -13,6 +13,7 @@
 #include "tiles.h"
 #include "zelda.h"
 #include "ffscript.h"
+#include "profiler.h"
 #include <stdio.h>
 
 #define DegtoFix(d)     ((d)*0.7111111111111)
@@ -35,7 +36,108 @@ fixed radians_to_fixed(T d)
     return ftofix(RadtoFix(d));
 }
 
-BITMAP* ScriptDrawingBitmapPool::_parent_bmp = 0;
+ScriptDrawingBitmapPool::ScriptDrawingBitmapPool()
+{
+    for(int i(0); i < NumSizes; ++i)
+        for(int j(0); j < BitmapsPerSize; ++j)
+        {
+            _slots[i][j].parent = 0;
+            _slots[i][j].view = 0;
+            _slots[i][j].used = false;
+        }
+}
+
+void ScriptDrawingBitmapPool::Dispose()
+{
+    for(int i(0); i < NumSizes; ++i)
+        for(int j(0); j < BitmapsPerSize; ++j)
+        {
+            Slot &s = _slots[i][j];
+            
+            if(s.view)
+                destroy_bitmap(s.view);
+                
+            if(s.parent)
+                destroy_bitmap(s.parent);
+                
+            s.parent = s.view = 0;
+            s.used = false;
+        }
+}
+
+BITMAP* ScriptDrawingBitmapPool::AquireSubBitmap(int w, int h)
+{
+    w = vbound(w, 1, (int)MaxSize);
+    h = vbound(h, 1, (int)MaxSize);
+    
+    for(int i(0); i < NumSizes; ++i)
+    {
+        const int size = MaxSize >> (NumSizes - 1 - i);
+        
+        if(w > size || h > size)
+            continue;
+            
+        for(int j(0); j < BitmapsPerSize; ++j)
+        {
+            Slot &s = _slots[i][j];
+            
+            if(s.used)
+                continue;
+                
+            if(!s.view)
+            {
+                if(!s.parent)
+                    s.parent = create_bitmap_ex(8, size, size);
+                    
+                if(s.parent)
+                    s.view = create_sub_bitmap(s.parent, 0, 0, size, size);
+                    
+                if(!s.view)
+                    continue;
+            }
+            
+            // Shrinking a memory sub-bitmap in place is safe; its line
+            // table still covers the whole parent.
+            s.view->w = w;
+            s.view->h = h;
+            set_clip_rect(s.view, 0, 0, w-1, h-1);
+            clear_bitmap(s.view);
+            
+            s.used = true;
+            return s.view;
+        }
+    }
+    
+    //everything big enough is in use
+    BITMAP *b = create_bitmap_ex(8, w, h);
+    clear_bitmap(b);
+    return b;
+}
+
+void ScriptDrawingBitmapPool::ReleaseSubBitmap(BITMAP* b)
+{
+    if(!b)
+        return;
+        
+    for(int i(0); i < NumSizes; ++i)
+        for(int j(0); j < BitmapsPerSize; ++j)
+        {
+            if(_slots[i][j].view == b)
+            {
+                _slots[i][j].used = false;
+                return;
+            }
+        }
+        
+    destroy_bitmap(b);
+}
+
+void ScriptDrawingBitmapPool::ReleaseAll()
+{
+    for(int i(0); i < NumSizes; ++i)
+        for(int j(0); j < BitmapsPerSize; ++j)
+            _slots[i][j].used = false;
+}
 
 
 
@@ -328,6 +430,7 @@ void do_polygonr(BITMAP *bmp, int *sdci, int xoffset, int yoffset)
 	    BITMAP *subBmp = script_drawing_commands.AquireSubBitmap(256, 256);
 	    polygon(subBmp, vertices, &Points[0], colour);
 	    rotate_sprite(bmp, subBmp, 0, 0, degrees_to_fixed(rot));
+	    script_drawing_commands.ReleaseSubBitmap(subBmp);
     }
     else polygon(bmp, vertices, &Points[0], colour);
     
@@ -922,8 +1025,7 @@ void do_drawtiler(BITMAP *bmp, int *sdci, int xoffset, int yoffset)
             if(canscale) //scale first
             {
                 //damnit all, .. fixme.
-                BITMAP* tempbit = create_bitmap_ex(8, xscale>512?512:xscale, yscale>512?512:yscale);
-                clear_bitmap(tempbit);
+                BITMAP* tempbit = script_drawing_commands.AquireSubBitmap(xscale, yscale);
                 
                 stretch_sprite(tempbit, pbitty, 0, 0, xscale, yscale);
                 
@@ -938,7 +1040,7 @@ void do_drawtiler(BITMAP *bmp, int *sdci, int xoffset, int yoffset)
                     rotate_sprite(bmp, tempbit, x1+xoffset, y1+yoffset, degrees_to_fixed(rotation));
                 }
                 
-                destroy_bitmap(tempbit);
+                script_drawing_commands.ReleaseSubBitmap(tempbit);
             }
             else //no scale
             {
@@ -1091,8 +1193,7 @@ void do_drawcombor(BITMAP *bmp, int *sdci, int xoffset, int yoffset)
             
             if(canscale) //scale first
             {
-                BITMAP* tempbit = create_bitmap_ex(8, xscale>512?512:xscale, yscale>512?512:yscale);
-                clear_bitmap(tempbit);
+                BITMAP* tempbit = script_drawing_commands.AquireSubBitmap(xscale, yscale);
                 
                 stretch_sprite(tempbit, pbitty, 0, 0, xscale, yscale);
                 
@@ -1107,7 +1208,7 @@ void do_drawcombor(BITMAP *bmp, int *sdci, int xoffset, int yoffset)
                     rotate_sprite(bmp, tempbit, x1+xoffset, y1+yoffset, degrees_to_fixed(rotation));
                 }
                 
-                destroy_bitmap(tempbit);
+                script_drawing_commands.ReleaseSubBitmap(tempbit);
             }
             else //no scale
             {
@@ -1240,6 +1341,7 @@ void do_drawcharr(BITMAP *bmp, int *sdci, int xoffset, int yoffset)
     if(w>0&&h>0)//stretch the character
     {
         BITMAP *pbmp = script_drawing_commands.GetSmallTextureBitmap(1,1);
+        clear_bitmap(pbmp);
         
         if(opacity < 128)
         {
@@ -1273,13 +1375,12 @@ void do_drawcharr(BITMAP *bmp, int *sdci, int xoffset, int yoffset)
     {
         if(opacity < 128)
         {
-            BITMAP *pbmp = create_sub_bitmap(prim_bmp,0,0,16,16);
-            clear_bitmap(pbmp);
+            BITMAP *pbmp = script_drawing_commands.AquireSubBitmap(16,16);
             
             textprintf_ex(pbmp, get_zc_font(font_index), 0, 0, color, bg_color, "%c", glyph);
             draw_trans_sprite(bmp, pbmp, x+xoffset, y+yoffset);
             
-            destroy_bitmap(pbmp);
+            script_drawing_commands.ReleaseSubBitmap(pbmp);
         }
         else // no opacity
         {
@@ -1351,8 +1452,7 @@ void do_drawintr(BITMAP *bmp, int *sdci, int xoffset, int yoffset)
     
     if(w>0&&h>0)//stretch
     {
-        BITMAP *pbmp = create_sub_bitmap(prim_bmp, 0, 0, text_length(get_zc_font(font_index), numbuf)+1, text_height(get_zc_font(font_index)));
-        clear_bitmap(pbmp);
+        BITMAP *pbmp = script_drawing_commands.AquireSubBitmap(text_length(get_zc_font(font_index), numbuf)+1, text_height(get_zc_font(font_index)));
 	    //script_drawing_commands.GetSmallTextureBitmap(1,1);
         
         if(opacity < 128)
@@ -1367,14 +1467,13 @@ void do_drawintr(BITMAP *bmp, int *sdci, int xoffset, int yoffset)
             }
             else
             {
-                BITMAP *pbmp2 = create_sub_bitmap(prim_bmp,0,0,w,h);
-                clear_bitmap(pbmp2);
+                BITMAP *pbmp2 = script_drawing_commands.AquireSubBitmap(w,h);
                 
                 textout_ex(pbmp, get_zc_font(font_index), numbuf, 0, 0, color, bg_color);
                 stretch_sprite(pbmp2, pbmp, 0, 0, w, h);
                 draw_trans_sprite(bmp, pbmp2, x+xoffset, y+yoffset);
                 
-                destroy_bitmap(pbmp2);
+                script_drawing_commands.ReleaseSubBitmap(pbmp2);
             }
         }
         else // no opacity
@@ -1383,19 +1482,19 @@ void do_drawintr(BITMAP *bmp, int *sdci, int xoffset, int yoffset)
             stretch_sprite(bmp, pbmp, x+xoffset, y+yoffset, w, h);
         }
         
+        script_drawing_commands.ReleaseSubBitmap(pbmp);
     }
     else //no stretch
     {
         if(opacity < 128)
         {
             FONT* font = get_zc_font(font_index);
-            BITMAP *pbmp = create_sub_bitmap(prim_bmp, 0, 0, text_length(font, numbuf), text_height(font));
-            clear_bitmap(pbmp);
+            BITMAP *pbmp = script_drawing_commands.AquireSubBitmap(text_length(font, numbuf), text_height(font));
             
             textout_ex(pbmp, font, numbuf, 0, 0, color, bg_color);
             draw_trans_sprite(bmp, pbmp, x+xoffset, y+yoffset);
             
-            destroy_bitmap(pbmp);
+            script_drawing_commands.ReleaseSubBitmap(pbmp);
         }
         else // no opacity
         {
@@ -1417,7 +1516,7 @@ void do_drawstringr(BITMAP *bmp, int i, int *sdci, int xoffset, int yoffset)
     //sdci[8]=string
     //sdci[9]=opacity
     
-    char* str = (char*)script_drawing_commands[i].GetDrawBufferPtr();
+    char* str = (char*)script_drawing_commands.GetDrawBufferPtr(i);
     
     if(!str)
     {
@@ -1440,15 +1539,14 @@ void do_drawstringr(BITMAP *bmp, int i, int *sdci, int xoffset, int yoffset)
     if(opacity < 128)
     {
         int width=zc_min(text_length(font, str), 512);
-        BITMAP *pbmp = create_sub_bitmap(prim_bmp, 0, 0, width, text_height(font));
-        clear_bitmap(pbmp);
+        BITMAP *pbmp = script_drawing_commands.AquireSubBitmap(width, text_height(font));
         textout_ex(pbmp, font, str, 0, 0, color, bg_color);
         if(format_type == 2)   // right-sided text
             x-=width;
         else if(format_type == 1)   // centered text
             x-=width/2;
         draw_trans_sprite(bmp, pbmp, x+xoffset, y+yoffset);
-        destroy_bitmap(pbmp);
+        script_drawing_commands.ReleaseSubBitmap(pbmp);
     }
     else // no opacity
     {
@@ -1466,7 +1564,7 @@ void do_drawstringr(BITMAP *bmp, int i, int *sdci, int xoffset, int yoffset)
         }
     }
 
-	script_drawing_commands[i].DeallocateDrawBuffer();
+	script_drawing_commands.DeallocateDrawBuffer(i);
 }
 
 
@@ -1532,15 +1630,23 @@ void do_drawquadr(BITMAP *bmp, int *sdci, int xoffset, int yoffset)
     int tex_width = w*16;
     int tex_height = h*16;
     
-    bool mustDestroyBmp = false;
+    bool mustReleaseBmp = false;
     BITMAP *tex = script_drawing_commands.GetSmallTextureBitmap(w,h);
     
     if(!tex)
     {
-        mustDestroyBmp = true;
-        tex = create_bitmap_ex(8, tex_width, tex_height);
-        clear_bitmap(tex);
+        mustReleaseBmp = true;
+        
+        if(tex_width <= ScriptDrawingBitmapPool::MaxSize && tex_height <= ScriptDrawingBitmapPool::MaxSize)
+            tex = script_drawing_commands.AquireSubBitmap(tex_width, tex_height);
+        else
+        {
+            tex = create_bitmap_ex(8, tex_width, tex_height);
+            clear_bitmap(tex);
+        }
     }
+    else if(tile > 0)
+        clear_bitmap(tex); //tiles are overlaid, combos cover it
     
     int col[4];
     /*
@@ -1576,8 +1682,8 @@ void do_drawquadr(BITMAP *bmp, int *sdci, int xoffset, int yoffset)
     
     quad3d_f(bmp, polytype, tex, &V1, &V2, &V3, &V4);
     
-    if(mustDestroyBmp)
-        destroy_bitmap(tex);
+    if(mustReleaseBmp)
+        script_drawing_commands.ReleaseSubBitmap(tex);
         
 }
 
@@ -1618,15 +1724,23 @@ void do_drawtriangler(BITMAP *bmp, int *sdci, int xoffset, int yoffset)
     int tex_width = w*16;
     int tex_height = h*16;
     
-    bool mustDestroyBmp = false;
+    bool mustReleaseBmp = false;
     BITMAP *tex = script_drawing_commands.GetSmallTextureBitmap(w,h);
     
     if(!tex)
     {
-        mustDestroyBmp = true;
-        tex = create_bitmap_ex(8, tex_width, tex_height);
-        clear_bitmap(tex);
+        mustReleaseBmp = true;
+        
+        if(tex_width <= ScriptDrawingBitmapPool::MaxSize && tex_height <= ScriptDrawingBitmapPool::MaxSize)
+            tex = script_drawing_commands.AquireSubBitmap(tex_width, tex_height);
+        else
+        {
+            tex = create_bitmap_ex(8, tex_width, tex_height);
+            clear_bitmap(tex);
+        }
     }
+    else if(tile > 0)
+        clear_bitmap(tex); //tiles are overlaid, combos cover it
     
     int col[3];
     /*
@@ -1661,8 +1775,8 @@ void do_drawtriangler(BITMAP *bmp, int *sdci, int xoffset, int yoffset)
     
     triangle3d_f(bmp, polytype, tex, &V1, &V2, &V3);
     
-    if(mustDestroyBmp)
-        destroy_bitmap(tex);
+    if(mustReleaseBmp)
+        script_drawing_commands.ReleaseSubBitmap(tex);
 }
 
 
@@ -3003,7 +3117,7 @@ void do_drawquad3dr(BITMAP *bmp, int i, int *sdci, int xoffset, int yoffset)
     //sdci[7]=tile/combo
     //sdci[8]=polytype
     
-    long* ptr = (long*)script_drawing_commands[i].GetDrawBufferPtr();
+    long* ptr = (long*)script_drawing_commands.GetDrawBufferPtr(i);
     
     if(!ptr)
     {
@@ -3029,15 +3143,23 @@ void do_drawquad3dr(BITMAP *bmp, int i, int *sdci, int xoffset, int yoffset)
     int tex_width = w*16;
     int tex_height = h*16;
     
-    bool mustDestroyBmp = false;
+    bool mustReleaseBmp = false;
     BITMAP *tex = script_drawing_commands.GetSmallTextureBitmap(w,h);
     
     if(!tex)
     {
-        mustDestroyBmp = true;
-        tex = create_bitmap_ex(8, tex_width, tex_height);
-        clear_bitmap(tex);
+        mustReleaseBmp = true;
+        
+        if(tex_width <= ScriptDrawingBitmapPool::MaxSize && tex_height <= ScriptDrawingBitmapPool::MaxSize)
+            tex = script_drawing_commands.AquireSubBitmap(tex_width, tex_height);
+        else
+        {
+            tex = create_bitmap_ex(8, tex_width, tex_height);
+            clear_bitmap(tex);
+        }
     }
+    else if(tile > 0)
+        clear_bitmap(tex); //tiles are overlaid, combos cover it
     
     if(tile > 0)   // TILE
     {
@@ -3059,10 +3181,10 @@ void do_drawquad3dr(BITMAP *bmp, int i, int *sdci, int xoffset, int yoffset)
     
     quad3d_f(bmp, polytype, tex, &V1, &V2, &V3, &V4);
     
-    if(mustDestroyBmp)
-        destroy_bitmap(tex);
+    if(mustReleaseBmp)
+        script_drawing_commands.ReleaseSubBitmap(tex);
         
-	script_drawing_commands[i].DeallocateDrawBuffer();
+	script_drawing_commands.DeallocateDrawBuffer(i);
 }
 
 
@@ -3078,7 +3200,7 @@ void do_drawtriangle3dr(BITMAP *bmp, int i, int *sdci, int xoffset, int yoffset)
     //sdci[7]=tile/combo
     //sdci[8]=polytype
     
-    long* v = (long*)script_drawing_commands[i].GetDrawBufferPtr();
+    long* v = (long*)script_drawing_commands.GetDrawBufferPtr(i);
     
     if(!v)
     {
@@ -3104,15 +3226,23 @@ void do_drawtriangle3dr(BITMAP *bmp, int i, int *sdci, int xoffset, int yoffset)
     int tex_width = w*16;
     int tex_height = h*16;
     
-    bool mustDestroyBmp = false;
+    bool mustReleaseBmp = false;
     BITMAP *tex = script_drawing_commands.GetSmallTextureBitmap(w,h);
     
     if(!tex)
     {
-        mustDestroyBmp = true;
-        tex = create_bitmap_ex(8, tex_width, tex_height);
-        clear_bitmap(tex);
+        mustReleaseBmp = true;
+        
+        if(tex_width <= ScriptDrawingBitmapPool::MaxSize && tex_height <= ScriptDrawingBitmapPool::MaxSize)
+            tex = script_drawing_commands.AquireSubBitmap(tex_width, tex_height);
+        else
+        {
+            tex = create_bitmap_ex(8, tex_width, tex_height);
+            clear_bitmap(tex);
+        }
     }
+    else if(tile > 0)
+        clear_bitmap(tex); //tiles are overlaid, combos cover it
     
     if(tile > 0)   // TILE
     {
@@ -3133,10 +3263,10 @@ void do_drawtriangle3dr(BITMAP *bmp, int i, int *sdci, int xoffset, int yoffset)
     
     triangle3d_f(bmp, polytype, tex, &V1, &V2, &V3);
     
-    if(mustDestroyBmp)
-        destroy_bitmap(tex);
+    if(mustReleaseBmp)
+        script_drawing_commands.ReleaseSubBitmap(tex);
     
-	script_drawing_commands[i].DeallocateDrawBuffer();
+	script_drawing_commands.DeallocateDrawBuffer(i);
 }
 
 //
@@ -3437,43 +3567,41 @@ void do_drawscreenr(BITMAP *bmp, int *sdci, int xoffset, int yoffset, bool isOff
 
 void do_primitives(BITMAP *targetBitmap, int type, mapscr *, int xoff, int yoff)
 {
+    ProfileScope prof(PROF_PRIMITIVES);
+    
     color_map = &trans_table2;
     
     //was this next variable ever used? -- DN
     //bool drawsubscr=false;
     
-    if(type > 7)
+    if(type < 0 || type > 7)
         return;
         
-    //--script_drawing_commands[][] reference--
-    //[][0]: type
-    //[][1-16]: defined by type
-    //[][17]: unused
-    //[][18]: rendertarget
-    //[][19]: unused
+    //--script_drawing_commands[] reference--
+    //[0]: type
+    //[1]: layer
+    //[2-16]: defined by type
     
     // Trying to match the old behavior exactly...
     const bool brokenOffset=get_bit(extra_rules, er_BITMAPOFFSET)!=0;
     
     bool isTargetOffScreenBmp = false;
-    const int type_mul_10000 = type * 10000;
-    const int numDrawCommandsToProcess = script_drawing_commands.Count();
+    const std::vector<int>& layerCommands = script_drawing_commands.GetLayer(type);
+    const int numDrawCommandsToProcess = (int)layerCommands.size();
     int xoffset=xoff, yoffset=yoff;
     
-    for(int i(0); i < numDrawCommandsToProcess; ++i)
+    for(int n(0); n < numDrawCommandsToProcess; ++n)
     {
         if(!brokenOffset)
         {
             xoffset = 0;
             yoffset = 0;
         }
-        int *sdci = &script_drawing_commands[i][0];
+        const int i = layerCommands[n];
+        int *sdci = script_drawing_commands[i];
         
-        if(sdci[1] != type_mul_10000)
-            continue;
-            
         // get the correct render target, if set.
-        BITMAP *bmp = zscriptDrawingRenderTarget->GetTargetBitmap(sdci[18]);
+        BITMAP *bmp = zscriptDrawingRenderTarget->GetTargetBitmap(script_drawing_commands.GetRenderTarget(i));
         
         if(!bmp)
         {
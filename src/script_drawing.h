@@ -9,7 +9,6 @@
 
 #define MAX_SCRIPT_DRAWING_COMMANDS 10000
 //Increased to 10,000 draws. -Z
-#define SCRIPT_DRAWING_COMMAND_VARIABLES 20
 
 
 
@@ -77,9 +76,7 @@ public:
             if(bh == 8) ret = _bmp[x][3];
         }
         
-        if(ret)
-            clear_bitmap(ret);
-            
+        //not cleared; callers that overlay onto it must clear it first.
         return ret;
     }
     
@@ -89,99 +86,45 @@ protected:
 };
 
 
-//simple class that manages allegro bitmaps for script drawing
+//scratch bitmaps for script drawing, kept from frame to frame
 class ScriptDrawingBitmapPool
 {
 public:
-    ScriptDrawingBitmapPool()
-    {
-    }
+    // Bitmaps of 64, 128, 256 and 512 pixels square, a few of each.
+    enum { NumSizes = 4, BitmapsPerSize = 4, MaxSize = 512 };
     
-    void Dispose()
-    {
-        if(_parent_bmp)
-            destroy_bitmap(_parent_bmp), _parent_bmp = 0;
-    }
+    ScriptDrawingBitmapPool();
     
-    inline BITMAP* AquireSubBitmap(int w, int h)
-    {
-        return AquireSubBitmap(0, 0, w, h);
-    }
-
-    inline BITMAP* AquireSubBitmap(int x, int y, int w, int h)
-    {
-        //todo: can currently only partition out one bitmap at a time.
-        if(!_parent_bmp)
-            _parent_bmp  = create_bitmap_ex(8,512,512);
-            
-        BITMAP* bmp = _parent_bmp;
-        
-        if(w <= 512 && h <= 512)
-            bmp = create_sub_bitmap(_parent_bmp, x, y, w, h);
-            
-        clear_bitmap(bmp);
-        
-        return bmp;
-    }
+    void Dispose();
     
-    inline void ReleaseSubBitmap(BITMAP* b)
-    {
-        if(is_sub_bitmap(b) || b != _parent_bmp)
-            destroy_bitmap(b);
-    }
+    // Returns a cleared w x h bitmap, clamped to MaxSize. Any number can be
+    // held at once; each must be given back with ReleaseSubBitmap().
+    BITMAP* AquireSubBitmap(int w, int h);
+    void ReleaseSubBitmap(BITMAP* b);
     
+    // Takes back every pooled bitmap that's still held.
+    void ReleaseAll();
     
 protected:
-    static BITMAP *_parent_bmp;
-    //static int _rc = 0;
+    struct Slot
+    {
+        BITMAP *parent;
+        BITMAP *view; //sub-bitmap of parent, resized to each request
+        bool used;
+    };
+    
+    Slot _slots[NumSizes][BitmapsPerSize];
 };
 
 
 
-class CScriptDrawingCommandVars
+// One queued drawing command. Its type and arguments are stored in
+// CScriptDrawingCommands' argument arena, laid out as sdci[0..numargs].
+struct CScriptDrawingCommand
 {
-public:
-    CScriptDrawingCommandVars()
-    {
-        this->Clear();
-    }
-    
-    void Clear()
-    {
-        memset((void*)this, 0, sizeof(CScriptDrawingCommandVars));
-    }
-
-	// Shouldn't be needed, but a simple stack allocator would get rid of
-	// memory allocations here. It would be more worthwhile to give a frame allocator
-	// to everything in zc anyway, rather than just script drawing, but meh.
-	long* AllocateDrawBuffer(unsigned nBytes)
-	{
-		assert(ptr == NULL);
-
-		ptr = zc_malloc(nBytes);
-		return (long*)ptr;
-	}
-
-	void DeallocateDrawBuffer()
-	{
-		if(ptr)
-		{
-			zc_free(ptr);
-			ptr = NULL;
-		}
-	}
-
-	void* GetDrawBufferPtr()
-    {
-        return ptr;
-    }
-    
-	int &operator [](const int i) { return data[i]; }
-    const int &operator [](const int i) const { return data[i]; }
-    
-protected:
-    int data[SCRIPT_DRAWING_COMMAND_VARIABLES];
-    void* ptr; //will be changed later
+    int offset; //start of sdci[] in the arena
+    int target; //render target the command was issued to
+    void* ptr;  //extra data for quads, triangles and strings
 };
 
 
@@ -190,14 +133,17 @@ class CScriptDrawingCommands
 {
 public:
     
+    enum { MaxLayers = 8 };
+    
     // Unlikely people will be using all 1000 commands.
     const static int DefaultCapacity = 256; //176 + some extra
     
-    CScriptDrawingCommands() : commands(), count(0) {}
+    CScriptDrawingCommands() : commands(), args() {}
     ~CScriptDrawingCommands() {}
     
     void Dispose()
     {
+        Clear();
         bitmap_pool.Dispose();
         small_tex_cache.Dispose();
     }
@@ -217,57 +163,119 @@ public:
         if(commands.empty())
             return;
             
-        //only clear what was used.
-        memset((void*)&commands[0], 0, count * sizeof(CScriptDrawingCommandVars));
-        count = 0;
+        // Commands on layers that were never drawn still own their buffers.
+        for(size_t i = 0; i < commands.size(); ++i)
+            if(commands[i].ptr)
+                zc_free(commands[i].ptr);
+                
+        //clear() keeps the capacity for the next frame.
+        commands.clear();
+        args.clear();
         
-        //draw_container.Clear();
+        for(int i = 0; i < MaxLayers; ++i)
+            layers[i].clear();
+            
+        bitmap_pool.ReleaseAll();
     }
     
     int Count() const
     {
-        return count;
+        return (int)commands.size();
     }
-
-    int GetNext()
+    
+    // Reserves a command with room for sdci[0..numargs], all zeroed except
+    // sdci[0] = type. It isn't drawn until it's passed to Submit().
+    int GetNext(int type, int numargs, int target)
     {
-        if(count>=MAX_SCRIPT_DRAWING_COMMANDS)
+        if(Count() >= MAX_SCRIPT_DRAWING_COMMANDS)
             return -1;
-        
-        const int next_index = count;
-        const int capacity = commands.capacity();
-        
-        if(++count > capacity)
+            
+        if(commands.capacity() == 0)
         {
-            if(commands.empty())
-            {
-                //first use
-                commands.resize(DefaultCapacity);
-            }
-            else
-            {
-                //might as well just max it out
-                commands.resize(MAX_SCRIPT_DRAWING_COMMANDS);
-            }
+            //first use
+            commands.reserve(DefaultCapacity);
+            args.reserve(DefaultCapacity * 8);
         }
         
-        return next_index;
+        CScriptDrawingCommand c;
+        c.offset = (int)args.size();
+        c.target = target;
+        c.ptr = NULL;
+        
+        args.resize(args.size() + numargs + 1, 0);
+        args[c.offset] = type;
+        commands.push_back(c);
+        
+        return Count() - 1;
     }
-
-	void AbortDrawingCommand()
-	{
-		ASSERT(count != 0);
-		if(count > 0)
-			--count;
-	}
-    
-    CScriptDrawingCommandVars& operator [](const int i)
+    
+    // Files the command under the layer in sdci[1]. Commands for layers
+    // that are never drawn are kept only so Clear() can free them.
+    void Submit(int i)
     {
-        return commands[i];
+        const int layer = args[commands[i].offset + 1];
+        
+        if(layer % 10000 == 0 && layer >= 0 && layer < MaxLayers * 10000)
+            layers[layer / 10000].push_back(i);
+    }
+    
+    // Drops the most recent command; it must not have been submitted.
+    void AbortDrawingCommand()
+    {
+        ASSERT(!commands.empty());
+        
+        if(commands.empty())
+            return;
+            
+        DeallocateDrawBuffer(Count() - 1);
+        args.resize(commands.back().offset);
+        commands.pop_back();
     }
-    const CScriptDrawingCommandVars& operator [](const int i) const
+    
+    // Submitted commands for one layer, in the order they were issued.
+    const std::vector<int>& GetLayer(int layer) const
+    {
+        return layers[layer];
+    }
+    
+    int GetRenderTarget(int i) const
+    {
+        return commands[i].target;
+    }
+    
+    // sdci[] for command i. Only valid until the next GetNext().
+    int* operator [](const int i)
+    {
+        return &args[commands[i].offset];
+    }
+    const int* operator [](const int i) const
+    {
+        return &args[commands[i].offset];
+    }
+    
+    // Shouldn't be needed, but a simple stack allocator would get rid of
+    // memory allocations here. It would be more worthwhile to give a frame allocator
+    // to everything in zc anyway, rather than just script drawing, but meh.
+    long* AllocateDrawBuffer(int i, unsigned nBytes)
+    {
+        assert(commands[i].ptr == NULL);
+        
+        commands[i].ptr = zc_malloc(nBytes);
+        return (long*)commands[i].ptr;
+    }
+    
+    void DeallocateDrawBuffer(int i)
+    {
+        if(commands[i].ptr)
+        {
+            zc_free(commands[i].ptr);
+            commands[i].ptr = NULL;
+        }
+    }
+    
+    void* GetDrawBufferPtr(int i)
     {
-        return commands[i];
+        return commands[i].ptr;
     }
     
     inline BITMAP* AquireSubBitmap(int w, int h)
@@ -287,8 +295,9 @@ public:
     
     
 protected:
-	std::vector<CScriptDrawingCommandVars> commands;
-    int count;
+    std::vector<CScriptDrawingCommand> commands;
+    std::vector<int> args;
+    std::vector<int> layers[MaxLayers];
     
     //DrawingContainer draw_container;
     ScriptDrawingBitmapPool bitmap_pool;
@@ -1,33 +1,85 @@
 #include "ObjectPool.h"
 #include <cassert>
+#include <typeinfo>
 
 //using namespace std;
 
-ObjectPool::ObjectPool() : nextuid_(0)
+ObjectPool::ObjectPool() : freeHead_(-1), freeTail_(-1), live_(0)
 {	
 }
 
 int ObjectPool::addToPool(GameObject *obj)
 {
-	int uid = nextuid_++;
-	if (nextuid_ == 0)
+	int slot;
+	if (freeHead_ != -1)
 	{
-		assert(!"Ran out of UIDs");
+		slot = freeHead_;
+		freeHead_ = slots_[slot].nextFree;
+		if (freeHead_ == -1)
+			freeTail_ = -1;
 	}
-	pool_[uid] = obj;
-	return uid;
+	else
+	{
+		slot = (int)slots_.size();
+		if (slot > SLOT_MASK)
+		{
+			assert(!"Ran out of UIDs");
+		}
+		Slot s;
+		s.generation = 0;
+		slots_.push_back(s);
+	}
+
+	Slot &s = slots_[slot];
+	s.obj = obj;
+	s.nextFree = -1;
+	live_++;
+	return (s.generation << SLOT_BITS) | slot;
 }
 
 void ObjectPool::removeFromPool(int uid)
 {
-	std::map<int, GameObject *>::iterator it = pool_.find(uid);
-	if (it != pool_.end())
-		pool_.erase(it);
+	if (!getFromUID(uid))
+		return;
+
+	int slot = uid & SLOT_MASK;
+	Slot &s = slots_[slot];
+	s.obj = NULL;
+	s.generation = (s.generation + 1) & GENERATION_MASK;
+	s.nextFree = -1;
+
+	if (freeTail_ == -1)
+		freeHead_ = slot;
+	else
+		slots_[freeTail_].nextFree = slot;
+	freeTail_ = slot;
+	live_--;
 }
 
 GameObject *ObjectPool::getFromUID(int uid)
 {
-	return pool_[uid];
+	if (uid < 0)
+		return NULL;
+
+	unsigned int slot = uid & SLOT_MASK;
+	if (slot >= slots_.size())
+		return NULL;
+
+	const Slot &s = slots_[slot];
+	if (s.generation != (uid >> SLOT_BITS))
+		return NULL;
+
+	return s.obj;
+}
+
+void ObjectPool::getLiveCounts(std::map<std::string, int> &counts) const
+{
+	counts.clear();
+	for (std::vector<Slot>::const_iterator it = slots_.begin(); it != slots_.end(); ++it)
+	{
+		if (it->obj)
+			counts[typeid(*it->obj).name()]++;
+	}
 }
 
 
@@ -45,4 +97,4 @@ GameObject::GameObject(const GameObject &other) : pool_(other.pool_)
 GameObject::~GameObject()
 {
 	pool_.removeFromPool(uid_);
-}
\ No newline at end of file
+}
@@ -1,11 +1,18 @@
 #ifndef OBJECTPOOL_H
 #define OBJECTPOOL_H
 
-#include <list>
 #include <map>
+#include <string>
+#include <vector>
 
 class GameObject;
 
+// Hands out UIDs for game objects and maps them back to the objects.
+// Objects live in a slot map: the low bits of a UID are the slot index and the
+// high bits are the slot's generation, which is bumped every time the slot is
+// freed. A UID kept after its object is destroyed resolves to NULL, even once
+// the slot has been reused. Freed slots are reused oldest first, to make it as
+// long as possible before a generation comes around again.
 class ObjectPool
 {
 public:
@@ -13,11 +20,32 @@ public:
 	int addToPool(GameObject *obj);
 	void removeFromPool(int uid);
 
+	// Returns NULL if uid doesn't refer to a live object
 	GameObject *getFromUID(int uid);
+
+	int liveCount() const { return live_; }
+	// Counts live objects by their dynamic type name, for diagnostics
+	void getLiveCounts(std::map<std::string, int> &counts) const;
 	
 private:
-	int nextuid_;
-	std::map<int, GameObject *> pool_;
+	enum
+	{
+		SLOT_BITS = 18,
+		SLOT_MASK = (1 << SLOT_BITS) - 1,
+		GENERATION_MASK = (1 << (31 - SLOT_BITS)) - 1
+	};
+
+	struct Slot
+	{
+		GameObject *obj;
+		int generation;
+		int nextFree;
+	};
+
+	std::vector<Slot> slots_;
+	int freeHead_;
+	int freeTail_;
+	int live_;
 };
 
 class GameObject
@@ -39,4 +67,4 @@ private:
 };
 
 
-#endif
\ No newline at end of file
+#endif
@@ -10,9 +10,22 @@ struct zasm
 	int32_t arg2;
 };
 
+// Pre-decoded form of a zasm instruction, built by the interpreter the first
+// time a script runs. op selects a specialized handler for instructions whose
+// register operands are plain D/A registers or SP (0 = generic path), and
+// kinds holds the classified operand kinds, arg1 in the low nibble.
+struct zasm_decoded
+{
+	uint16_t command;
+	uint8_t op;
+	uint8_t kinds;
+	int32_t arg1;
+	int32_t arg2;
+};
+
 struct ZAsmScript
 {
-	ZAsmScript() : version(ZASM_VERSION), type(SCRIPT_NONE)
+	ZAsmScript() : version(ZASM_VERSION), type(SCRIPT_NONE), decoded(NULL)
 	{
 		name_len = 21;
 		name = new char[21];
@@ -26,6 +39,14 @@ struct ZAsmScript
 	{
 		delete[] name;
 		delete[] commands;
+		delete[] decoded;
+	}
+
+	// Must be called whenever commands is changed after the script has run
+	void clearDecoded()
+	{
+		delete[] decoded;
+		decoded = NULL;
 	}
 
 	ZAsmScript &operator=(const ZAsmScript &other)
@@ -41,11 +62,12 @@ struct ZAsmScript
 		commands = new zasm[commands_len];
 		for (int i = 0; i < commands_len; i++)
 			commands[i] = other.commands[i];
+		clearDecoded();
 
 		return *this;
 	}
 
-	ZAsmScript(const ZAsmScript &other)
+	ZAsmScript(const ZAsmScript &other) : decoded(NULL)
 	{
 		version = other.version;
 		type = other.type;
@@ -73,6 +95,9 @@ struct ZAsmScript
 	int32_t commands_len;
 	zasm *commands;
 
+	// Interpreter's decoded copy of commands, or NULL if not built yet
+	zasm_decoded *decoded;
+
 };
 
 
@@ -355,7 +355,7 @@ ItemDefinitionRef select_item(const char *prompt, const ItemDefinitionRef &item,
 
     for (int j = 0; j < (int)modules_list.size(); j++)
     {
-        if (modules_list[j].s == item.module)
+        if (modules_list[j].s == item.moduleName())
         {
             modindex = j;
         }
@@ -616,7 +616,7 @@ SpriteDefinitionRef select_sprite(const char *prompt, const SpriteDefinitionRef
 
     for (int j = 0; j < (int)modules_list.size(); j++)
     {
-        if (modules_list[j].s == selectedSprite.module)
+        if (modules_list[j].s == selectedSprite.moduleName())
         {
             modindex = j;
         }
@@ -918,7 +918,7 @@ EnemyDefinitionRef select_enemy(const char *prompt, const EnemyDefinitionRef &se
 
     for (int j = 0; j < (int)modules_list.size(); j++)
     {
-        if (modules_list[j].s == selectedEnemy.module)
+        if (modules_list[j].s == selectedEnemy.moduleName())
         {
             modindex = j;
         }
@@ -21,7 +21,9 @@
 #include "zdefs.h"
 #include "sprite.h"
 #include "tiles.h"
+#include "zsys.h"
 #include "quest/Quest.h"
+#include <algorithm>
 
 extern Quest *curQuest;
 extern bool get_debug();
@@ -694,14 +696,55 @@ void sprite::drawshadow(BITMAP* dest,bool translucent)
 /********** Sprite List ***********/
 /**********************************/
 
-#define SLMAX 255
-
 //class enemy;
 
-sprite_list::sprite_list() : count(0) {}
+int sprite_list::limit = SLMAX;
+
+sprite_list::sprite_list() : count(0), gappos(0), gaplen(0) {}
+
+int sprite_list::Limit()
+{
+    return limit;
+}
+
+void sprite_list::setLimit(int l)
+{
+    limit = zc_max(l, 1);
+}
+
+void sprite_list::movegap(int pos)
+{
+    if(gaplen==0)
+    {
+        gappos=pos;
+        return;
+    }
+    
+    while(gappos<pos)
+    {
+        sprites[gappos]=sprites[gappos+gaplen];
+        ++gappos;
+    }
+    
+    while(gappos>pos)
+    {
+        --gappos;
+        sprites[gappos+gaplen]=sprites[gappos];
+    }
+}
+
+void sprite_list::compact()
+{
+    movegap(count);
+    sprites.resize(count);
+    gaplen=0;
+}
+
 void sprite_list::clear()
 {
     while(count>0) del(0);
+    
+    compact();
 }
 
 sprite *sprite_list::spr(int index)
@@ -709,7 +752,7 @@ sprite *sprite_list::spr(int index)
     if(index<0 || index>=count)
         return NULL;
         
-    return sprites[index];
+    return at(index);
 }
 
 bool sprite_list::swap(int a,int b)
@@ -717,22 +760,23 @@ bool sprite_list::swap(int a,int b)
     if(a<0 || a>=count || b<0 || b>=count)
         return false;
         
-    sprite *c = sprites[a];
-    sprites[a] = sprites[b];
-    sprites[b] = c;    
+    sprite *c = at(a);
+    at(a) = at(b);
+    at(b) = c;    
 // checkConsistency();
     return true;
 }
 
 bool sprite_list::add(sprite *s)
 {
-    if(count>=SLMAX)
+    if(count>=limit)
     {
         delete s;
         return false;
     }
     
-    sprites[count++]=s;
+    sprites.push_back(s);
+    ++count;
     //checkConsistency();
     return true;
 }
@@ -743,18 +787,15 @@ bool sprite_list::remove(sprite *s)
     int j=0;
     
     for(; j<count; j++)
-        if(sprites[j] == s)
+        if(at(j) == s)
             goto gotit;
             
     return false;
     
 gotit:
 
-    for(int i=j; i<count-1; i++)
-    {
-        sprites[i]=sprites[i+1];
-    }
-    
+    movegap(j);
+    ++gaplen;
     --count;
     //checkConsistency();
     return true;
@@ -767,7 +808,7 @@ fix sprite_list::getX(int j)
         return (fix)1000000;
     }
     
-    return sprites[j]->x;
+    return at(j)->x;
 }
 
 fix sprite_list::getY(int j)
@@ -777,7 +818,7 @@ fix sprite_list::getY(int j)
         return (fix)1000000;
     }
     
-    return sprites[j]->y;
+    return at(j)->y;
 }
 
 int sprite_list::getMisc(int j)
@@ -787,7 +828,7 @@ int sprite_list::getMisc(int j)
         return -1;
     }
     
-    return sprites[j]->misc;
+    return at(j)->misc;
 }
 
 bool sprite_list::del(int j)
@@ -795,13 +836,9 @@ bool sprite_list::del(int j)
     if(j<0||j>=count)
         return false;
         
-    delete sprites[j];
-    
-    for(int i=j; i<count-1; i++)
-    {
-        sprites[i]=sprites[i+1];
-    }
-    
+    movegap(j);
+    delete sprites[j+gaplen];
+    ++gaplen;
     --count;
     //checkConsistency();
     return true;
@@ -814,7 +851,7 @@ void sprite_list::draw(BITMAP* dest,bool lowfirst)
     case true:
         for(int i=0; i<count; i++)
         {
-            sprites[i]->draw(dest);
+            at(i)->draw(dest);
         }
         
         break;
@@ -822,7 +859,7 @@ void sprite_list::draw(BITMAP* dest,bool lowfirst)
     case false:
         for(int i=count-1; i>=0; i--)
         {
-            sprites[i]->draw(dest);
+            at(i)->draw(dest);
         }
         
         break;
@@ -835,13 +872,13 @@ void sprite_list::drawshadow(BITMAP* dest,bool translucent, bool lowfirst)
     {
     case true:
         for(int i=0; i<count; i++)
-            sprites[i]->drawshadow(dest,translucent);
+            at(i)->drawshadow(dest,translucent);
             
         break;
         
     case false:
         for(int i=count-1; i>=0; i--)
-            sprites[i]->drawshadow(dest,translucent);
+            at(i)->drawshadow(dest,translucent);
             
         break;
     }
@@ -853,13 +890,13 @@ void sprite_list::draw2(BITMAP* dest,bool lowfirst)
     {
     case true:
         for(int i=0; i<count; i++)
-            sprites[i]->draw2(dest);
+            at(i)->draw2(dest);
             
         break;
         
     case false:
         for(int i=count-1; i>=0; i--)
-            sprites[i]->draw2(dest);
+            at(i)->draw2(dest);
             
         break;
     }
@@ -871,14 +908,14 @@ void sprite_list::drawcloaked2(BITMAP* dest,bool lowfirst)
     {
     case true:
         for(int i=0; i<count; i++)
-            sprites[i]->drawcloaked2(dest);
+            at(i)->drawcloaked2(dest);
             
         break;
         
     case false:
     
         for(int i=count-1; i>=0; i--)
-            sprites[i]->drawcloaked2(dest);
+            at(i)->drawcloaked2(dest);
             
         break;
     }
@@ -890,9 +927,12 @@ void sprite_list::animate()
     
     while(i<count)
     {
-        if(!(freeze_guys && sprites[i]->canfreeze))
+        // Keep the gap just ahead of sprite i so deleting it is cheap
+        movegap(i);
+        
+        if(!(freeze_guys && at(i)->canfreeze))
         {
-            if(sprites[i]->animate(i))
+            if(at(i)->animate(i))
             {
                 del(i);
                 --i;
@@ -901,6 +941,8 @@ void sprite_list::animate()
         
         ++i;
     }
+    
+    compact();
 }
 
 void sprite_list::check_conveyor()
@@ -909,7 +951,7 @@ void sprite_list::check_conveyor()
     
     while(i<count)
     {
-        sprites[i]->check_conveyor();
+        at(i)->check_conveyor();
         ++i;
     }
 }
@@ -922,7 +964,7 @@ int sprite_list::Count()
 int sprite_list::hit(sprite *s)
 {
     for(int i=0; i<count; i++)
-        if(sprites[i]->hit(s))
+        if(at(i)->hit(s))
             return i;
             
     return -1;
@@ -931,12 +973,118 @@ int sprite_list::hit(sprite *s)
 int sprite_list::hit(int x,int y,int z, int xsize, int ysize, int zsize)
 {
     for(int i=0; i<count; i++)
-        if(sprites[i]->hit(x,y,z,xsize,ysize,zsize))
+        if(at(i)->hit(x,y,z,xsize,ysize,zsize))
             return i;
             
     return -1;
 }
 
+/**********************************/
+/******** Collision Grid **********/
+/**********************************/
+
+collision_grid::collision_grid(sprite_list &l, unbounded_func u) :
+    list(l), unbounded(u), dirty(true), builtcount(0), stamp(0)
+{
+}
+
+void collision_grid::invalidate()
+{
+    dirty=true;
+}
+
+bool collision_grid::cellrange(sprite *s, int &c1, int &r1, int &c2, int &r2)
+{
+    if(s->hxsz<=0 || s->hysz<=0)
+        return false;
+        
+    // Positions are fixed point; pad by a pixel so truncation can't drop an overlap
+    int x1=int(s->x)+s->hxofs-1;
+    int y1=int(s->y)+s->hyofs-1;
+    int x2=x1+s->hxsz+2;
+    int y2=y1+s->hysz+2;
+    
+    c1=vbound(x1>>cellshift, 0, cols-1);
+    r1=vbound(y1>>cellshift, 0, rows-1);
+    c2=vbound(x2>>cellshift, 0, cols-1);
+    r2=vbound(y2>>cellshift, 0, rows-1);
+    
+    // Anything covering most of the screen is cheaper to just test
+    return (c2-c1+1)*(r2-r1+1) <= (cols*rows)/2;
+}
+
+void collision_grid::build()
+{
+    for(int i=0; i<cols*rows; i++)
+        cells[i].clear();
+        
+    always.clear();
+    builtcount=list.Count();
+    
+    for(int i=0; i<builtcount; i++)
+    {
+        sprite *s=list.spr(i);
+        int c1, r1, c2, r2;
+        
+        if((unbounded && unbounded(s)) || !cellrange(s, c1, r1, c2, r2))
+        {
+            always.push_back(i);
+            continue;
+        }
+        
+        for(int r=r1; r<=r2; r++)
+            for(int c=c1; c<=c2; c++)
+                cells[r*cols+c].push_back(i);
+    }
+    
+    if((int)seen.size()<builtcount)
+        seen.resize(builtcount, stamp);
+        
+    dirty=false;
+}
+
+void collision_grid::query(sprite *s, std::vector<int> &out)
+{
+    if(dirty || builtcount!=list.Count())
+        build();
+        
+    out.clear();
+    int c1, r1, c2, r2;
+    
+    if(!cellrange(s, c1, r1, c2, r2))
+    {
+        for(int i=0; i<builtcount; i++)
+            out.push_back(i);
+            
+        return;
+    }
+    
+    ++stamp;
+    out=always;
+    
+    for(unsigned int i=0; i<always.size(); i++)
+        seen[always[i]]=stamp;
+        
+    for(int r=r1; r<=r2; r++)
+    {
+        for(int c=c1; c<=c2; c++)
+        {
+            std::vector<int> &cell=cells[r*cols+c];
+            
+            for(unsigned int i=0; i<cell.size(); i++)
+            {
+                if(seen[cell[i]]!=stamp)
+                {
+                    seen[cell[i]]=stamp;
+                    out.push_back(cell[i]);
+                }
+            }
+        }
+    }
+    
+    std::sort(out.begin(), out.end());
+}
+
 /**********************************/
 /********** Moving Block **********/
 /**********************************/
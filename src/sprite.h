@@ -20,6 +20,7 @@
 #include "scripting/ObjectPool.h"
 #include <set>
 #include <map>
+#include <vector>
 
 using std::map;
 // this code needs some patching for use in zquest.cc
@@ -95,12 +96,20 @@ public:
 /********** Sprite List ***********/
 /**********************************/
 
-#define SLMAX 255
+// Default cap on the number of sprites in one list; see sprite_list::setLimit
+#define SLMAX 1024
 
+// Sprites are kept in order in a growable array. Deletions open a gap in the
+// array rather than shifting everything after them, and the gap is moved
+// along lazily, so animate() can drop any number of sprites in one pass.
+// Indices always refer to the live sprites in order, as before.
 class sprite_list
 {
-    sprite *sprites[SLMAX];
+    std::vector<sprite*> sprites;
     int count;
+    int gappos, gaplen;
+    
+    static int limit;
  
 public:
     sprite_list();
@@ -125,11 +134,63 @@ public:
     int hit(sprite *s);
     int hit(int x,int y,int z,int xsize, int ysize, int zsize);    
     
+    // The most sprites any one list will hold; add() fails past this
+    static int Limit();
+    static void setLimit(int l);
+    
 private:
 
+    sprite *&at(int index)
+    {
+        return sprites[index<gappos ? index : index+gaplen];
+    }
+    
+    void movegap(int pos);
+    void compact();
     void checkConsistency(); //for debugging
 };
 
+/**********************************/
+/******** Collision Grid **********/
+/**********************************/
+
+// A uniform grid over the playfield that narrows down which sprites in a list
+// might touch a given hit box. It's only a filter; hit() still decides, and
+// the candidates come back in list order so collisions resolve in the same
+// order as a plain loop over the list. The grid rebuilds itself when the
+// list's count changes, and must be invalidated whenever sprites may have
+// moved or been replaced.
+class collision_grid
+{
+public:
+    // Sprites for which this returns true are always candidates, e.g.
+    // because their hit box changes depending on what they're tested against.
+    typedef bool (*unbounded_func)(sprite *s);
+    
+    collision_grid(sprite_list &list, unbounded_func unbounded=NULL);
+    
+    void invalidate();
+    // Fills out with the indices of every sprite whose hit box may overlap s's.
+    void query(sprite *s, std::vector<int> &out);
+    
+private:
+    enum { cellshift=5, cols=256>>cellshift, rows=(176>>cellshift)+1 };
+    
+    sprite_list &list;
+    unbounded_func unbounded;
+    bool dirty;
+    int builtcount;
+    std::vector<int> cells[cols*rows];
+    std::vector<int> always;
+    std::vector<int> seen;
+    int stamp;
+    
+    void build();
+    // Cell range covered by a hit box; false if it's too large or degenerate
+    // to be worth bucketing.
+    static bool cellrange(sprite *s, int &c1, int &r1, int &c2, int &r2);
+};
+
 /**********************************/
 /********** Moving Block **********/
 /**********************************/
@@ -912,11 +912,11 @@ bool subscreen_object_currentitem::serializeExtraData(PACKFILE *f)
     if (!p_iputl(rightselect, f))
         return false;
 
-    uint32_t modlen = itemref.module.length() + 1;
+    uint32_t modlen = itemref.moduleName().length() + 1;
     if (!p_iputl(modlen, f))
         return false;
 
-    if (!pfwrite((void *)itemref.module.c_str(), modlen, f))
+    if (!pfwrite((void *)itemref.moduleName().c_str(), modlen, f))
         return false;
 
     if (!p_iputl(itemref.slot, f))
@@ -1279,10 +1279,10 @@ bool subscreen_object_counter::serializeExtraData(PACKFILE *f)
     if (!p_iputl(countertype3, f))
         return false;
 
-    uint32_t modlen = itemref.module.length() + 1;
+    uint32_t modlen = itemref.moduleName().length() + 1;
     if (!p_iputl(modlen, f))
         return false;
-    if (!pfwrite((void *)itemref.module.c_str(), modlen, f))
+    if (!pfwrite((void *)itemref.moduleName().c_str(), modlen, f))
         return false;
     if (!p_iputl(itemref.slot, f))
         return false;
@@ -0,0 +1,87 @@
+#include "precompiled.h" //always first
+
+#include "thread.h"
+
+#ifdef _WIN32
+
+#define WIN32_LEAN_AND_MEAN
+#include <allegro.h>
+#include <winalleg.h>
+
+struct zc_thread
+{
+    HANDLE handle;
+    thread_func func;
+    void *arg;
+};
+
+static DWORD WINAPI thread_trampoline(LPVOID param)
+{
+    zc_thread *t=(zc_thread *)param;
+    t->func(t->arg);
+    return 0;
+}
+
+zc_thread *thread_start(thread_func func, void *arg)
+{
+    zc_thread *t=new zc_thread;
+    t->func=func;
+    t->arg=arg;
+    t->handle=CreateThread(NULL, 0, thread_trampoline, t, 0, NULL);
+    
+    if(t->handle==NULL)
+    {
+        delete t;
+        return NULL;
+    }
+    
+    return t;
+}
+
+void thread_join(zc_thread *t)
+{
+    WaitForSingleObject(t->handle, INFINITE);
+    CloseHandle(t->handle);
+    delete t;
+}
+
+#else // Non-Windows
+
+#include <pthread.h>
+
+struct zc_thread
+{
+    pthread_t handle;
+    thread_func func;
+    void *arg;
+};
+
+static void *thread_trampoline(void *param)
+{
+    zc_thread *t=(zc_thread *)param;
+    t->func(t->arg);
+    return 0;
+}
+
+zc_thread *thread_start(thread_func func, void *arg)
+{
+    zc_thread *t=new zc_thread;
+    t->func=func;
+    t->arg=arg;
+    
+    if(pthread_create(&t->handle, 0, thread_trampoline, t)!=0)
+    {
+        delete t;
+        return NULL;
+    }
+    
+    return t;
+}
+
+void thread_join(zc_thread *t)
+{
+    pthread_join(t->handle, 0);
+    delete t;
+}
+
+#endif
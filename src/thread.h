@@ -0,0 +1,25 @@
+#ifndef _ZC_THREAD_H_
+#define _ZC_THREAD_H_
+
+// Minimal worker thread wrapper. The platform headers stay in thread.cpp so
+// this can be included next to Allegro on Windows.
+
+typedef void (*thread_func)(void *arg);
+
+struct zc_thread;
+
+// Storage class for variables each thread keeps its own copy of.
+#ifdef _MSC_VER
+#define ZC_THREAD_LOCAL __declspec(thread)
+#else
+#define ZC_THREAD_LOCAL __thread
+#endif
+
+// Runs func(arg) on a new thread. Returns NULL if the thread couldn't be
+// created; otherwise the result must be passed to thread_join exactly once.
+zc_thread *thread_start(thread_func func, void *arg);
+
+// Waits for the thread to finish and frees it.
+void thread_join(zc_thread *t);
+
+#endif
@@ -36,8 +36,10 @@ word animated_combos2;
 bool blank_tile_table[NEWMAXTILES];                         //keeps track of blank tiles
 bool used_tile_table[NEWMAXTILES];                          //keeps track of used tiles
 bool blank_tile_quarters_table[NEWMAXTILES*4];              //keeps track of blank tile quarters
+dword tile_revision=0;                                      //bumped whenever tile pixels may change
 extern fix  LinkModifiedX();
 extern fix  LinkModifiedY();
+extern bool is_zquest();
 
 bool unused_tile_table[NEWMAXTILES];                  //keeps track of unused tiles
 
@@ -148,6 +150,15 @@ word count_combos()
     return combos_used;
 }
 
+// Combo animation is worked out lazily. combo_anim_clock counts animation
+// frames, and each combo remembers the frame its tile and clock were last
+// brought up to date. sync_combo_animation() catches a combo up just before
+// its tile is drawn or examined, so a frame costs nothing for combos that
+// aren't on screen. Anything that reads or writes an animated combo's tile
+// or clock directly has to sync it first.
+static dword combo_anim_clock = 0;
+static dword combo_anim_synced[MAXCOMBOS];
+
 void setup_combo_animations()
 {
     memset(animated_combo_table, 0, MAXCOMBOS*2*2);
@@ -163,6 +174,7 @@ void setup_combo_animations()
         {
             animated_combo_table4[y][0]=x;
             animated_combo_table4[y][1]=0;
+            combo_anim_synced[x]=combo_anim_clock;
             ++y;
         }
     }
@@ -185,6 +197,7 @@ void setup_combo_animations2()
         {
             animated_combo_table24[y][0]=x;
             animated_combo_table24[y][1]=0;
+            combo_anim_synced[x]=combo_anim_clock;
             ++y;
         }
     }
@@ -192,6 +205,114 @@ void setup_combo_animations2()
     animated_combos2=y;
 }
 
+// One animation step. AF_FRESH combos (fresh) measure the animation
+// differently when deciding whether to wrap; that's kept as it was.
+static word next_combo_tile(const newcombo &c, word tile, int orig, bool fresh)
+{
+    //this is a mess.
+    int span = c.frames+((c.frames-1)*c.skipanim)+
+               (fresh ? (c.frames-1)*c.skipanimy*TILES_PER_ROW : c.skipanimy*TILES_PER_ROW);
+               
+    if(tile-span>=orig-1)
+        return orig;                                         //reset tile
+        
+    word next=tile+1+c.skipanim;                            //increment tile
+    
+    if(tile/TILES_PER_ROW!=next/TILES_PER_ROW)
+        next+=TILES_PER_ROW*c.skipanimy;
+        
+    return next;
+}
+
+void sync_combo_animation(int c)
+{
+    if(c<0 || c>=MAXCOMBOS)
+        return;
+        
+    dword elapsed=combo_anim_clock-combo_anim_synced[c];
+    
+    if(!elapsed)
+        return;
+        
+    combo_anim_synced[c]=combo_anim_clock;
+    
+    word *entry;
+    int orig;
+    bool fresh;
+    int y=animated_combo_table[c][0];
+    int y2=animated_combo_table2[c][0];
+    
+    if(y<animated_combos && animated_combo_table4[y][0]==c)
+    {
+        entry=animated_combo_table4[y];
+        orig=animated_combo_table[c][1];
+        fresh=false;
+    }
+    else if(y2<animated_combos2 && animated_combo_table24[y2][0]==c)
+    {
+        entry=animated_combo_table24[y2];
+        orig=animated_combo_table2[c][1];
+        fresh=true;
+    }
+    else
+        return;
+        
+    // Each frame, a clock that's reached the speed steps the tile and goes
+    // back to 0; otherwise it counts up
+    newcombo &cmb=combobuf[c];
+    dword speed=cmb.speed;
+    dword first=(entry[1]>=speed) ? 1 : speed-entry[1]+1;
+    
+    if(elapsed<first)
+    {
+        entry[1]+=elapsed;
+        return;
+    }
+    
+    dword steps=1+(elapsed-first)/(speed+1);
+    entry[1]=(elapsed-first)%(speed+1);
+    
+    // The tile climbs until it wraps back to the original tile, so once it
+    // gets there only part of a cycle is left to run
+    word tile=cmb.tile;
+    
+    for(; steps && tile!=orig; --steps)
+        tile=next_combo_tile(cmb, tile, orig, fresh);
+        
+    if(steps)
+    {
+        dword period=0;
+        word t=orig;
+        
+        do
+        {
+            t=next_combo_tile(cmb, t, orig, fresh);
+            ++period;
+        }
+        while(t!=orig && period<65536);
+        
+        if(t==orig)
+            steps%=period;
+            
+        for(; steps; --steps)
+            tile=next_combo_tile(cmb, tile, orig, fresh);
+    }
+    
+    cmb.tile=tile;
+}
+
+void sync_combo_cycling(int c)
+{
+    if(c<0 || c>=MAXCOMBOS)
+        return;
+        
+    // Cycling looks at the clock in the table slot c maps to, which belongs
+    // to another combo when c itself isn't animated
+    sync_combo_animation(c);
+    sync_combo_animation(animated_combo_table4[animated_combo_table[c][0]][0]);
+    sync_combo_animation(animated_combo_table24[animated_combo_table2[c][0]][0]);
+}
+
 void reset_combo_animation(int c)
 {
     for(word x=0; x<animated_combos; ++x)
@@ -200,6 +321,7 @@ void reset_combo_animation(int c)
         
         if(y==c)
         {
+            sync_combo_animation(y);
             combobuf[y].tile=animated_combo_table[y][1];        //reset tile
             animated_combo_table4[x][1]=0;                        //reset clock
             return;
@@ -215,6 +337,7 @@ void reset_combo_animation2(int c)
         
         if(y==c)
         {
+            sync_combo_animation(y);
             combobuf[y].tile=animated_combo_table2[y][1];        //reset tile
             animated_combo_table24[x][1]=0;                        //reset clock
             return;
@@ -226,6 +349,7 @@ void reset_combo_animations()
 {
     for(word x=0; x<animated_combos; ++x)
     {
+        sync_combo_animation(animated_combo_table4[x][0]);
         combobuf[animated_combo_table4[x][0]].tile=animated_combo_table[animated_combo_table4[x][0]][1];
     }
 }
@@ -234,78 +358,43 @@ void reset_combo_animations2()
 {
     for(word x=0; x<animated_combos; ++x)
     {
+        sync_combo_animation(animated_combo_table24[x][0]);
         combobuf[animated_combo_table24[x][0]].tile=animated_combo_table2[animated_combo_table24[x][0]][1];
     }
 }
 
-extern void update_combo_cycling();
-
-void animate_combos()
+void reset_combo_clocks()
 {
-    update_combo_cycling();
-    
-    for(word x=0; x<animated_combos; ++x)
+    for(word x=0; x<animated_combos; x++)
     {
-        int y=animated_combo_table4[x][0];                      //combo number
-        
-        if(animated_combo_table4[x][1]>=combobuf[y].speed)      //time to animate
-        {
-            //this is a mess.
-            if(combobuf[y].tile-
-                    (combobuf[y].frames+((combobuf[y].frames-1)*combobuf[y].skipanim)+
-                     (combobuf[y].skipanimy*TILES_PER_ROW))
-                    >=animated_combo_table[y][1]-1)
-            {
-                combobuf[y].tile=animated_combo_table[y][1];        //reset tile
-            }
-            else
-            {
-                int temp=combobuf[y].tile;
-                combobuf[y].tile+=1+(combobuf[y].skipanim); //increment tile
-                
-                if(temp/TILES_PER_ROW!=combobuf[y].tile/TILES_PER_ROW)
-                    combobuf[y].tile+=TILES_PER_ROW*combobuf[y].skipanimy;
-            }
-            
-            animated_combo_table4[x][1]=0;                        //reset clock
-        }
-        else
+        if(combobuf[animated_combo_table4[x][0]].nextcombo!=0)
         {
-            ++animated_combo_table4[x][1];                        //increment clock
+            sync_combo_animation(animated_combo_table4[x][0]);
+            animated_combo_table4[x][1]=0;
         }
     }
-    
-    for(word x=0; x<animated_combos2; ++x)
+}
+
+void reset_combo_clocks2()
+{
+    for(word x=0; x<animated_combos2; x++)
     {
-        int y=animated_combo_table24[x][0];                      //combo number
-        
-        if(animated_combo_table24[x][1]>=combobuf[y].speed)      //time to animate
-        {
-            if(combobuf[y].tile-
-                    (combobuf[y].frames+((combobuf[y].frames-1)*combobuf[y].skipanim)+
-                     (combobuf[y].frames-1)*combobuf[y].skipanimy*TILES_PER_ROW)
-                    >=animated_combo_table2[y][1]-1)
-            {
-                combobuf[y].tile=animated_combo_table2[y][1];        //reset tile
-            }
-            else
-            {
-                int temp=combobuf[y].tile;
-                combobuf[y].tile+=1+(combobuf[y].skipanim); //increment tile
-                
-                if(temp/TILES_PER_ROW!=combobuf[y].tile/TILES_PER_ROW)
-                    combobuf[y].tile+=TILES_PER_ROW*combobuf[y].skipanimy;
-            }
-            
-            animated_combo_table24[x][1]=0;                        //reset clock
-        }
-        else
+        if(combobuf[animated_combo_table24[x][0]].nextcombo!=0)
         {
-            ++animated_combo_table24[x][1];                        //increment clock
+            sync_combo_animation(animated_combo_table24[x][0]);
+            animated_combo_table24[x][1]=0;
         }
     }
 }
 
+extern void update_combo_cycling();
+
+void animate_combos()
+{
+    update_combo_cycling();
+    ++combo_anim_clock;
+}
+
 /*
 bool isonline(float x1, float y1, float x2, float y2, float x3, float y3)
 {
@@ -382,6 +471,9 @@ void clear_tile(tiledata *buf, word tile)
 
 void reset_tile(tiledata *buf, int t, int format=1)
 {
+    if(buf==newtilebuf)
+        invalidate_unpacked_tile(t);
+        
     buf[t].format=format;
     
     if(buf[t].data!=NULL)
@@ -519,21 +611,11 @@ bool copy_tile(tiledata *buf, int src, int dest, bool swap)
 }
 
 
-// unpacks from tilebuf to unpackbuf
-void unpack_tile(tiledata *buf, int tile, int flip, bool force)
+// decodes a tile from tilebuf into a 256 byte buffer
+static void decode_tile(tiledata *buf, int tile, int flip, byte *dest)
 {
-    static byte *si, *di;
-    static byte *oldnewtilebuf=buf[tile].data;
-    static int i, j, oldtile=-5, oldflip=-5;
-    
-    if(tile==oldtile&&(flip&5)==(oldflip&5)&&oldnewtilebuf==buf[tile].data&&!force)
-    {
-        return;
-    }
-    
-    oldtile=tile;
-    oldflip=flip;
-    oldnewtilebuf=buf[tile].data;
+    byte *si, *di;
+    int i, j;
     
     switch(flip&5)
     {
@@ -545,7 +627,7 @@ void unpack_tile(tiledata *buf, int tile, int flip, bool force)
             switch(buf[tile].format)
             {
             case tf4Bit:
-                di=unpackbuf + (i<<4) - 1;
+                di=dest + (i<<4) - 1;
                 
                 for(j=7; j>=0; --j)
                 {
@@ -556,7 +638,7 @@ void unpack_tile(tiledata *buf, int tile, int flip, bool force)
                 break;
                 
             case tf8Bit:
-                di=unpackbuf + (i<<4) - 1;
+                di=dest + (i<<4) - 1;
                 
                 for(j=1; j>=0; --j)
                 {
@@ -584,7 +666,7 @@ void unpack_tile(tiledata *buf, int tile, int flip, bool force)
             switch(buf[tile].format)
             {
             case tf4Bit:
-                di=unpackbuf + 271 - i; //256 + 15 - i
+                di=dest + 271 - i; //256 + 15 - i
                 
                 for(j=7; j>=0; --j)
                 {
@@ -597,7 +679,7 @@ void unpack_tile(tiledata *buf, int tile, int flip, bool force)
                 break;
                 
             case tf8Bit:
-                di=unpackbuf + 271 - i; //256 + 15 - i
+                di=dest + 271 - i; //256 + 15 - i
                 
                 for(j=1; j>=0; --j)
                 {
@@ -633,7 +715,7 @@ void unpack_tile(tiledata *buf, int tile, int flip, bool force)
             switch(buf[tile].format)
             {
             case tf4Bit:
-                di=unpackbuf + 256 + i;
+                di=dest + 256 + i;
                 
                 for(j=7; j>=0; --j)
                 {
@@ -646,7 +728,7 @@ void unpack_tile(tiledata *buf, int tile, int flip, bool force)
                 break;
                 
             case tf8Bit:
-                di=unpackbuf + 256 + i;
+                di=dest + 256 + i;
                 
                 for(j=1; j>=0; --j)
                 {
@@ -679,7 +761,7 @@ void unpack_tile(tiledata *buf, int tile, int flip, bool force)
         {
         case tf4Bit:
             si = buf[tile].data+tilesize(buf[tile].format);
-            di = unpackbuf + 256;
+            di = dest + 256;
             
             for(i=127; i>=0; --i)
             {
@@ -691,7 +773,7 @@ void unpack_tile(tiledata *buf, int tile, int flip, bool force)
             
         case tf8Bit:
             si = buf[tile].data+tilesize(buf[tile].format);
-            di = unpackbuf + 256;
+            di = dest + 256;
             
             for(i=31; i>=0; --i)
             {
@@ -712,10 +794,229 @@ void unpack_tile(tiledata *buf, int tile, int flip, bool force)
     }
 }
 
+//
+// Decoded tile cache: LRU over (tile, flip) for newtilebuf, so redrawing the
+// same tiles every frame doesn't decode them again. Entries also remember the
+// data pointer they were decoded from, which catches reallocated tiles, but
+// in-place writes must call invalidate_unpacked_tile().
+//
+
+#define TILE_CACHE_SIZE    2048
+#define TILE_CACHE_BUCKETS 4096
+
+struct unpacked_tile_entry
+{
+    int key;                                                // (tile<<2)|flip slot, -1 if unused
+    byte *data;                                             // tile data it was decoded from
+    int hash_next;
+    int lru_prev, lru_next;
+};
+
+static unpacked_tile_entry tile_cache[TILE_CACHE_SIZE];
+static qword tile_cache_pixels[TILE_CACHE_SIZE][UNPACKSIZE/sizeof(qword)];
+static int tile_cache_bucket[TILE_CACHE_BUCKETS];
+static int tile_cache_head, tile_cache_tail;
+static bool tile_cache_ready=false;
+
+// last tile copied into unpackbuf by unpack_tile()
+static byte *last_unpacked_data=NULL;
+static int last_unpacked_tile=-5, last_unpacked_flip=-5;
+
+static INLINE int tile_cache_key(int tile, int flip)
+{
+    return (tile<<2)|(flip&1)|((flip&4)>>1);
+}
+
+static INLINE int tile_cache_hash(int key)
+{
+    return (key^(key>>12))&(TILE_CACHE_BUCKETS-1);
+}
+
+// ZQuest writes tile data in place all over the tile editor, so only the
+// player uses the cache.
+static INLINE bool use_tile_cache(tiledata *buf)
+{
+    return buf==newtilebuf && !is_zquest();
+}
+
+static void tile_cache_unlink_lru(int e)
+{
+    if(tile_cache[e].lru_prev>=0) tile_cache[tile_cache[e].lru_prev].lru_next=tile_cache[e].lru_next;
+    else tile_cache_head=tile_cache[e].lru_next;
+    
+    if(tile_cache[e].lru_next>=0) tile_cache[tile_cache[e].lru_next].lru_prev=tile_cache[e].lru_prev;
+    else tile_cache_tail=tile_cache[e].lru_prev;
+}
+
+static void tile_cache_push_front(int e)
+{
+    tile_cache[e].lru_prev=-1;
+    tile_cache[e].lru_next=tile_cache_head;
+    
+    if(tile_cache_head>=0) tile_cache[tile_cache_head].lru_prev=e;
+    else tile_cache_tail=e;
+    
+    tile_cache_head=e;
+}
+
+static void tile_cache_push_back(int e)
+{
+    tile_cache[e].lru_next=-1;
+    tile_cache[e].lru_prev=tile_cache_tail;
+    
+    if(tile_cache_tail>=0) tile_cache[tile_cache_tail].lru_next=e;
+    else tile_cache_head=e;
+    
+    tile_cache_tail=e;
+}
+
+static void tile_cache_unlink_hash(int e)
+{
+    int *link=&tile_cache_bucket[tile_cache_hash(tile_cache[e].key)];
+    
+    while(*link!=e)
+        link=&tile_cache[*link].hash_next;
+        
+    *link=tile_cache[e].hash_next;
+    tile_cache[e].key=-1;
+}
+
+void invalidate_unpacked_tiles()
+{
+    ++tile_revision;
+    
+    for(int i=0; i<TILE_CACHE_BUCKETS; ++i)
+        tile_cache_bucket[i]=-1;
+        
+    for(int i=0; i<TILE_CACHE_SIZE; ++i)
+    {
+        tile_cache[i].key=-1;
+        tile_cache[i].data=NULL;
+        tile_cache[i].hash_next=-1;
+        tile_cache[i].lru_prev=i-1;
+        tile_cache[i].lru_next=(i<TILE_CACHE_SIZE-1) ? i+1 : -1;
+    }
+    
+    tile_cache_head=0;
+    tile_cache_tail=TILE_CACHE_SIZE-1;
+    tile_cache_ready=true;
+    last_unpacked_tile=-5;
+}
+
+void invalidate_unpacked_tile(int tile)
+{
+    ++tile_revision;
+    
+    if(tile==last_unpacked_tile)
+        last_unpacked_tile=-5;
+        
+    if(!tile_cache_ready)
+        return;
+        
+    for(int flip=0; flip<=5; flip+=(flip==1) ? 3 : 1)
+    {
+        int key=tile_cache_key(tile, flip);
+        
+        for(int e=tile_cache_bucket[tile_cache_hash(key)]; e>=0; e=tile_cache[e].hash_next)
+        {
+            if(tile_cache[e].key==key)
+            {
+                tile_cache_unlink_hash(e);
+                // free entries are reused first
+                tile_cache_unlink_lru(e);
+                tile_cache_push_back(e);
+                break;
+            }
+        }
+    }
+}
+
+byte *get_unpacked_tile(int tile, int flip)
+{
+    if(!use_tile_cache(newtilebuf))
+    {
+        unpack_tile(newtilebuf, tile, flip, false);
+        return unpackbuf;
+    }
+    
+    if(!tile_cache_ready)
+        invalidate_unpacked_tiles();
+        
+    int key=tile_cache_key(tile, flip);
+    int bucket=tile_cache_hash(key);
+    int e;
+    
+    for(e=tile_cache_bucket[bucket]; e>=0; e=tile_cache[e].hash_next)
+    {
+        if(tile_cache[e].key==key)
+            break;
+    }
+    
+    if(e<0)
+    {
+        // evict the least recently used entry
+        e=tile_cache_tail;
+        
+        if(tile_cache[e].key>=0)
+            tile_cache_unlink_hash(e);
+            
+        tile_cache[e].key=key;
+        tile_cache[e].data=NULL;
+        tile_cache[e].hash_next=tile_cache_bucket[bucket];
+        tile_cache_bucket[bucket]=e;
+    }
+    
+    byte *pixels=(byte*)tile_cache_pixels[e];
+    
+    if(tile_cache[e].data!=newtilebuf[tile].data)
+    {
+        decode_tile(newtilebuf, tile, flip, pixels);
+        tile_cache[e].data=newtilebuf[tile].data;
+    }
+    
+    if(e!=tile_cache_head)
+    {
+        tile_cache_unlink_lru(e);
+        tile_cache_push_front(e);
+    }
+    
+    return pixels;
+}
+
+// unpacks from tilebuf to unpackbuf
+void unpack_tile(tiledata *buf, int tile, int flip, bool force)
+{
+    if(force && buf==newtilebuf)
+    {
+        invalidate_unpacked_tile(tile);
+    }
+    
+    if(tile==last_unpacked_tile&&(flip&5)==(last_unpacked_flip&5)&&last_unpacked_data==buf[tile].data&&!force)
+    {
+        return;
+    }
+    
+    last_unpacked_tile=tile;
+    last_unpacked_flip=flip;
+    last_unpacked_data=buf[tile].data;
+    
+    if(use_tile_cache(buf))
+    {
+        memcpy(unpackbuf, get_unpacked_tile(tile, flip), UNPACKSIZE);
+    }
+    else
+    {
+        decode_tile(buf, tile, flip, unpackbuf);
+    }
+}
+
 // packs from src[256] to tilebuf
 void pack_tile(tiledata *buf, byte *src,int tile)
 {
     pack_tiledata(buf[tile].data, src, buf[tile].format);
+    
+    if(buf==newtilebuf)
+        invalidate_unpacked_tile(tile);
 }
 
 void pack_tiledata(byte *dest, byte *src, byte format)
@@ -802,8 +1103,8 @@ void puttiletranslucent8(BITMAP* dest,int tile,int x,int y,int cset,int flip,int
     
     cset &= 15;
     cset <<= CSET_SHFT;
-    unpack_tile(newtilebuf, tile>>2, 0, false);
-    byte *si = unpackbuf + ((tile&2)<<6) + ((tile&1)<<3);
+    byte *unpacked = get_unpacked_tile(tile>>2, 0);
+    byte *si = unpacked + ((tile&2)<<6) + ((tile&1)<<3);
     
     if(flip&1)  //horizontal
     {
@@ -904,8 +1205,8 @@ void overtiletranslucent8(BITMAP* dest,int tile,int x,int y,int cset,int flip,in
     
     cset &= 15;
     cset <<= CSET_SHFT;
-    unpack_tile(newtilebuf, tile>>2, 0, false);
-    byte *si = unpackbuf + ((tile&2)<<6) + ((tile&1)<<3);
+    byte *unpacked = get_unpacked_tile(tile>>2, 0);
+    byte *si = unpacked + ((tile&2)<<6) + ((tile&1)<<3);
     
     if(flip&1)
     {
@@ -1015,8 +1316,8 @@ void puttiletranslucent16(BITMAP* dest,int tile,int x,int y,int cset,int flip,in
     
     cset &= 15;
     cset <<= CSET_SHFT;
-    unpack_tile(newtilebuf, tile, 0, false);
-    byte *si = unpackbuf;
+    byte *unpacked = get_unpacked_tile(tile, 0);
+    byte *si = unpacked;
     byte *di;
     
     if(flip&1)
@@ -1138,8 +1439,8 @@ void overtiletranslucent16(BITMAP* dest,int tile,int x,int y,int cset,int flip,i
     
     cset &= 15;
     cset <<= CSET_SHFT;
-    unpack_tile(newtilebuf, tile,flip&5, false);
-    byte *si = unpackbuf;
+    byte *unpacked = get_unpacked_tile(tile, flip&5);
+    byte *si = unpacked;
     byte *di;
     
     if((flip&2)==0)
@@ -1257,8 +1558,8 @@ void overtilecloaked16(BITMAP* dest,int tile,int x,int y,int flip)
         return;
     }
     
-    unpack_tile(newtilebuf, tile, 0, false);
-    byte *si = unpackbuf;
+    byte *unpacked = get_unpacked_tile(tile, 0);
+    byte *si = unpacked;
     byte *di;
     
     if(flip&1)
@@ -1474,6 +1775,9 @@ void overblocktranslucent8(BITMAP *dest,int tile,int x,int y,int csets[],int fli
 
 int combo_tile(const newcombo &c, int x, int y)
 {
+    if(&c>=combobuf && &c<combobuf+MAXCOMBOS)
+        sync_combo_animation(&c-combobuf);
+        
     int drawtile=c.tile;
     int tframes=zc_max(1, c.frames);
     
@@ -1598,6 +1902,7 @@ int combo_tile(int cmbdat, int x, int y)
 
 void putcombotranslucent(BITMAP* dest,int x,int y,int cmbdat,int cset,int opacity)
 {
+    sync_combo_animation(cmbdat);
     newcombo c = combobuf[cmbdat];
     int drawtile=combo_tile(c, x, y);
     
@@ -1625,6 +1930,7 @@ void overcombotranslucent(BITMAP* dest,int x,int y,int cmbdat,int cset,int opaci
 
 void overcomboblocktranslucent(BITMAP *dest, int x, int y, int cmbdat, int cset, int w, int h, int opacity)
 {
+    sync_combo_animation(cmbdat);
     newcombo c = combobuf[cmbdat];
     int drawtile=combo_tile(c, x, y);
     
@@ -1679,7 +1985,7 @@ void puttile8(BITMAP* dest,int tile,int x,int y,int cset,int flip)
     cset &= 15;
     cset <<= CSET_SHFT;
     dword lcset = (cset<<24)+(cset<<16)+(cset<<8)+cset;
-    unpack_tile(newtilebuf, tile>>2, 0, false);
+    byte *unpacked = get_unpacked_tile(tile>>2, 0);
     
     //  to go to 24-bit color, do this kind of thing...
     //  ((long *)bmp->line[y])[x] = color;
@@ -1688,7 +1994,7 @@ void puttile8(BITMAP* dest,int tile,int x,int y,int cset,int flip)
     {
     case 1:                                                 // 1 byte at a time
     {
-        byte *si = unpackbuf + ((tile&2)<<6) + ((tile&1)<<3);
+        byte *si = unpacked + ((tile&2)<<6) + ((tile&1)<<3);
         
         for(int dy=0; dy<8; ++dy)
         {
@@ -1704,7 +2010,7 @@ void puttile8(BITMAP* dest,int tile,int x,int y,int cset,int flip)
     
     case 2:                                                 // 4 bytes at a time
     {
-        dword *si = ((dword*)unpackbuf) + ((tile&2)<<4) + ((tile&1)<<1);
+        dword *si = ((dword*)unpacked) + ((tile&2)<<4) + ((tile&1)<<1);
         
         for(int dy=7; dy>=0; --dy)
         {
@@ -1718,7 +2024,7 @@ void puttile8(BITMAP* dest,int tile,int x,int y,int cset,int flip)
     
     case 3:                                                 // 1 byte at a time
     {
-        byte *si = unpackbuf + ((tile&2)<<6) + ((tile&1)<<3);
+        byte *si = unpacked + ((tile&2)<<6) + ((tile&1)<<3);
         
         for(int dy=7; dy>=0; --dy)
         {
@@ -1734,7 +2040,7 @@ void puttile8(BITMAP* dest,int tile,int x,int y,int cset,int flip)
     
     default:                                                // 4 bytes at a time
     {
-        dword *si = ((dword*)unpackbuf) + ((tile&2)<<4) + ((tile&1)<<1);
+        dword *si = ((dword*)unpacked) + ((tile&2)<<4) + ((tile&1)<<1);
         
         for(int dy=0; dy<8; ++dy)
         {
@@ -1767,8 +2073,8 @@ void oldputtile8(BITMAP* dest,int tile,int x,int y,int cset,int flip)
     
     cset &= 15;
     cset <<= CSET_SHFT;
-    unpack_tile(newtilebuf, tile>>2, 0, false);
-    byte *si = unpackbuf + ((tile&2)<<6) + ((tile&1)<<3);
+    byte *unpacked = get_unpacked_tile(tile>>2, 0);
+    byte *si = unpacked + ((tile&2)<<6) + ((tile&1)<<3);
     
     if(flip&1)
     {
@@ -1866,8 +2172,8 @@ void overtile8(BITMAP* dest,int tile,int x,int y,int cset,int flip)
     
     cset &= 15;
     cset <<= CSET_SHFT;
-    unpack_tile(newtilebuf, tile>>2, 0, false);
-    byte *si = unpackbuf + ((tile&2)<<6) + ((tile&1)<<3);
+    byte *unpacked = get_unpacked_tile(tile>>2, 0);
+    byte *si = unpacked + ((tile&2)<<6) + ((tile&1)<<3);
     
     if(flip&1)
     {
@@ -1976,14 +2282,14 @@ void puttile16(BITMAP* dest,int tile,int x,int y,int cset,int flip) //fixed
     cset &= 15;
     cset <<= CSET_SHFT;
     
-    unpack_tile(newtilebuf, tile, flip&5, false);
+    byte *unpacked = get_unpacked_tile(tile, flip&5);
     
     switch(flip&2)
     {
         /*
           case 1:
           {
-          byte *si = unpackbuf;
+          byte *si = unpacked;
           for(int dy=0; dy<16; ++dy)
           {
           // 1 byte at a time
@@ -1996,7 +2302,7 @@ void puttile16(BITMAP* dest,int tile,int x,int y,int cset,int flip) //fixed
     case 2: //vertical
     {
         /*
-          dword *si = (dword*)unpackbuf;
+          dword *si = (dword*)unpacked;
           for(int dy=15; dy>=0; --dy)
           {
           // 4 bytes at a time
@@ -2007,7 +2313,7 @@ void puttile16(BITMAP* dest,int tile,int x,int y,int cset,int flip) //fixed
           */
         qword llcset = (((qword)cset)<<56)+(((qword)cset)<<48)+(((qword)cset)<<40)+(((qword)cset)<<32)+(((qword)cset)<<24)+(cset<<16)+(cset<<8)+cset;
         //      qword llcset = (((qword)cset)<<56)|(((qword)cset)<<48)|(((qword)cset)<<40)|(((qword)cset)<<32)|(((qword)cset)<<24)|(cset<<16)|(cset<<8)|cset;
-        qword *si = (qword*)unpackbuf;
+        qword *si = (qword*)unpacked;
         
         for(int dy=15; dy>=0; --dy)
         {
@@ -2024,7 +2330,7 @@ void puttile16(BITMAP* dest,int tile,int x,int y,int cset,int flip) //fixed
     /*
       case 3:
       {
-      byte *si = unpackbuf;
+      byte *si = unpacked;
       for(int dy=15; dy>=0; --dy)
       {
       // 1 byte at a time
@@ -2037,7 +2343,7 @@ void puttile16(BITMAP* dest,int tile,int x,int y,int cset,int flip) //fixed
     default: //none or invalid
     {
         /*
-          dword *si = (dword*)unpackbuf;
+          dword *si = (dword*)unpacked;
           for(int dy=0; dy<16; ++dy)
           {
           // 4 bytes at a time
@@ -2048,7 +2354,7 @@ void puttile16(BITMAP* dest,int tile,int x,int y,int cset,int flip) //fixed
           */
         qword llcset = (((qword)cset)<<56)+(((qword)cset)<<48)+(((qword)cset)<<40)+(((qword)cset)<<32)+(((qword)cset)<<24)+(cset<<16)+(cset<<8)+cset;
         //      qword llcset = (((qword)cset)<<56)|(((qword)cset)<<48)|(((qword)cset)<<40)|(((qword)cset)<<32)|(((qword)cset)<<24)|(cset<<16)|(cset<<8)|cset;
-        qword *si = (qword*)unpackbuf;
+        qword *si = (qword*)unpacked;
         
         for(int dy=0; dy<16; ++dy)
         {
@@ -2088,8 +2394,8 @@ void oldputtile16(BITMAP* dest,int tile,int x,int y,int cset,int flip) //fixed
     
     cset &= 15;
     cset <<= CSET_SHFT;
-    unpack_tile(newtilebuf, tile, flip&5, false);
-    byte *si = unpackbuf;
+    byte *unpacked = get_unpacked_tile(tile, flip&5);
+    byte *si = unpacked;
     byte *di;
     
     if((flip&2)==0)
@@ -2195,8 +2501,8 @@ void overtile16(BITMAP* dest,int tile,int x,int y,int cset,int flip) //fixed
     
     cset &= 15;
     cset <<= CSET_SHFT;
-    unpack_tile(newtilebuf, tile, flip&5, false);
-    byte *si = unpackbuf;
+    byte *unpacked = get_unpacked_tile(tile, flip&5);
+    byte *si = unpacked;
     byte *di;
     
     if((flip&2)==0)
@@ -2449,6 +2755,7 @@ void overblock8(BITMAP *dest,int tile,int x,int y,int csets[],int flip,int mask)
 
 void putcombo(BITMAP* dest,int x,int y,int cmbdat,int cset)
 {
+    sync_combo_animation(cmbdat);
     newcombo c = combobuf[cmbdat];
     int drawtile=combo_tile(c, x, y);
     
@@ -2474,6 +2781,7 @@ void putcombo(BITMAP* dest,int x,int y,int cmbdat,int cset)
 
 void oldputcombo(BITMAP* dest,int x,int y,int cmbdat,int cset)
 {
+    sync_combo_animation(cmbdat);
     newcombo c = combobuf[cmbdat];
     int drawtile=combo_tile(c, x, y);
     
@@ -2504,6 +2812,7 @@ void overcombo(BITMAP* dest,int x,int y,int cmbdat,int cset)
 
 void overcomboblock(BITMAP *dest, int x, int y, int cmbdat, int cset, int w, int h)
 {
+    sync_combo_animation(cmbdat);
     newcombo c = combobuf[cmbdat];
     int drawtile=combo_tile(c, x, y);
     
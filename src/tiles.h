@@ -30,6 +30,7 @@ extern word animated_combos2;
 extern bool blank_tile_table[NEWMAXTILES];                  //keeps track of blank tiles
 extern bool used_tile_table[NEWMAXTILES];                   //keeps track of used tiles
 extern bool blank_tile_quarters_table[NEWMAXTILES*4];       //keeps track of blank tile quarters
+extern dword tile_revision;                                 //bumped whenever tile pixels may change
 
 // in tiles.cc
 extern byte unpackbuf[UNPACKSIZE];
@@ -46,6 +47,13 @@ void setup_combo_animations2();
 void reset_combo_animation2(int c);
 void reset_combo_animations2();
 void animate_combos();
+// Brings combo c's animated tile and clock up to date
+void sync_combo_animation(int c);
+// Syncs everything combo cycling looks at for combo c
+void sync_combo_cycling(int c);
+// Restart the clocks of animated combos that cycle
+void reset_combo_clocks();
+void reset_combo_clocks2();
 bool isonline(long x1, long y1, long x2, long y2, long x3, long y3);
 void reset_tile(tiledata *buf, int t, int format);
 //void clear_tile(tiledata *buf, word tile);
@@ -53,6 +61,9 @@ void clear_tiles(tiledata *buf);
 void overlay_tile(tiledata *buf,int dest,int src,int cs,bool backwards);
 bool copy_tile(tiledata *buf, int src, int dest, bool swap);
 void unpack_tile(tiledata *buf, int tile, int flip, bool force);
+byte *get_unpacked_tile(int tile, int flip);
+void invalidate_unpacked_tile(int tile);
+void invalidate_unpacked_tiles();
 
 void pack_tile(tiledata *buf, byte *src,int tile);
 void pack_tiledata(byte *dest, byte *src, byte format);
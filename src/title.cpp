@@ -1011,6 +1011,7 @@ int readsaves(gamedata *savedata, PACKFILE *f)
         savedata[i].set_cheat(tempbyte);
         
         savedata[i].inventoryItems.clear();
+        savedata[i].invalidate_family_items();
         uint32_t numitems;
         if (!p_igetl(&numitems, f, true))
             return 18;
@@ -1745,10 +1746,10 @@ int writesaves(gamedata *savedata, PACKFILE *f)
 
         for(std::set<ItemDefinitionRef>::iterator it = savedata[i].inventoryItems.begin(); it != savedata[i].inventoryItems.end(); ++it)
         {
-            uint32_t modlen = it->module.length() + 1;
+            uint32_t modlen = it->moduleName().length() + 1;
             if (!p_iputl(modlen, f))
                 return 18;
-            if (!pfwrite((void *)it->module.c_str(), modlen, f))
+            if (!pfwrite((void *)it->moduleName().c_str(), modlen, f))
                 return 18;
             if(!p_iputl(it->slot,f))
                 return 18;
@@ -1761,10 +1762,10 @@ int writesaves(gamedata *savedata, PACKFILE *f)
 
         for (std::map<ItemDefinitionRef, uint8_t>::iterator it = savedata[i].disabledItems.begin(); it != savedata[i].disabledItems.end(); ++it)
         {
-            uint32_t len = it->first.module.length() + 1;
+            uint32_t len = it->first.moduleName().length() + 1;
             if (!p_iputl(len, f))
                 return 19;
-            if (!pfwrite((void *)it->first.module.c_str(), len, f))
+            if (!pfwrite((void *)it->first.moduleName().c_str(), len, f))
                 return 19;
             if (!p_iputl(it->first.slot, f))
                 return 19;
@@ -2025,7 +2026,7 @@ void load_game_icon_to_buffer(bool forceDefault, int index)
     
     if(!forceDefault)
     {
-        flushItemCache();
+        verifyItems();
         ItemDefinitionRef maxringid = curQuest->getHighestLevelOfFamily(&zinit, itype_ring);
         
         if(curQuest->isValid(maxringid))
@@ -2201,9 +2202,11 @@ static void list_save(int save_num, int ypos)
     byte holdformat=newtilebuf[0].format;
     newtilebuf[0].format=tf4Bit;
     newtilebuf[0].data = saves[save_num].icon;
+    invalidate_unpacked_tile(0);
     overtile16(framebuf,0,48,ypos+17,(save_num%3)+10,0);               //link
     newtilebuf[0].format=holdformat;
     newtilebuf[0].data = hold;
+    invalidate_unpacked_tile(0);
     
     hold = colordata;
     colordata = saves[save_num].pal;
@@ -2651,7 +2654,7 @@ static bool register_name()
         
         if(ret==qe_OK)
         {
-            flushItemCache();
+            verifyItems();
             //messy hack to get this to work, since game is not yet initialized -DD
             gamedata *oldgame = game;
             game = saves+s;
@@ -2771,13 +2774,18 @@ static int get_quest_info(zquestheader *header,char *str)
     // default error
     strcpy(str,"Error: Invalid quest file");
     
-    char tmpfilename[32];
-    temp_name(tmpfilename);
     int ret;
     PACKFILE *f;
+    byte *srcdata = NULL, *decoded = NULL;
+    long srcsize = 0, decoded_size = 0;
     
     const char *passwd = datapwd;
-    ret = decode_file_007(qstpath, tmpfilename, ENC_STR, ENC_METHOD_MAX-1, strstr(qstpath, ".dat#")!=NULL, passwd);
+    ret = read_file_007(qstpath, strstr(qstpath, ".dat#")!=NULL, passwd, &srcdata, &srcsize);
+    
+    if(!ret)
+    {
+        ret = decode_buf_007(srcdata, srcsize, ENC_STR, ENC_METHOD_MAX-1, &decoded, &decoded_size);
+    }
     
     if(ret)
     {
@@ -2790,27 +2798,26 @@ static int get_quest_info(zquestheader *header,char *str)
         case 2:
             strcpy(str,"Internal error occurred");
             break;
-            // be sure not to delete tmpfilename now...
         }
         
         if(ret==5)                                              //old encryption?
         {
-            ret = decode_file_007(qstpath, tmpfilename, ENC_STR, ENC_METHOD_211B9, strstr(qstpath, ".dat#")!=NULL,passwd);
+            ret = decode_buf_007(srcdata, srcsize, ENC_STR, ENC_METHOD_211B9, &decoded, &decoded_size);
         }
         
         if(ret==5)                                              //old encryption?
         {
-            ret = decode_file_007(qstpath, tmpfilename, ENC_STR, ENC_METHOD_192B185, strstr(qstpath, ".dat#")!=NULL,passwd);
+            ret = decode_buf_007(srcdata, srcsize, ENC_STR, ENC_METHOD_192B185, &decoded, &decoded_size);
         }
         
         if(ret==5)                                              //old encryption?
         {
-            ret = decode_file_007(qstpath, tmpfilename, ENC_STR, ENC_METHOD_192B105, strstr(qstpath, ".dat#")!=NULL,passwd);
+            ret = decode_buf_007(srcdata, srcsize, ENC_STR, ENC_METHOD_192B105, &decoded, &decoded_size);
         }
         
         if(ret==5)                                              //old encryption?
         {
-            ret = decode_file_007(qstpath, tmpfilename, ENC_STR, ENC_METHOD_192B104, strstr(qstpath, ".dat#")!=NULL,passwd);
+            ret = decode_buf_007(srcdata, srcsize, ENC_STR, ENC_METHOD_192B104, &decoded, &decoded_size);
         }
         
         if(ret)
@@ -2820,36 +2827,36 @@ static int get_quest_info(zquestheader *header,char *str)
         }
     }
     
-    f = pack_fopen_password(oldquest ? qstpath : tmpfilename, F_READ_PACKED, passwd);
+    zc_free(srcdata);
     
-    if(!f)
+    if(oldquest)
     {
-        if(!oldquest&&(errno==EDOM))
+        f = pack_fopen_password(qstpath, F_READ_PACKED, passwd);
+    }
+    else
+    {
+        f = pack_fopen_decoded(decoded, decoded_size, true, passwd);
+        
+        if(!f && errno==EDOM)
         {
-            f = pack_fopen_password(oldquest ? qstpath : tmpfilename, F_READ, passwd);
+            f = pack_fopen_decoded(decoded, decoded_size, false, passwd);
         }
         
         if(!f)
         {
-            delete_file(tmpfilename);
+            zc_free(decoded);
         }
-        
+    }
+    
+    if(!f)
+    {
         strcpy(str,"Error: Unable to open file");
 //	setPackfilePassword(NULL);
         return 0;
     }
     
     ret=readheader(f, header, true);
-    
-    if(f)
-    {
-        pack_fclose(f);
-    }
-    
-    if(!oldquest)
-    {
-        delete_file(tmpfilename);
-    }
+    pack_fclose(f);
     
 //  setPackfilePassword(NULL);
 
@@ -2917,7 +2924,7 @@ bool load_custom_game(int file)
             load_quest(saves+file);
             
             saves[file].set_maxlife(zinit.hc*HP_PER_HEART);
-            flushItemCache();
+            verifyItems();
             
             //messy hack to get this to work properly since game is not initialized -DD
             gamedata *oldgame = game;
@@ -3530,7 +3537,7 @@ void game_over(int type)
             saves[currgame]=*game;
             
             int ring=0;
-            flushItemCache();
+            verifyItems();
             ItemDefinitionRef maxringid = curQuest->getHighestLevelOfFamily(game, itype_ring);
             
             if(curQuest->isValid(maxringid))
@@ -3563,7 +3570,7 @@ void save_game(bool savepoint)
     saves[currgame]=*game;
     
     int ring=0;
-    flushItemCache();
+    verifyItems();
     ItemDefinitionRef maxringid = curQuest->getHighestLevelOfFamily(game, itype_ring);
     
     if(curQuest->isValid(maxringid))
@@ -3690,7 +3697,7 @@ bool save_game(bool savepoint, int type)
                 saves[currgame]=*game;
                 
                 int ring=0;
-                flushItemCache();
+                verifyItems();
                 ItemDefinitionRef maxringid = curQuest->getHighestLevelOfFamily(game, itype_ring);
                 
                 if(curQuest->isValid(maxringid))
@@ -3850,9 +3857,11 @@ static void list_saves2()
     byte holdformat=newtilebuf[0].format;
     newtilebuf[0].format=tf4Bit;
     newtilebuf[0].data = saves[listpos+i].icon;
+    invalidate_unpacked_tile(0);
     overtile16(framebuf,0,48,i*24+73,i+10,0);               //link
     newtilebuf[0].format=holdformat;
     newtilebuf[0].data = hold;
+    invalidate_unpacked_tile(0);
 
     hold = colordata;
     colordata = saves[listpos+i].pal;
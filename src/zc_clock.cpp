@@ -0,0 +1,38 @@
+#include "precompiled.h" //always first
+
+#include "zc_clock.h"
+#include "zc_alleg.h"
+
+#if defined(ALLEGRO_WINDOWS)
+// winalleg.h is already included by zc_alleg.h
+#elif defined(ALLEGRO_MACOSX)
+#include <mach/mach_time.h>
+#else
+#include <time.h>
+#endif
+
+unsigned long long zc_clock_usec()
+{
+#if defined(ALLEGRO_WINDOWS)
+    static LARGE_INTEGER freq;
+    
+    if(freq.QuadPart == 0)
+        QueryPerformanceFrequency(&freq);
+        
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return (unsigned long long)(now.QuadPart / freq.QuadPart) * 1000000
+           + (unsigned long long)(now.QuadPart % freq.QuadPart) * 1000000 / freq.QuadPart;
+#elif defined(ALLEGRO_MACOSX)
+    static mach_timebase_info_data_t tb;
+    
+    if(tb.denom == 0)
+        mach_timebase_info(&tb);
+        
+    return mach_absolute_time() * tb.numer / tb.denom / 1000;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
@@ -0,0 +1,8 @@
+#ifndef _ZC_CLOCK_H_
+#define _ZC_CLOCK_H_
+
+// Microseconds since some arbitrary point. Never goes backwards, unlike
+// the wall clock, so it's safe for measuring intervals.
+unsigned long long zc_clock_usec();
+
+#endif
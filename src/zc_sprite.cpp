@@ -107,6 +107,7 @@ void movingblock::push(fix bx,fix by,int d2,int f)
     bcombo =  tmpscr->data[(int(y)&0xF0)+(int(x)>>4)];
     oldcset = tmpscr->cset[(int(y)&0xF0)+(int(x)>>4)];
     cs     = (isdungeon() && !get_bit(quest_rules, qr_PUSHBLOCKCSETFIX)) ? 9 : oldcset;
+    sync_combo_animation(bcombo);
     tile = combobuf[bcombo].tile;
     flip = combobuf[bcombo].flip;
     //   cs = ((*di)&0x700)>>8;
@@ -136,6 +137,7 @@ bool movingblock::animate(int index)
         
         tmpscr->data[(int(y)&0xF0)+(int(x)>>4)]=bcombo;
         tmpscr->cset[(int(y)&0xF0)+(int(x)>>4)]=oldcset;
+        screencombos_changed();
         
         if((f1==mfBLOCKTRIGGER)||f2==mfBLOCKTRIGGER)
         {
@@ -156,6 +158,7 @@ bool movingblock::animate(int index)
         if((f1==mfBLOCKHOLE)||f2==mfBLOCKHOLE)
         {
             tmpscr->data[(int(y)&0xF0)+(int(x)>>4)]+=1;
+            screencombos_changed();
             bhole=true;
             //tmpscr->cset[(int(y)&0xF0)+(int(x)>>4)]=;
         }
@@ -53,6 +53,8 @@
 #include "mem_debug.h"
 #include "zconsole.h"
 #include "backend/AllBackends.h"
+#include "benchmark.h"
+#include "profiler.h"
 
 int d_stringloader(int msg,DIALOG *d,int c);
 
@@ -64,6 +66,7 @@ byte use_dwm_flush;
 byte use_save_indicator;
 byte midi_patch_fix;
 bool midi_paused=false;
+static bool ShowProfiler=false;
 
 int virtualScreenScale();
 int miniscreenX();
@@ -327,6 +330,7 @@ void load_game_configs()
     NESquit = get_config_int(cfg_sect,"fastquit",0)!=0;
     ClickToFreeze = get_config_int(cfg_sect,"clicktofreeze",1)!=0;
     title_version = get_config_int(cfg_sect,"title",2);
+    sprite_list::setLimit(vbound(get_config_int(cfg_sect,"sprite_limit",SLMAX),255,65535));
     
     //screen_scale = get_config_int(cfg_sect,"screen_scale",2);
     
@@ -454,6 +458,7 @@ void save_game_configs()
     set_config_int(cfg_sect,"fastquit",(int)NESquit);
     set_config_int(cfg_sect,"clicktofreeze", (int)ClickToFreeze);
     set_config_int(cfg_sect,"title",title_version);
+    set_config_int(cfg_sect,"sprite_limit",sprite_list::Limit());
     
     set_config_int(cfg_sect,"scanlines",scanlines);
     set_config_int(cfg_sect,"load_last",loadlast);
@@ -515,7 +520,7 @@ void show_fps(BITMAP *target)
     char buf[50];
     
     //  text_mode(-1);
-    sprintf(buf,"%2d/60",Backend::graphics->getLastFPS());
+    sprintf(buf,"%2d/60",Backend::graphics->getFrameStats().fps);
     
     //  sprintf(buf,"%d/%u/%f/%u",lastfps,int(avgfps),avgfps,fps_secs);
     for(int i=0; buf[i]!=0; i++)
@@ -1944,12 +1949,9 @@ int currentItemLevel(int item_type)           //item currently being used
     return currentItemLevel(item_type, true);
 }
 
-std::map<int, ItemDefinitionRef> itemcache;
-
-void flushItemCache()
+// Called whenever items are gained or lost, or item definitions change
+void verifyItems()
 {
-    itemcache.clear();
-    
     //also fix the active subscreen if items were deleted -DD
     if(game != NULL)
     {
@@ -1961,40 +1963,29 @@ void flushItemCache()
 // This is used often, so it should be as direct as possible.
 ItemDefinitionRef current_item_id(int itemtype, bool checkmagic)
 {
-    if(itemtype!=itype_ring)  // Rings must always be checked.
-    {
-        std::map<int,ItemDefinitionRef>::iterator res = itemcache.find(itemtype);
+    if(itemtype<0 || itemtype>255)
+        return ItemDefinitionRef();
         
-        if(res != itemcache.end())
-            return res->second;
-    }
+    const std::vector<ItemDefinitionRef> &items = game->get_family_items(itemtype);
     
-    ItemDefinitionRef result;
-    int highestlevel = -1;
-
-    for(std::set<ItemDefinitionRef>::iterator it = game->inventoryItems.begin(); it != game->inventoryItems.end(); ++it)
+    // Highest level first
+    for(size_t i=items.size(); i-- > 0;)
     {
-        if(curQuest->getItemDefinition(*it).family==itemtype && !game->get_disabled_item(*it))
-        {
-            if((checkmagic || itemtype == itype_ring) && itemtype != itype_magicring)
-            {
-                //printf("Checkmagic for %d: %d (%d %d)\n",i,checkmagiccost(i),itemsbuf[i].magic*game->get_magicdrainrate(),game->get_magic());
-                if(!checkmagiccost(*it))
-                {
-                    continue;
-                }
-            }
+        if(game->get_disabled_item(items[i]))
+            continue;
             
-            if(curQuest->getItemDefinition(*it).fam_type >= highestlevel)
+        if((checkmagic || itemtype == itype_ring) && itemtype != itype_magicring)
+        {
+            if(!checkmagiccost(items[i]))
             {
-                highestlevel = curQuest->getItemDefinition(*it).fam_type;
-                result=*it;
+                continue;
             }
         }
+        
+        return items[i];
     }
     
-    itemcache[itemtype] = result;
-    return result;
+    return ItemDefinitionRef();
 }
 
 int current_item_power(int itemtype)
@@ -3267,6 +3258,7 @@ void draw_fuzzy(int fuzz)
 
 void updatescr(bool allowwavy)
 {
+    ProfileScope prof(PROF_UPDATESCR);
     static BITMAP *wavybuf = create_bitmap_ex(8,256,224);
     static BITMAP *panorama = create_bitmap_ex(8,256,224);
         
@@ -3307,15 +3299,7 @@ void updatescr(bool allowwavy)
         RAMpal[254] = _RGB(63,63,63);
         Backend::palette->setPalette(RAMpal);
         
-        create_rgb_table(&rgb_table, RAMpal, NULL);
-        create_zc_trans_table(&trans_table, RAMpal, 128, 128, 128);
-        memcpy(&trans_table2, &trans_table, sizeof(COLOR_MAP));
-        
-        for(int q=0; q<PAL_SIZE; q++)
-        {
-            trans_table2.data[0][q] = q;
-            trans_table2.data[q][q] = q;
-        }
+        refresh_color_tables(RAMpal);
     }
     
     if(details)
@@ -3360,29 +3344,22 @@ void updatescr(bool allowwavy)
     //TODO: Optimize blit 'overcalls' -Gleeok
     BITMAP *source = nosubscr ? panorama : wavybuf;
     
-    static BITMAP *scanlinesbmp=NULL;
-         
     const int sx = 256 * virtualScreenScale();
     const int sy = 224 * virtualScreenScale();
     const int scale_mul = virtualScreenScale() - 1;
     const int mx = scale_mul * 128;
     const int my = scale_mul * 112;
     
-    if(scanlines)
-    {
-        if(!scanlinesbmp)
-            scanlinesbmp = create_bitmap_ex(8, sx, sy);
-                
-        stretch_blit(source, scanlinesbmp, 0, 0, 256, 224, 0, 0, sx, sy);
-            
-        for(int i=0; i<224; ++i)
-            _allegro_hline(scanlinesbmp, 0, (i*virtualScreenScale())+1, sx, BLACK);
-                
-        blit(scanlinesbmp, screen, 0, 0, miniscreenX()+32-mx, miniscreenY()+8-my, sx, sy);
-    }
-    else
+    // Magnify and add scanlines in one pass, straight onto the screen
+    if(!blitIntegerScaled(source, screen, 0, 0, 256, 224, miniscreenX()+32-mx, miniscreenY()+8-my, virtualScreenScale(), scanlines ? BLACK : -1))
     {
         stretch_blit(source, screen, 0, 0, 256, 224, miniscreenX()+32-mx, miniscreenY()+8-my, sx, sy);
+        
+        if(scanlines)
+        {
+            for(int i=0; i*virtualScreenScale()+1<sy; ++i)
+                hline(screen, miniscreenX()+32-mx, miniscreenY()+8-my+(i*virtualScreenScale())+1, miniscreenX()+32-mx+sx-1, BLACK);
+        }
     }
         
     if(quakeclk>0)
@@ -3396,6 +3373,9 @@ void updatescr(bool allowwavy)
     if(ShowFPS)
         show_fps(screen);
         
+    if(ShowProfiler)
+        profile_draw(screen, 0, 0);
+        
     if(Paused)
         show_paused(screen);
         
@@ -4237,6 +4217,14 @@ void advanceframe(bool allowwavy, bool sfxcleanup)
     
 #endif
     
+    profile_next_frame();
+    
+    if(benchmark_frame())
+    {
+        benchmark_finish(framebuf, RAMpal);
+        Quit=qEXIT;
+    }
+    
     //textprintf_ex(screen,font,0,72,254,BLACK,"%d %d", lastentrance, lastentrance_dmap);
     if (sfxcleanup)
         Backend::sfx->garbageCollect();
@@ -4560,6 +4548,35 @@ int onDebugConsole()
 	}
 }
 
+int onShowProfiler()
+{
+    ShowProfiler = !ShowProfiler;
+    return D_O_K;
+}
+
+int onSaveProfile()
+{
+    char buf[40];
+    int num=0;
+    
+    do
+    {
+#ifdef ALLEGRO_MACOSX
+        sprintf(buf, "../../../profile%03d.csv", ++num);
+#else
+        sprintf(buf, "profile%03d.csv", ++num);
+#endif
+    }
+    while(num<999 && exists(buf));
+    
+    if(profile_save_csv(buf))
+        jwin_alert("Frame Profile","Saved frame timings to",buf,NULL,"OK",NULL,13,27,lfont);
+    else
+        jwin_alert("Frame Profile","Couldn't write",buf,NULL,"OK",NULL,13,27,lfont);
+        
+    return D_O_K;
+}
+
 int onFrameSkip()
 {
     FrameSkip = !FrameSkip;
@@ -6525,6 +6542,9 @@ static MENU misc_menu[] =
     { (char *)"Take &Snapshot\tF12",        onSnapshot,              NULL,                      0, NULL },
     { (char *)"Sc&reen Saver...",           onScreenSaver,           NULL,                      0, NULL },
     { (char *)"Show Debug Console",           onDebugConsole,           NULL,                      0, NULL },
+    { (char *)"",                           NULL,                    NULL,                      0, NULL },
+    { (char *)"Show Frame &Profiler",       onShowProfiler,          NULL,                      0, NULL },
+    { (char *)"Save Frame Pro&file",        onSaveProfile,           NULL,                      0, NULL },
     { NULL,                                 NULL,                    NULL,                      0, NULL }
 };
 
@@ -7283,6 +7303,7 @@ void System()
     game_menu[3].flags =
         misc_menu[5].flags = Playing ? 0 : D_DISABLED;
     misc_menu[7].flags = !Playing ? 0 : D_DISABLED;
+    misc_menu[13].flags = ShowProfiler ? D_SELECTED : 0;
     
     clear_keybuf();
     
@@ -7577,6 +7598,32 @@ void jukebox(int index)
     jukebox(index,tunes[index].loop);
 }
 
+// Starts loading the enhanced music of DMaps the current screen warps to,
+// so changing DMaps doesn't stall on opening the file.
+void prefetch_DmapMusic()
+{
+    for(int i=0; i<8; i++)
+    {
+        int dmap = i<4 ? tmpscr->tilewarpdmap[i] : tmpscr->sidewarpdmap[i-4];
+        
+        if(dmap==currdmap || dmap>=MAXDMAPS || DMaps[dmap].tmusic[0]==0)
+            continue;
+            
+        if(zcmusic!=NULL && strcmp(zcmusic->filename,DMaps[dmap].tmusic)==0)
+            continue;
+            
+        // Same search order as play_DmapMusic()
+        char exepath[2048];
+        char musicpath[2048];
+        get_executable_name(exepath, 2048);
+        replace_filename(musicpath, exepath, DMaps[dmap].tmusic, 2048);
+        zcmusic_prefetch(musicpath);
+        replace_filename(musicpath, qstpath, DMaps[dmap].tmusic, 2048);
+        zcmusic_prefetch(musicpath);
+        return;
+    }
+}
+
 void play_DmapMusic()
 {
     static char tfile[2048];
@@ -7864,6 +7911,8 @@ void load_control_state()
         control_state[17]= STICK_2_X.pos - js_stick_2_x_offset > STICK_PRECISION;
     }
     
+    replay_control_state(control_state, 18);
+    
     button_press[0]=rButton(Up,button_hold[0]);
     button_press[1]=rButton(Down,button_hold[1]);
     button_press[2]=rButton(Left,button_hold[2]);
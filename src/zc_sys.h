@@ -166,6 +166,7 @@ bool try_zcmusic(char *filename, int track, int midi);
 void jukebox(int index);
 void jukebox(int index,int loop);
 void play_DmapMusic();
+void prefetch_DmapMusic();
 void music_pause();
 void music_resume();
 void music_stop();
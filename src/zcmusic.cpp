@@ -20,6 +20,7 @@
 #include "zcmusic.h"
 #include "zc_malloc.h"
 #include "mutex.h"
+#include "thread.h"
 
 #undef	int8_t
 #undef	uint8_t
@@ -95,6 +96,101 @@ typedef struct GMEFILE : public ZCMUSICBASE
 static std::vector<ZCMUSIC*> playlist;                      //yeah, I'm too lazy to do it myself
 static int libflags = 0;
 
+// Streams are polled, and their files read, on this thread so the game
+// loop never waits on the disk or a decoder. If it can't be started, the
+// old Allegro timer callback is used instead.
+#define ZCM_STREAM_MSEC 10                                  // ~ the old timer + per-frame poll rate
+static zc_thread *streamthread = NULL;
+static volatile bool streamquit = false;
+
+// Files opened ahead of time by zcmusic_prefetch(), along with the first
+// chunk of data, so loading them later doesn't touch the disk.
+#define ZCM_PREFETCH_SLOTS 2
+
+enum { PREFETCH_EMPTY, PREFETCH_REQUESTED, PREFETCH_READY };
+
+typedef struct PREFETCH
+{
+    int state;
+    char fname[2048];
+    PACKFILE *f;
+    char *data;
+    int len;
+} PREFETCH;
+
+static PREFETCH prefetch[ZCM_PREFETCH_SLOTS];
+static int nextprefetch = 0;
+mutex prefetchmutex;
+
+// Music files are opened through stdio rather than pack_fopen(), which picks
+// up Allegro's global packfile password. The main thread sets that while
+// loading a quest, and the stream thread mustn't race with it.
+static int stdio_fclose(void *userdata)
+{
+    return fclose((FILE *)userdata);
+}
+
+static int stdio_getc(void *userdata)
+{
+    return fgetc((FILE *)userdata);
+}
+
+static int stdio_ungetc(int c, void *userdata)
+{
+    return ungetc(c, (FILE *)userdata);
+}
+
+static long stdio_fread(void *p, long n, void *userdata)
+{
+    return (long)fread(p, 1, n, (FILE *)userdata);
+}
+
+static int stdio_putc(int c, void *userdata)
+{
+    return fputc(c, (FILE *)userdata);
+}
+
+static long stdio_fwrite(AL_CONST void *p, long n, void *userdata)
+{
+    return (long)fwrite(p, 1, n, (FILE *)userdata);
+}
+
+static int stdio_fseek(void *userdata, int offset)
+{
+    return fseek((FILE *)userdata, offset, SEEK_CUR);
+}
+
+static int stdio_feof(void *userdata)
+{
+    return feof((FILE *)userdata);
+}
+
+static int stdio_ferror(void *userdata)
+{
+    return ferror((FILE *)userdata);
+}
+
+static PACKFILE_VTABLE stdio_vtable =
+{
+    stdio_fclose, stdio_getc, stdio_ungetc, stdio_fread, stdio_putc,
+    stdio_fwrite, stdio_fseek, stdio_feof, stdio_ferror
+};
+
+static PACKFILE *open_music_file(const char *filename)
+{
+    FILE *fp = fopen(filename, "rb");
+    
+    if(!fp)
+        return NULL;
+        
+    PACKFILE *f = pack_fopen_vtable(&stdio_vtable, fp);
+    
+    if(!f)
+        fclose(fp);
+        
+    return f;
+}
+
 // forward declarations
 OGGFILE *load_ogg_file(char *filename);
 int poll_ogg_file(OGGFILE *ogg);
@@ -117,6 +213,12 @@ int poll_gme_file(GMEFILE *gme);
 int unload_gme_file(GMEFILE* gme);
 int gme_play(GMEFILE *gme, int vol);
 
+static bool poll_playlist(int flags);
+static void stream_thread(void *);
+static void clear_prefetch(PREFETCH *pf);
+static void service_prefetch();
+static bool take_prefetched(char *filename, PACKFILE **f, char *data, int *len);
+
 
 extern "C"
 {
@@ -151,7 +253,7 @@ extern "C"
 
     void zcmusic_autopoll()
     {
-        zcmusic_poll();
+        poll_playlist(-1);
     }
     
     bool zcmusic_init(int flags)                              /* = -1 */
@@ -181,69 +283,242 @@ extern "C"
         }
         
         mutex_init(&playlistmutex);
+        mutex_init(&prefetchmutex);
+        
+        streamquit = false;
+        streamthread = thread_start(stream_thread, NULL);
         
-        install_int_ex(zcmusic_autopoll, MSEC_TO_TIMER(25));
+        if(!streamthread)
+            install_int_ex(zcmusic_autopoll, MSEC_TO_TIMER(25));
+            
         return true;
     }
     
     bool zcmusic_poll(int flags)                              /* = -1 */
     {
-        //lock mutex
-        mutex_lock(&playlistmutex);
-        //do all kinds of gymnastics to get around Allegro stupidity
+        // The streaming thread already keeps everything fed
+        if(streamthread)
+            return true;
+            
+        return poll_playlist(flags);
+    }
+    
+    void zcmusic_prefetch(char *filename)
+    {
+        // Only OGG and MP3 are streamed from disk; the other formats are
+        // read in full by their own loaders.
+        if(filename == NULL || !streamthread || strlen(filename) >= 2048)
+            return;
+            
+        char *ext=get_extension(filename);
+        
+        if(!((stricmp(ext,"ogg")==0 && (libflags & ZCMF_OGG)) ||
+             (stricmp(ext,"mp3")==0 && (libflags & ZCMF_MP3))))
+            return;
+            
+        mutex_lock(&prefetchmutex);
+        
+        for(int i=0; i<ZCM_PREFETCH_SLOTS; i++)
+        {
+            if(prefetch[i].state != PREFETCH_EMPTY && strcmp(prefetch[i].fname, filename)==0)
+            {
+                mutex_unlock(&prefetchmutex);
+                return;
+            }
+        }
+        
+        PREFETCH *pf = &prefetch[nextprefetch];
+        nextprefetch = (nextprefetch+1) % ZCM_PREFETCH_SLOTS;
+        clear_prefetch(pf);
+        strcpy(pf->fname, filename);
+        pf->state = PREFETCH_REQUESTED;
+        mutex_unlock(&prefetchmutex);
+    }
+}                                                           // extern "C"
+
+static void stream_thread(void *)
+{
+    while(!streamquit)
+    {
+        poll_playlist(-1);
+        service_prefetch();
+        rest(ZCM_STREAM_MSEC);
+    }
+}
+
+static void clear_prefetch(PREFETCH *pf)
+{
+    // prefetchmutex must be held
+    if(pf->f)
+        pack_fclose(pf->f);
+        
+    delete[] pf->data;
+    pf->f = NULL;
+    pf->data = NULL;
+    pf->len = 0;
+    pf->state = PREFETCH_EMPTY;
+}
+
+static void service_prefetch()
+{
+    for(int i=0; i<ZCM_PREFETCH_SLOTS; i++)
+    {
+        char fname[2048];
+        
+        mutex_lock(&prefetchmutex);
+        
+        if(prefetch[i].state != PREFETCH_REQUESTED)
+        {
+            mutex_unlock(&prefetchmutex);
+            continue;
+        }
+        
+        strcpy(fname, prefetch[i].fname);
+        mutex_unlock(&prefetchmutex);
+        
+        // Do the actual I/O without holding the lock
+        char *data = new char[(zcmusic_bufsz_private*512)];
+        int len = 0;
+        PACKFILE *f = open_music_file(fname);
+        
+        if(f && (len = pack_fread(data, (zcmusic_bufsz_private*512), f)) <= 0)
+        {
+            pack_fclose(f);
+            f = NULL;
+        }
+        
+        mutex_lock(&prefetchmutex);
+        
+        // The request may have been replaced while the file was read
+        if(f && prefetch[i].state == PREFETCH_REQUESTED && strcmp(prefetch[i].fname, fname)==0)
+        {
+            prefetch[i].f = f;
+            prefetch[i].data = data;
+            prefetch[i].len = len;
+            prefetch[i].state = PREFETCH_READY;
+            f = NULL;
+            data = NULL;
+        }
+        else if(!f && prefetch[i].state == PREFETCH_REQUESTED && strcmp(prefetch[i].fname, fname)==0)
+        {
+            prefetch[i].state = PREFETCH_EMPTY;
+        }
+        
+        mutex_unlock(&prefetchmutex);
+        
+        if(f)
+            pack_fclose(f);
+            
+        delete[] data;
+    }
+}
+
+// Hands over a prefetched file, positioned just past the first chunk,
+// which is copied into data. Returns false if filename wasn't prefetched.
+static bool take_prefetched(char *filename, PACKFILE **f, char *data, int *len)
+{
+    if(!streamthread)
+        return false;
+        
+    bool found = false;
+    mutex_lock(&prefetchmutex);
+    
+    for(int i=0; i<ZCM_PREFETCH_SLOTS; i++)
+    {
+        if(prefetch[i].state == PREFETCH_READY && strcmp(prefetch[i].fname, filename)==0)
+        {
+            *f = prefetch[i].f;
+            *len = prefetch[i].len;
+            memcpy(data, prefetch[i].data, prefetch[i].len);
+            prefetch[i].f = NULL;
+            clear_prefetch(&prefetch[i]);
+            found = true;
+            break;
+        }
+    }
+    
+    mutex_unlock(&prefetchmutex);
+    return found;
+}
+
+static bool poll_playlist(int flags)
+{
+    //lock mutex
+    mutex_lock(&playlistmutex);
+    //do all kinds of gymnastics to get around Allegro stupidity
 //	char *oldpwd = getCurPackfilePassword();
 //	setPackfilePassword(NULL);
-        std::vector<ZCMUSIC*>::iterator b = playlist.begin();
-        
-        while(b != playlist.end())
+    std::vector<ZCMUSIC*>::iterator b = playlist.begin();
+    
+    while(b != playlist.end())
+    {
+        switch((*b)->playing)
         {
-            switch((*b)->playing)
+        case ZCM_STOPPED:
+            // if it has stopped, remove it from playlist;
+            b = playlist.erase(b);
+            break;
+            
+        case ZCM_PLAYING:
+            (*b)->position++;
+            
+            switch((*b)->type & flags & libflags)             // only poll those specified by 'flags'
             {
-            case ZCM_STOPPED:
-                // if it has stopped, remove it from playlist;
-                b = playlist.erase(b);
+            case ZCMF_DUH:
+                if(((DUHFILE*)*b)->p)
+                    al_poll_duh(((DUHFILE*)*b)->p);
+                    
                 break;
                 
-            case ZCM_PLAYING:
-                (*b)->position++;
+            case ZCMF_OGG:
+                poll_ogg_file((OGGFILE*)*b);
+                break;
                 
-                switch((*b)->type & flags & libflags)             // only poll those specified by 'flags'
-                {
-                case ZCMF_DUH:
-                    if(((DUHFILE*)*b)->p)
-                        al_poll_duh(((DUHFILE*)*b)->p);
-                        
-                    break;
-                    
-                case ZCMF_OGG:
-                    poll_ogg_file((OGGFILE*)*b);
-                    break;
-                    
-                case ZCMF_MP3:
-                    poll_mp3_file((MP3FILE*)*b);
-                    break;
-                    
-                case ZCMF_GME:
-                    if(((GMEFILE*)*b)->emu)
-                        poll_gme_file((GMEFILE*)*b);
-                        
-                    break;
-                }
+            case ZCMF_MP3:
+                poll_mp3_file((MP3FILE*)*b);
+                break;
                 
-            case ZCM_PAUSED:
-                b++;
+            case ZCMF_GME:
+                if(((GMEFILE*)*b)->emu)
+                    poll_gme_file((GMEFILE*)*b);
+                    
+                break;
             }
+            
+        case ZCM_PAUSED:
+            b++;
         }
-        
-        mutex_unlock(&playlistmutex);
+    }
+    
+    mutex_unlock(&playlistmutex);
 //	setPackfilePassword(oldpwd);
 //	if(oldpwd != NULL)
 //		delete[] oldpwd;
-        return true;
-    }
-    
+    return true;
+}
+
+extern "C"
+{
     void zcmusic_exit()
     {
+        if(streamthread)
+        {
+            streamquit = true;
+            thread_join(streamthread);
+            streamthread = NULL;
+        }
+        else
+        {
+            remove_int(zcmusic_autopoll);
+        }
+        
+        mutex_lock(&prefetchmutex);
+        
+        for(int i=0; i<ZCM_PREFETCH_SLOTS; i++)
+            clear_prefetch(&prefetch[i]);
+            
+        mutex_unlock(&prefetchmutex);
+        
         //lock mutex
         mutex_lock(&playlistmutex);
         std::vector<ZCMUSIC*>::iterator b = playlist.begin();
@@ -827,11 +1102,14 @@ MP3FILE *load_mp3_file(char *filename)
     if((p = (MP3FILE *)zc_malloc(sizeof(MP3FILE)))==NULL)
         goto error;
         
-    if((f = pack_fopen_password(filename, F_READ,""))==NULL)
-        goto error;
-    
-    if((len = pack_fread(data, (zcmusic_bufsz_private*512), f)) <= 0)
-        goto error;
+    if(!take_prefetched(filename, &f, data, &len))
+    {
+        if((f = open_music_file(filename))==NULL)
+            goto error;
+            
+        if((len = pack_fread(data, (zcmusic_bufsz_private*512), f)) <= 0)
+            goto error;
+    }
     
     if(len < (zcmusic_bufsz_private*512))
     {
@@ -1024,14 +1302,17 @@ OGGFILE *load_ogg_file(char *filename)
         goto error;
     }
     
-    if((f = pack_fopen_password(filename, F_READ,""))==NULL)
+    if(!take_prefetched(filename, &f, data, &len))
     {
-        goto error;
-    }
-    
-    if((len = pack_fread(data, (zcmusic_bufsz_private*512), f)) <= 0)
-    {
-        goto error;
+        if((f = open_music_file(filename))==NULL)
+        {
+            goto error;
+        }
+        
+        if((len = pack_fread(data, (zcmusic_bufsz_private*512), f)) <= 0)
+        {
+            goto error;
+        }
     }
     
     if(len < (zcmusic_bufsz_private*512))
@@ -56,6 +56,11 @@ ZCM_EXTERN void zcmusic_unload_file(ZCMUSIC* &zcm);
 ZCM_EXTERN int zcmusic_get_tracks(ZCMUSIC* zcm);
 ZCM_EXTERN int zcmusic_change_track(ZCMUSIC* zcm, int tracknum);
 
+// Opens the file and reads its first chunk in the background, so a later
+// zcmusic_load_file() of the same path doesn't have to wait on the disk.
+// Only OGG and MP3 files are prefetched; other types are ignored.
+ZCM_EXTERN void zcmusic_prefetch(char *filename);
+
 #ifdef __cplusplus
 }                                                           // extern "C"
 #endif
@@ -32,6 +32,7 @@
 #include "zc_alleg.h"
 #include "zc_array.h"
 #include "quest/QuestRefs.h"
+#include "thread.h"
 #include "zc_malloc.h"
 
 #define ZELDA_VERSION       0x0251                          //version of the program
@@ -187,7 +188,9 @@ typedef unsigned short       word;                               //0-
 typedef unsigned long        dword;                              //0-             4,294,967,295  (32 bits)
 typedef unsigned long long   qword;                              //0-18,446,744,073,709,551,616  (64 bits)
 
-extern int readsize, writesize;
+// Per thread, so quest sections can be read on workers (see qst.cpp)
+extern ZC_THREAD_LOCAL int readsize;
+extern int writesize;
 extern bool fake_pack_writing;
 
 // system colors
@@ -1410,6 +1413,75 @@ struct ScreenFFCSet
 //extern ScreenFFCSet currentFFCSet;
 
 
+// Combos per screen. Maps are always 16x11 (the zcmap size fields are never
+// read from the quest).
+#define SCREEN_COMBOS 176
+
+// Fixed-capacity stand-in for the std::vectors that used to hold a screen's
+// combo data. Keeping it inline makes mapscr a flat, trivially copyable
+// struct: no heap blocks per screen, and copying a screen is a memcpy.
+// Supports the subset of the vector interface the map code uses.
+template <class T>
+struct screen_array
+{
+    T values[SCREEN_COMBOS];
+    word count;
+
+    size_t size() const
+    {
+        return count;
+    }
+    bool empty() const
+    {
+        return count==0;
+    }
+    void assign(size_t n, T value)
+    {
+        assert(n<=SCREEN_COMBOS);
+        count=0;
+        resize(n, value);
+    }
+    void resize(size_t n, T value=T())
+    {
+        assert(n<=SCREEN_COMBOS);
+        if(n>SCREEN_COMBOS)
+            n=SCREEN_COMBOS;
+        for(size_t i=count; i<n; i++)
+            values[i]=value;
+        count=(word)n;
+    }
+    T &operator[](size_t i)
+    {
+        return values[i];
+    }
+    const T &operator[](size_t i) const
+    {
+        return values[i];
+    }
+    T &at(size_t i)
+    {
+        assert(i<count);
+        return values[i];
+    }
+    const T &at(size_t i) const
+    {
+        assert(i<count);
+        return values[i];
+    }
+    T &front()
+    {
+        return values[0];
+    }
+    T *begin()
+    {
+        return values;
+    }
+    T *end()
+    {
+        return values+count;
+    }
+};
+
 struct mapscr
 {
     ItemDefinitionRef screenItem;
@@ -1532,9 +1604,9 @@ struct mapscr
 	byte secretflag[128];
 
 	// Must be last.
-	std::vector<word> data;
-	std::vector<byte> sflag;
-	std::vector<byte> cset;
+	screen_array<word> data;
+	screen_array<byte> sflag;
+	screen_array<byte> cset;
 
 	void zero_memory()
 	{
@@ -1571,7 +1643,7 @@ struct mapscr
         color = 0;
         undercombo = 0;
         catchall = 0;
-        ItemDefinitionRef catchallItem = ItemDefinitionRef();
+        catchallItem = ItemDefinitionRef();
 
         exitdir = 0;
         pattern = 0;
@@ -1641,7 +1713,7 @@ struct mapscr
         //Why doesn't ffc get to be its own class?
         //Warning: ffc refactoring in progress.
         // ---
-        dword numffc=0;
+        numff=0;
         for (int i = 0; i < NUM_FFCS; i++)
         {
             ffdata[i]=0;
@@ -1674,9 +1746,9 @@ struct mapscr
             secretflag[i]=0;
         }
         
-        data.assign(176, 0);
-		sflag.assign(176, 0);
-		cset.assign(176, 0);
+        data.assign(SCREEN_COMBOS, 0);
+		sflag.assign(SCREEN_COMBOS, 0);
+		cset.assign(SCREEN_COMBOS, 0);
 	}
 
 	mapscr()
@@ -2572,6 +2644,9 @@ struct gamedata
     //24
     std::set<ItemDefinitionRef> inventoryItems;
     std::map<ItemDefinitionRef, uint8_t> disabledItems;
+    // inventoryItems grouped by family; see get_family_items
+    std::vector<ItemDefinitionRef> familyItems[256];
+    dword familyItemsEpoch;                                 // 0 when out of date
     //280
     word _maxcounter[32];	// 0 - life, 1 - rupees, 2 - bombs, 3 - arrows, 4 - magic, 5 - keys, 6-super bombs
     word _counter[32];
@@ -2780,6 +2855,16 @@ struct gamedata
         return inventoryItems.count(id)>0;
     }
     
+    // The owned items of a family, sorted by level (fam_type). Kept up to
+    // date by set_item; rebuilt after direct changes to inventoryItems
+    // (call clear_items or invalidate_family_items) or to the quest's items.
+    const std::vector<ItemDefinitionRef> &get_family_items(byte family);
+    void invalidate_family_items()
+    {
+        familyItemsEpoch=0;
+    }
+    void clear_items();
+    
 };
 
 // "initialization data" flags (bit numbers in bit string)
@@ -3441,7 +3526,7 @@ INLINE void SCRFIX()
 //INLINE int new_return(int x) { fake_pack_writing=false; return x; }
 #define new_return(x) {assert(x == 0); fake_pack_writing = false; return x; }
 
-extern void flushItemCache();
+extern void verifyItems();
 extern void removeFromItemCache(int itemid);
 
 #define NUMSCRIPTFFC		512
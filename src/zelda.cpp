@@ -55,6 +55,8 @@
 #include "zc_array.h"
 #include "rendertarget.h"
 #include "zconsole.h"
+#include "benchmark.h"
+#include "profiler.h"
 #include "win32.h"
 #include "vectorset.h"
 #include "single_instance.h"
@@ -217,7 +219,8 @@ bool close_button_quit=false;
 PALETTE tempbombpal;
 bool usebombpal;
 
-int readsize, writesize;
+ZC_THREAD_LOCAL int readsize;
+int writesize;
 bool fake_pack_writing=false;
 combo_alias combo_aliases[MAXCOMBOALIASES];  //Temporarily here so ZC can compile. All memory from this is freed after loading the quest file.
 
@@ -312,6 +315,107 @@ std::vector<ZScriptArray> globalRAM;
 ZScriptArray localRAM[MAX_ZCARRAY_SIZE];
 byte arrayOwner[MAX_ZCARRAY_SIZE];
 
+// Free local array pointers are kept on a stack, and the pointers each owner
+// holds are chained through arrayNext/arrayPrev, so allocating and freeing an
+// FFC's arrays doesn't have to scan all of localRAM. Pointer 0 is never handed
+// out, so it doubles as the end of a chain.
+static word freeArrays[MAX_ZCARRAY_SIZE];
+static word numFreeArrays = 0;
+static bool arrayInUse[MAX_ZCARRAY_SIZE];
+static word arrayNext[MAX_ZCARRAY_SIZE];
+static word arrayPrev[MAX_ZCARRAY_SIZE];
+static word ownerArrays[256];
+
+static void resetLocalArraySlots()
+{
+    numFreeArrays = 0;
+    
+    // Pushed in reverse so the lowest pointers are handed out first
+    for(word i = MAX_ZCARRAY_SIZE-1; i > 0; i--)
+        freeArrays[numFreeArrays++] = i;
+        
+    memset(arrayInUse, 0, sizeof(arrayInUse));
+    memset(arrayNext, 0, sizeof(arrayNext));
+    memset(arrayPrev, 0, sizeof(arrayPrev));
+    memset(ownerArrays, 0, sizeof(ownerArrays));
+}
+
+word allocLocalArraySlot(byte owner)
+{
+    if(numFreeArrays == 0)
+        return 0;
+        
+    word ptr = freeArrays[--numFreeArrays];
+    arrayInUse[ptr] = true;
+    arrayOwner[ptr] = owner;
+    arrayPrev[ptr] = 0;
+    arrayNext[ptr] = ownerArrays[owner];
+    
+    if(ownerArrays[owner])
+        arrayPrev[ownerArrays[owner]] = ptr;
+        
+    ownerArrays[owner] = ptr;
+    return ptr;
+}
+
+void freeLocalArraySlot(word ptr)
+{
+    if(ptr == 0 || ptr >= MAX_ZCARRAY_SIZE || !arrayInUse[ptr])
+        return;
+        
+    byte owner = arrayOwner[ptr];
+    
+    if(arrayPrev[ptr])
+        arrayNext[arrayPrev[ptr]] = arrayNext[ptr];
+    else
+        ownerArrays[owner] = arrayNext[ptr];
+        
+    if(arrayNext[ptr])
+        arrayPrev[arrayNext[ptr]] = arrayPrev[ptr];
+        
+    arrayInUse[ptr] = false;
+    arrayNext[ptr] = arrayPrev[ptr] = 0;
+    arrayOwner[ptr] = 255;
+    freeArrays[numFreeArrays++] = ptr;
+}
+
+// Global arrays are only allocated by ~Init on first play and never freed, but
+// they come off a free stack too, so ~Init doesn't rescan globalRAM for every
+// array it allocates.
+static std::vector<dword> freeGlobalArrays;
+
+static void resetGlobalArraySlots()
+{
+    freeGlobalArrays.clear();
+    
+    // Pushed in reverse so the lowest pointers are handed out first
+    for(dword i = game->globalRAM.size(); i > 0; i--)
+    {
+        if(game->globalRAM[i-1].Size() == 0)
+            freeGlobalArrays.push_back(i-1);
+    }
+}
+
+long allocGlobalArraySlot()
+{
+    if(freeGlobalArrays.empty())
+        return -1;
+        
+    dword ptr = freeGlobalArrays.back();
+    freeGlobalArrays.pop_back();
+    return ptr;
+}
+
+word firstOwnedArray(byte owner)
+{
+    return ownerArrays[owner];
+}
+
+word nextOwnedArray(word ptr)
+{
+    return arrayNext[ptr];
+}
+
 extern sprite_list Lwpns;
 
 int LwpnsIdFirst(int id)
@@ -341,6 +445,8 @@ void initZScriptArrayRAM(bool firstplay)
         arrayOwner[i]=255;
     }
     
+    resetLocalArraySlots();
+    
     if(game->globalRAM.size() != 0)
         game->globalRAM.clear();
         
@@ -372,6 +478,8 @@ void initZScriptArrayRAM(bool firstplay)
             }
         }
     }
+    
+    resetGlobalArraySlots();
 }
 
 void initZScriptGlobalRAM()
@@ -1167,7 +1275,7 @@ void init_dmap()
 
     }
     
-    flushItemCache();
+    verifyItems();
     // also update subscreens
     update_subscreens();
     verifyBothWeapons();
@@ -1177,7 +1285,7 @@ void init_dmap()
 
 int init_game()
 {
-    srand(time(0));
+    srand(replay_seed(time(0)));
     //introclk=intropos=msgclk=msgpos=dmapmsgclk=0;
     
 //Some initialising globals
@@ -1215,11 +1323,12 @@ int init_game()
     
 //Copy saved data to RAM data (but not global arrays)
     game->Copy(saves[currgame]);
-    flushItemCache();
+    verifyItems();
     
 //Load the quest
     //setPackfilePassword(datapwd);
     int ret = load_quest(game);
+    clear_layer_cache();
     
     if(ret != qe_OK)
     {
@@ -2306,21 +2415,13 @@ void game_loop()
     // Messages also freeze FF combos.
     bool freezeff = freezemsg;
     
-    bool freeze = false;
+    bool freeze = ffcs_of_type(cSCREENFREEZE) || combos_of_type(cSCREENFREEZE);
     
-    for(int i=0; i<32; i++)
-    {
-        if(combobuf[tmpscr->ffdata[i]].type==cSCREENFREEZE) freeze=true;
+    if(ffcs_of_type(cSCREENFREEZEFF) || combos_of_type(cSCREENFREEZEFF))
+        freezeff=true;
         
-        if(combobuf[tmpscr->ffdata[i]].type==cSCREENFREEZEFF) freezeff=true;
-    }
-    
     for(int i=0; i<176; i++)
     {
-        if(combobuf[tmpscr->data[i]].type == cSCREENFREEZE) freeze=true;
-        
-        if(combobuf[tmpscr->data[i]].type == cSCREENFREEZEFF) freezeff=true;
-        
         if(guygrid[i]>0)
         {
             --guygrid[i];
@@ -2343,6 +2444,7 @@ void game_loop()
     // Arbitrary Rule 637: neither 'freeze' nor 'freezeff' freeze the global script.
     if(!freezemsg && g_doscript)
     {
+        ProfileScope prof(PROF_GLOBAL_SCRIPT);
         run_script(SCRIPT_GLOBAL, GLOBAL_SCRIPT_GAME);
     }
     
@@ -2351,7 +2453,9 @@ void game_loop()
         mblock2->animate(0);
         items.animate();
         items.check_conveyor();
+        profile_begin(PROF_ENEMIES);
         guys.animate();
+        profile_end(PROF_ENEMIES);
         roaming_item();
         dragging_item();
         Ewpns.animate();
@@ -2359,6 +2463,8 @@ void game_loop()
         
         for(int i = 0; i < (gofast ? 8 : 1); i++)
         {
+            ProfileScope prof(PROF_LINK);
+            
             if(Link->animate(0))
             {
                 if(!Quit)
@@ -2384,7 +2490,9 @@ void game_loop()
         }
         
         --conveyclk;
+        profile_begin(PROF_COLLISIONS);
         check_collisions();
+        profile_end(PROF_COLLISIONS);
         dryuplake();
         cycle_palette();
     }
@@ -2397,11 +2505,15 @@ void game_loop()
     
     if(global_wait)
     {
+        profile_begin(PROF_GLOBAL_SCRIPT);
 		run_script(SCRIPT_GLOBAL, GLOBAL_SCRIPT_GAME);
+        profile_end(PROF_GLOBAL_SCRIPT);
         global_wait=false;
     }
     
+    profile_begin(PROF_DRAW_SCREEN);
     draw_screen(tmpscr);
+    profile_end(PROF_DRAW_SCREEN);
     
     if(linkedmsgclk==1)
     {
@@ -2817,25 +2929,53 @@ int main(int argc, char* argv[])
     
 #endif
     
+    // Headless benchmark: run a saved game for a fixed number of frames
+    // without a display, sound or input devices.
+    int benchmark_arg = used_switch(argc,argv,"-benchmark");
+    int benchmark_frames = 0;
+    
+    if(benchmark_arg)
+    {
+        if(argc <= benchmark_arg+2 || (benchmark_frames = atoi(argv[benchmark_arg+1])) <= 0)
+        {
+            Z_error("-benchmark requires a frame count and an output file, e.g.\n" \
+                    "  -benchmark 3600 timings.csv -load 1 -replay run.zcr");
+        }
+        
+        Backend::graphics->setHeadless(true);
+    }
+    
+    int replay_arg = used_switch(argc,argv,"-replay");
+    int record_arg = used_switch(argc,argv,"-record");
+    
+    if(replay_arg && (argc <= replay_arg+1 || !replay_open_playback(argv[replay_arg+1])))
+    {
+        Z_error("-replay requires a replay file recorded with -record");
+    }
+    else if(record_arg && (argc <= record_arg+1 || !replay_open_record(argv[record_arg+1])))
+    {
+        Z_error("-record requires a file to write the replay to");
+    }
+    
     if(install_timer() < 0)
     {
         Z_error(allegro_error);
         quit_game();
     }
     
-    if(install_keyboard() < 0)
+    if(install_keyboard() < 0 && !benchmark_arg)
     {
         Z_error(allegro_error);
         quit_game();
     }
     
-    if(install_mouse() < 0)
+    if(install_mouse() < 0 && !benchmark_arg)
     {
         Z_error(allegro_error);
         quit_game();
     }
     
-    if(install_joystick(JOY_TYPE_AUTODETECT) < 0)
+    if(install_joystick(JOY_TYPE_AUTODETECT) < 0 && !benchmark_arg)
     {
         Z_error(allegro_error);
         quit_game();
@@ -3119,7 +3259,7 @@ int main(int argc, char* argv[])
     
     Z_message("Initializing sound driver... ");
     
-    if(used_switch(argc,argv,"-s") || used_switch(argc,argv,"-nosound"))
+    if(used_switch(argc,argv,"-s") || used_switch(argc,argv,"-nosound") || benchmark_arg)
     {
         Z_message("skipped\n");
     }
@@ -3207,7 +3347,7 @@ int main(int argc, char* argv[])
     gui_mouse_focus = FALSE;
     position_mouse(Backend::graphics->virtualScreenW()-16,Backend::graphics->virtualScreenH()-16);
     
-    if(!onlyInstance)
+    if(!onlyInstance && !benchmark_arg)
     {
         clear_to_color(screen,BLACK);
         system_pal();
@@ -3239,6 +3379,11 @@ int main(int argc, char* argv[])
     
     Z_message("OK\n");
     
+    if(benchmark_arg && (load_save < 1 || load_save > MAXSAVES || !saves[load_save-1].get_quest()))
+    {
+        Z_error("-benchmark requires a saved game to run, e.g. -load 1");
+    }
+    
 	Backend::graphics->registerSwitchCallbacks(switch_in_callback, switch_out_callback);
     
     // AG logo
@@ -3291,6 +3436,9 @@ int main(int argc, char* argv[])
         setup_combo_animations();
         setup_combo_animations2();
         
+        if(benchmark_arg && !Quit)
+            benchmark_start(benchmark_frames, argv[benchmark_arg+2]);
+            
         while(!Quit)
         {
 #ifdef _WIN32
@@ -3305,6 +3453,15 @@ int main(int argc, char* argv[])
             advanceframe(true);
         }
         
+        if(benchmark_arg)
+        {
+            // The game ended before the requested number of frames ran
+            if(benchmark_running())
+                benchmark_finish(framebuf, RAMpal);
+                
+            break;
+        }
+        
         tmpscr->flags3=0;
         Playing=Paused=false;
         
@@ -3358,9 +3515,16 @@ int main(int argc, char* argv[])
     Backend::sfx->stopAll();
     
 quick_quit:
-    show_saving(screen);
-    save_savedgames();
-    save_game_configs();
+    replay_close();
+    
+    // Benchmarks leave the save file and settings alone
+    if(!benchmark_arg)
+    {
+        show_saving(screen);
+        save_savedgames();
+        save_game_configs();
+    }
+    
 	//rest(250); // ???
     //  if(useCD)
     //    cd_exit();
@@ -312,6 +312,16 @@ typedef ZCArray<long> ZScriptArray;
 extern ZScriptArray localRAM[MAX_ZCARRAY_SIZE];
 extern byte arrayOwner[MAX_ZCARRAY_SIZE];
 
+// Local array pointer allocation. allocLocalArraySlot returns 0 when every
+// pointer is in use. Owned arrays are walked with firstOwnedArray/
+// nextOwnedArray; fetch the next pointer before freeing the current one.
+word allocLocalArraySlot(byte owner);
+void freeLocalArraySlot(word ptr);
+word firstOwnedArray(byte owner);
+word nextOwnedArray(word ptr);
+// Returns the next unallocated index into game->globalRAM, or -1 if none are left.
+long allocGlobalArraySlot();
+
 dword getNumGlobalArrays();
 
 extern bool scanlines;                                      //do scanlines if sbig==1
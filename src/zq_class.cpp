@@ -4297,6 +4297,7 @@ void zmap::update_combo_cycling()
         
         x=prvscr.data[i];
         y=animated_combo_table[x][0];
+        sync_combo_cycling(x);
         
         //time to restart
         if((animated_combo_table4[y][1]>=combobuf[x].speed) &&
@@ -4318,6 +4319,7 @@ void zmap::update_combo_cycling()
     {
         x=prvscr.data[i];
         y=animated_combo_table2[x][0];
+        sync_combo_cycling(x);
         
         //time to restart
         if((animated_combo_table24[y][1]>=combobuf[x].speed) &&
@@ -4351,6 +4353,7 @@ void zmap::update_combo_cycling()
         
         x=prvscr.ffdata[i];
         y=animated_combo_table[x][0];
+        sync_combo_cycling(x);
         
         //time to restart
         if((animated_combo_table4[y][1]>=combobuf[x].speed) &&
@@ -4372,6 +4375,7 @@ void zmap::update_combo_cycling()
     {
         x=prvscr.ffdata[i];
         y=animated_combo_table2[x][0];
+        sync_combo_cycling(x);
         
         //time to restart
         if((animated_combo_table24[y][1]>=combobuf[x].speed) &&
@@ -4412,6 +4416,7 @@ void zmap::update_combo_cycling()
                 
                 x=(prvlayers[j]).data[i];
                 y=animated_combo_table[x][0];
+                sync_combo_cycling(x);
                 
                 //time to restart
                 if((animated_combo_table4[y][1]>=combobuf[x].speed) &&
@@ -4433,6 +4438,7 @@ void zmap::update_combo_cycling()
             {
                 x=(prvlayers[j]).data[i];
                 y=animated_combo_table2[x][0];
+                sync_combo_cycling(x);
                 
                 //time to restart
                 if((animated_combo_table24[y][1]>=combobuf[x].speed) &&
@@ -4465,12 +4471,14 @@ void zmap::update_combo_cycling()
     {
         if(restartanim[i])
         {
+            sync_combo_cycling(i);
             combobuf[i].tile = animated_combo_table[i][1];
             animated_combo_table4[animated_combo_table[i][0]][1]=0;
         }
         
         if(restartanim2[i])
         {
+            sync_combo_cycling(i);
             combobuf[i].tile = animated_combo_table2[i][1];
             animated_combo_table4[animated_combo_table[i][0]][1]=0;
         }
@@ -6364,10 +6372,10 @@ int writedmaps(PACKFILE *f, word version, word build, word start_dmap, word max_
             for (uint32_t j = 0; j < numdisabled; j++)
             {
                 ItemDefinitionRef itemid = DMaps[i].disabledItems[j];
-                uint32_t len = itemid.module.length() + 1;
+                uint32_t len = itemid.moduleName().length() + 1;
                 if (!p_iputl(len, f))
                     new_return(28);
-                if (!pfwrite((void *)itemid.module.c_str(), len, f))
+                if (!pfwrite((void *)itemid.moduleName().c_str(), len, f))
                     new_return(28);
                 if (!p_iputl(itemid.slot, f))
                     new_return(28);
@@ -6718,12 +6726,12 @@ int writemisc(PACKFILE *f, zquestheader *Header, miscQdata *Misc)
             
             for(int j=0; j<3; j++)
             {
-                uint32_t modulelen = Misc->shop[i].item[j].module.length() + 1;
+                uint32_t modulelen = Misc->shop[i].item[j].moduleName().length() + 1;
                 if (!p_iputl(modulelen, f))
                 {
                     new_return(7);
                 }
-                if (!pfwrite((void *)Misc->shop[i].item[j].module.c_str(), modulelen, f))
+                if (!pfwrite((void *)Misc->shop[i].item[j].moduleName().c_str(), modulelen, f))
                 {
                     new_return(7);
                 }
@@ -7035,12 +7043,12 @@ int writeitems(PACKFILE *f, zquestheader *Header)
 
                 for (int wpn = 0; wpn < 10; wpn++)
                 {
-                    uint32_t wpnlen = itemd.wpns[wpn].module.length() + 1;
+                    uint32_t wpnlen = itemd.wpns[wpn].moduleName().length() + 1;
                     if (!p_iputl(wpnlen, f))
                     {
                         new_return(26);
                     }
-                    if (!pfwrite((void *)itemd.wpns[wpn].module.c_str(), wpnlen, f))
+                    if (!pfwrite((void *)itemd.wpns[wpn].moduleName().c_str(), wpnlen, f))
                     {
                         new_return(27);
                     }
@@ -7306,10 +7314,10 @@ int writemapscreen(PACKFILE *f, int i, int j)
         return qe_invalid;
     }
     
-    uint32_t guylen = screen.guy.module.length() + 1;
+    uint32_t guylen = screen.guy.moduleName().length() + 1;
     if (!p_iputl(guylen, f))
         return qe_invalid;
-    if (!pfwrite((void *)screen.guy.module.c_str(), guylen, f))
+    if (!pfwrite((void *)screen.guy.moduleName().c_str(), guylen, f))
         return qe_invalid;
     if(!p_iputl(screen.guy.slot,f))
     {
@@ -7328,11 +7336,11 @@ int writemapscreen(PACKFILE *f, int i, int j)
         return qe_invalid;
     }
 
-    uint32_t modulelen = 1 + screen.screenItem.module.length();
+    uint32_t modulelen = 1 + screen.screenItem.moduleName().length();
     if (!p_iputl(modulelen, f))
         return qe_invalid;
 
-    if (!pfwrite((void *)screen.screenItem.module.c_str(), modulelen, f))
+    if (!pfwrite((void *)screen.screenItem.moduleName().c_str(), modulelen, f))
         return qe_invalid;
     
     if(!p_iputl(screen.screenItem.slot,f))
@@ -7445,11 +7453,11 @@ int writemapscreen(PACKFILE *f, int i, int j)
     
     for (int k = 0; k < 10; k++)
     {
-        uint32_t modnamelen = screen.enemy[k].module.length() + 1;
+        uint32_t modnamelen = screen.enemy[k].moduleName().length() + 1;
         if (!p_iputl(modnamelen, f))
             return qe_invalid;
 
-        if (!pfwrite((void *)screen.enemy[k].module.c_str(), modnamelen, f))
+        if (!pfwrite((void *)screen.enemy[k].moduleName().c_str(), modnamelen, f))
             return qe_invalid;
 
         if (!p_iputl(screen.enemy[k].slot, f))
@@ -7530,13 +7538,13 @@ int writemapscreen(PACKFILE *f, int i, int j)
         return qe_invalid;
     }
 
-    uint32_t catchallitem_len = screen.catchallItem.module.length() + 1;
+    uint32_t catchallitem_len = screen.catchallItem.moduleName().length() + 1;
     if (!p_iputl(catchallitem_len, f))
     {
         return qe_invalid;
     }
 
-    if (!pfwrite((void *)screen.catchallItem.module.c_str(), catchallitem_len, f))
+    if (!pfwrite((void *)screen.catchallItem.moduleName().c_str(), catchallitem_len, f))
     {
         return qe_invalid;
     }
@@ -9147,12 +9155,12 @@ int writeguys(PACKFILE *f, zquestheader *Header)
                 {
                     new_return(61);
                 }
-                uint32_t len = module.enemyDefTable().getEnemyDefinition(i).wpnsprite.module.length() + 1;
+                uint32_t len = module.enemyDefTable().getEnemyDefinition(i).wpnsprite.moduleName().length() + 1;
                 if (!p_iputl(len, f))
                 {
                     new_return(62);
                 }
-                if (!pfwrite((void *)module.enemyDefTable().getEnemyDefinition(i).wpnsprite.module.c_str(), len, f))
+                if (!pfwrite((void *)module.enemyDefTable().getEnemyDefinition(i).wpnsprite.moduleName().c_str(), len, f))
                 {
                     new_return(62);
                 }
@@ -10088,12 +10096,12 @@ int writeinitdata(PACKFILE *f, zquestheader *Header)
 
         for (std::set<ItemDefinitionRef>::iterator it = zinit.inventoryItems.begin(); it != zinit.inventoryItems.end(); ++it)
         {
-            int len = it->module.length() + 1;
+            int len = it->moduleName().length() + 1;
             if (!p_iputl(len, f))
             {
                 new_return(6);
             }
-            if (!pfwrite((void *)it->module.c_str(), len, f))
+            if (!pfwrite((void *)it->moduleName().c_str(), len, f))
             {
                 new_return(7);
             }
@@ -10421,13 +10429,13 @@ int writeitemdropsets(PACKFILE *f, zquestheader *Header)
             
             for(int j=0; j<10; ++j)
             {
-                uint32_t modulelen = item_drop_sets[i].item[j].module.length() + 1;
+                uint32_t modulelen = item_drop_sets[i].item[j].moduleName().length() + 1;
                 if (!p_iputl(modulelen, f))
                 {
                     new_return(7);
                 }
 
-                if (!pfwrite((void *)item_drop_sets[i].item[j].module.c_str(), modulelen, f))
+                if (!pfwrite((void *)item_drop_sets[i].item[j].moduleName().c_str(), modulelen, f))
                 {
                     new_return(7);
                 }
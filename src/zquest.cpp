@@ -588,7 +588,8 @@ int mouse_scroll_h()
 	;
 }
 
-int readsize, writesize;
+ZC_THREAD_LOCAL int readsize;
+int writesize;
 bool fake_pack_writing=false;
 
 int showxypos_x;
@@ -781,6 +782,7 @@ int gme_track=0;
 int dlevel; // just here until gamedata is properly done
 
 bool gotoless_not_equal;  // Used by BuildVisitors.cpp
+bool optimize_zscript;  // Used by ScriptParser.cpp
 
 bool bad_version(int ver)
 {
@@ -5050,7 +5052,7 @@ void refresh(int flags)
     
     if(ShowFPS)
     {
-        textprintf_shadowed_ex(menu1,is_large()?lfont:sfont,0,prv_mode?32:16,vc(15),vc(0),-1,"FPS:%-3d",Backend::graphics->getLastFPS());
+        textprintf_shadowed_ex(menu1,is_large()?lfont:sfont,0,prv_mode?32:16,vc(15),vc(0),-1,"FPS:%-3d",Backend::graphics->getFrameStats().fps);
     }
     
     if(prv_mode)
@@ -21131,6 +21133,7 @@ int main(int argc, char **argv)
     ShowFFScripts                  = get_config_int("zquest","showffscripts",1);
     ShowSquares                    = get_config_int("zquest","showsquares",1);
     ShowInfo                       = get_config_int("zquest","showinfo",1);
+    optimize_zscript               = get_config_int("zquest","optimize_zscript",1)!=0;
     
     OpenLastQuest                  = get_config_int("zquest","open_last_quest",0);
     ShowMisalignments              = get_config_int("zquest","show_misalignments",0);
@@ -22476,6 +22479,7 @@ int save_config_file()
     set_config_int("zquest","invalid_static",InvalidStatic);
     set_config_int("zquest","tile_protection",TileProtection);
     set_config_int("zquest","showinfo",ShowInfo);
+    set_config_int("zquest","optimize_zscript",optimize_zscript?1:0);
     set_config_int("zquest","show_grid",ShowGrid);
     set_config_int("zquest","grid_color",GridColor);
     set_config_int("zquest","snapshot_format",SnapshotFormat);
@@ -22638,7 +22642,7 @@ void check_autosave()
     }
 }
 
-void flushItemCache() {}
+void verifyItems() {}
 void ringcolor(bool forceDefault)
 {
     forceDefault=forceDefault;
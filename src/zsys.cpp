@@ -896,6 +896,532 @@ error:
     return err;
 }
 
+//
+// In-memory versions of the above, so quests don't have to be decoded to a
+// temp file and read back.
+//
+
+//
+// Reads a whole (possibly datafile-packed) file into a zc_malloc'd buffer.
+// RETURNS:
+//   0 - OK
+//   1 - srcfile not opened
+//   2 - out of memory
+//
+int read_file_007(const char *srcfile, bool packed, const char *password, byte **dest, long *dest_size)
+{
+    long size = file_size_ex_password(srcfile, password);
+    
+    if(size < 1)
+    {
+        return 1;
+    }
+    
+    byte *buf = (byte *)zc_malloc(size);
+    
+    if(!buf)
+    {
+        return 2;
+    }
+    
+    long read;
+    
+    if(!packed)
+    {
+        FILE *src = fopen(srcfile, "rb");
+        
+        if(!src)
+        {
+            zc_free(buf);
+            return 1;
+        }
+        
+        read = (long)fread(buf, 1, size, src);
+        fclose(src);
+    }
+    else
+    {
+        PACKFILE *src = pack_fopen_password(srcfile, F_READ_PACKED, password);
+        
+        if(errno==EDOM)
+        {
+            src = pack_fopen_password(srcfile, F_READ, password);
+        }
+        
+        if(!src)
+        {
+            zc_free(buf);
+            return 1;
+        }
+        
+        read = pack_fread(buf, size, src);
+        pack_fclose(src);
+    }
+    
+    *dest = buf;
+    *dest_size = read;
+    return 0;
+}
+
+//
+// Same as decode_file_007, but from and to memory. On success *dest is a
+// zc_malloc'd buffer owned by the caller.
+// RETURNS:
+//   0 - OK
+//   2 - out of memory
+//   3 - src too small
+//   4 - src EOF
+//   5 - checksum mismatch
+//   6 - header mismatch
+//
+int decode_buf_007(const byte *src, long src_size, const char *header, int method, byte **dest, long *dest_size)
+{
+    const byte *si = src, *end = src + src_size;
+    int tog = 0, c, r=0;
+    long size, i;
+    short c1 = 0, c2 = 0, check1, check2;
+    
+    size = src_size - 8;                                      // get actual data size, minus key and checksums
+    
+    if(size < 1)
+    {
+        return 3;
+    }
+    
+    // read the header
+    if(header)
+    {
+        for(i=0; header[i]; i++)
+        {
+            if(si >= end)
+            {
+                return 4;
+            }
+            
+            if((*(si++)) != (header[i]&255))
+            {
+                return 6;
+            }
+            
+            --size;
+        }
+    }
+    
+    if(size < 0 || si + size + 8 > end)
+    {
+        return 4;
+    }
+    
+    // read the key
+    seed = si[0] << 24;
+    seed += si[1] << 16;
+    seed += si[2] << 8;
+    seed += si[3];
+    seed ^= enc_mask[method];
+    si += 4;
+    
+    byte *buf = (byte *)zc_malloc(zc_max(size, 1));
+    
+    if(!buf)
+    {
+        return 2;
+    }
+    
+    // decode the data
+    for(i=0; i<size; i++)
+    {
+        c = *(si++);
+        
+        if(tog)
+        {
+            c -= r;
+        }
+        else
+        {
+            r = rand_007(method);
+            c ^= r;
+        }
+        
+        tog ^= 1;
+        
+        c &= 255;
+        c1 += c;
+        c2 = (c2 << 4) + (c2 >> 12) + c;
+        
+        buf[i] = c;
+    }
+    
+    // read checksums
+    check1 = si[0] << 8;
+    check1 += si[1];
+    check2 = si[2] << 8;
+    check2 += si[3];
+    
+    // verify checksums
+    r = rand_007(method);
+    check1 ^= r;
+    check2 -= r;
+    check1 &= 0xFFFF;
+    check2 &= 0xFFFF;
+    
+    if(check1 != c1 || check2 != c2)
+    {
+        zc_free(buf);
+        return 5;
+    }
+    
+    *dest = buf;
+    *dest_size = size;
+    return 0;
+}
+
+struct memory_packfile
+{
+    byte *data;                                             // zc_malloc'd, freed on close (may be NULL)
+    byte *begin;
+    byte *pos;
+    byte *end;
+};
+
+static int memfile_fclose(void *userdata)
+{
+    memory_packfile *m = (memory_packfile *)userdata;
+    zc_free(m->data);
+    delete m;
+    return 0;
+}
+
+static int memfile_getc(void *userdata)
+{
+    memory_packfile *m = (memory_packfile *)userdata;
+    return (m->pos < m->end) ? *(m->pos++) : EOF;
+}
+
+static int memfile_ungetc(int c, void *userdata)
+{
+    memory_packfile *m = (memory_packfile *)userdata;
+    
+    if(m->pos <= m->begin || *(m->pos-1) != (byte)c)
+        return EOF;
+        
+    --m->pos;
+    return c;
+}
+
+static long memfile_fread(void *p, long n, void *userdata)
+{
+    memory_packfile *m = (memory_packfile *)userdata;
+    
+    if(n > m->end - m->pos)
+        n = m->end - m->pos;
+        
+    memcpy(p, m->pos, n);
+    m->pos += n;
+    return n;
+}
+
+static int memfile_putc(int, void *)
+{
+    return EOF;
+}
+
+static long memfile_fwrite(const void *, long, void *)
+{
+    return 0;
+}
+
+static int memfile_fseek(void *userdata, int offset)
+{
+    memory_packfile *m = (memory_packfile *)userdata;
+    
+    if(offset < 0 || offset > m->end - m->pos)
+    {
+        m->pos = m->end;
+        return -1;
+    }
+    
+    m->pos += offset;
+    return 0;
+}
+
+// Matches Allegro's own files, which flag EOF as soon as the last byte is read
+static int memfile_feof(void *userdata)
+{
+    memory_packfile *m = (memory_packfile *)userdata;
+    return m->pos >= m->end;
+}
+
+static int memfile_ferror(void *)
+{
+    return 0;
+}
+
+static PACKFILE_VTABLE memfile_vtable =
+{
+    memfile_fclose, memfile_getc, memfile_ungetc, memfile_fread, memfile_putc,
+    memfile_fwrite, memfile_fseek, memfile_feof, memfile_ferror
+};
+
+// Read-only PACKFILE over [start, start+size) inside data. On success data
+// is freed when the PACKFILE is closed; pass NULL to borrow a range of a
+// buffer that outlives the PACKFILE.
+PACKFILE *pack_fopen_memory(byte *data, byte *start, long size)
+{
+    memory_packfile *m = new memory_packfile;
+    m->data = data;
+    m->begin = start;
+    m->pos = start;
+    m->end = start + size;
+    
+    PACKFILE *f = pack_fopen_vtable(&memfile_vtable, m);
+    
+    if(!f)
+        delete m;
+        
+    return f;
+}
+
+// Exposes the read position and end of a PACKFILE opened by
+// pack_fopen_memory. Returns false for any other kind of PACKFILE.
+bool pack_memory_range(PACKFILE *f, byte **pos, byte **end)
+{
+    if(!f || f->vtable != &memfile_vtable)
+        return false;
+        
+    memory_packfile *m = (memory_packfile *)f->userdata;
+    *pos = m->pos;
+    *end = m->end;
+    return true;
+}
+
+// Takes ownership of a memory PACKFILE's buffer away from it, so that it
+// stays valid after pack_fclose. The caller must zc_free the result.
+byte *pack_memory_release(PACKFILE *f)
+{
+    if(!f || f->vtable != &memfile_vtable)
+        return NULL;
+        
+    memory_packfile *m = (memory_packfile *)f->userdata;
+    byte *data = m->data;
+    m->data = NULL;
+    return data;
+}
+
+// Allegro's packfile magic numbers, encrypted with a password (see file.c)
+static long encrypt_packfile_id(long x, const char *password, bool new_format)
+{
+    long mask = 0;
+    
+    if(password && password[0])
+    {
+        int pos = 0;
+        
+        for(int i=0; password[i]; i++)
+            mask ^= ((long)password[i] << ((i&3) * 8));
+            
+        for(int i=0; i<4; i++)
+        {
+            mask ^= (long)password[pos++] << (24-i*8);
+            
+            if(!password[pos])
+                pos = 0;
+        }
+        
+        if(new_format)
+            mask ^= 42;
+    }
+    
+    return (x ^ mask) & 0xFFFFFFFFL;
+}
+
+// Allegro's LZSS decoder run over a memory buffer. Old style encrypted files
+// xor only the flag bytes with the password.
+static byte *lzss_unpack_memory(const byte *src, long src_size, const char *flagpass, long *dest_size)
+{
+    enum { N = 4096, F = 18, THRESHOLD = 2 };
+    byte text_buf[N + F - 1];
+    memset(text_buf, 0, sizeof(text_buf));
+    
+    long cap = src_size * 4 + 1024, size = 0;
+    byte *buf = (byte *)zc_malloc(cap);
+    
+    if(!buf)
+        return NULL;
+        
+    const byte *si = src, *end = src + src_size;
+    const char *passpos = (flagpass && flagpass[0]) ? flagpass : NULL;
+    unsigned int flags = 0;
+    int r = N - F;
+    
+    for(;;)
+    {
+        if(((flags >>= 1) & 256) == 0)
+        {
+            if(si >= end)
+                break;
+                
+            int c = *(si++);
+            
+            if(passpos)
+            {
+                c ^= (byte)*(passpos++);
+                
+                if(!*passpos)
+                    passpos = flagpass;
+            }
+            
+            flags = c | 0xFF00;                             // uses higher byte to count eight
+        }
+        
+        // one literal byte, or a (position, length) pair of at most F bytes
+        if(size + F + 1 > cap)
+        {
+            cap *= 2;
+            byte *grown = (byte *)zc_malloc(cap);
+            
+            if(!grown)
+            {
+                zc_free(buf);
+                return NULL;
+            }
+            
+            memcpy(grown, buf, size);
+            zc_free(buf);
+            buf = grown;
+        }
+        
+        if(flags & 1)
+        {
+            if(si >= end)
+                break;
+                
+            byte c = *(si++);
+            text_buf[r++] = c;
+            r &= (N - 1);
+            buf[size++] = c;
+        }
+        else
+        {
+            if(end - si < 2)
+                break;
+                
+            int i = *(si++);
+            int j = *(si++);
+            i |= ((j & 0xF0) << 4);
+            j = (j & 0x0F) + THRESHOLD;
+            
+            for(int k=0; k <= j; k++)
+            {
+                byte c = text_buf[(i + k) & (N - 1)];
+                text_buf[r++] = c;
+                r &= (N - 1);
+                buf[size++] = c;
+            }
+        }
+    }
+    
+    *dest_size = size;
+    return buf;
+}
+
+//
+// Opens a buffer from decode_buf_007 the way pack_fopen_password would open
+// the same data written to disk (F_READ_PACKED if packed, F_READ otherwise).
+// On success data belongs to the returned PACKFILE; on failure the caller
+// still owns it, and errno is EDOM if packed was requested for unpacked data
+// (data is unchanged in that case).
+//
+PACKFILE *pack_fopen_decoded(byte *data, long size, bool packed, const char *password)
+{
+    const char *pass = (password && password[0]) ? password : NULL;
+    
+    if(!packed)
+    {
+        if(pass)
+        {
+            const char *passpos = pass;
+            
+            for(long i=0; i<size; i++)
+            {
+                data[i] ^= (byte)*(passpos++);
+                
+                if(!*passpos)
+                    passpos = pass;
+            }
+        }
+        
+        return pack_fopen_memory(data, data, size);
+    }
+    
+    if(size < 4)
+    {
+        errno = EDOM;
+        return NULL;
+    }
+    
+    long header = 0;
+    
+    for(int i=0; i<4; i++)
+    {
+        header = (header << 8) | (byte)(data[i] ^ (pass ? pass[i % strlen(pass)] : 0));
+    }
+    
+    bool oldcrypt = pass &&
+                    (header == encrypt_packfile_id(F_PACK_MAGIC, pass, false) ||
+                     header == encrypt_packfile_id(F_NOPACK_MAGIC, pass, false));
+                     
+    if(oldcrypt)
+    {
+        header = encrypt_packfile_id(header == encrypt_packfile_id(F_PACK_MAGIC, pass, false) ? F_PACK_MAGIC : F_NOPACK_MAGIC, pass, true);
+    }
+    
+    if(header != encrypt_packfile_id(F_PACK_MAGIC, pass, true) &&
+            header != encrypt_packfile_id(F_NOPACK_MAGIC, pass, true))
+    {
+        errno = EDOM;
+        return NULL;
+    }
+    
+    // new style files xor everything, including the header, with the password
+    if(pass && !oldcrypt)
+    {
+        const char *passpos = pass;
+        
+        for(long i=0; i<size; i++)
+        {
+            data[i] ^= (byte)*(passpos++);
+            
+            if(!*passpos)
+                passpos = pass;
+        }
+    }
+    
+    if(header == encrypt_packfile_id(F_NOPACK_MAGIC, pass, true))
+    {
+        return pack_fopen_memory(data, data+4, size-4);
+    }
+    
+    long unpacked_size;
+    byte *unpacked = lzss_unpack_memory(data+4, size-4, oldcrypt ? pass : NULL, &unpacked_size);
+    
+    if(!unpacked)
+    {
+        errno = ENOMEM;
+        return NULL;
+    }
+    
+    PACKFILE *f = pack_fopen_memory(unpacked, unpacked, unpacked_size);
+    
+    if(!f)
+    {
+        zc_free(unpacked);
+        return NULL;
+    }
+    
+    zc_free(data);
+    return f;
+}
+
 void copy_file(const char *src, const char *dest)
 {
     int c;
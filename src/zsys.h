@@ -52,6 +52,12 @@ bool decode_007(byte *buf, dword size, dword key, word check1, word check2, int
 void encode_007(byte *buf, dword size, dword key, word *check1, word *check2, int method);
 int encode_file_007(const char *srcfile, const char *destfile, int key, const char *header, int method);
 int decode_file_007(const char *srcfile, const char *destfile, const char *header, int method, bool packed, const char *password);
+int read_file_007(const char *srcfile, bool packed, const char *password, byte **dest, long *dest_size);
+int decode_buf_007(const byte *src, long src_size, const char *header, int method, byte **dest, long *dest_size);
+PACKFILE *pack_fopen_memory(byte *data, byte *start, long size);
+bool pack_memory_range(PACKFILE *f, byte **pos, byte **end);
+byte *pack_memory_release(PACKFILE *f);
+PACKFILE *pack_fopen_decoded(byte *data, long size, bool packed, const char *password);
 void copy_file(const char *src, const char *dest);
 
 int  get_bit(byte *bitstr,int bit);
@@ -10,6 +10,7 @@ void box_eol();
 void Z_message(char *format,...);
 
 extern bool gotoless_not_equal; // Used by BuildVisitors.cpp
+extern bool optimize_zscript; // Used by ScriptParser.cpp
 
 #endif
  